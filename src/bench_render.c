@@ -0,0 +1,750 @@
+/* scarlett mixer - headless GUI render benchmark
+ *
+ * Copyright 2015-2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/* Builds the complete widget tree of the mixer for every supported
+ * device against the offline mixer and renders it into a cairo image
+ * surface. This file takes the place of robtk's ui_gl.c: it provides
+ * the backend entry points the widgets call (queue_draw_area etc.),
+ * collecting damage instead of talking to an X server or OpenGL.
+ *
+ * Reported are per-frame times of a full redraw, of a single matrix
+ * crosspoint change (write-queue flush and redraw of the damaged area)
+ * and of a resize (re-layout and full redraw), at 1x and 2x scale.
+ *
+ * With --replay, pointer events recorded by `scarlett-mixer --record`
+ * are fed to the widget tree instead, and the time from each event to
+ * the control write and to the GUI settling is reported.
+ */
+
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <stdbool.h>
+
+#include "lv2/lv2plug.in/ns/extensions/ui/ui.h"
+#include "robtk.h"
+
+#ifndef VERSION
+#define VERSION "0.0.0"
+#endif
+
+#ifndef PLUGIN_SOURCE
+#define PLUGIN_SOURCE "src/scarlett_mixer.c"
+#endif
+
+enum LVGLResize {
+	LVGL_ZOOM_TO_ASPECT,
+	LVGL_LAYOUT_TO_FIT,
+	LVGL_CENTER,
+	LVGL_TOP_LEFT,
+};
+
+/* *****************************************************************************
+ * Offscreen backend
+ */
+
+static struct {
+	RobWidget* tl;
+	bool       dirty;
+	int        x0, y0, x1, y1; //< damaged area, toplevel coordinates
+} bench;
+
+static void widget_offset (RobWidget* rw, int* x, int* y)
+{
+	*x = *y = 0;
+	for (; rw && rw != bench.tl; rw = rw->parent) {
+		*x += rw->area.x;
+		*y += rw->area.y;
+	}
+}
+
+static void queue_draw_area (RobWidget* rw, int x, int y, int width, int height)
+{
+	int ox, oy;
+	widget_offset (rw, &ox, &oy);
+	x += ox;
+	y += oy;
+	if (!bench.dirty) {
+		bench.x0 = x;
+		bench.y0 = y;
+		bench.x1 = x + width;
+		bench.y1 = y + height;
+		bench.dirty = true;
+		return;
+	}
+	if (x < bench.x0) bench.x0 = x;
+	if (y < bench.y0) bench.y0 = y;
+	if (x + width > bench.x1) bench.x1 = x + width;
+	if (y + height > bench.y1) bench.y1 = y + height;
+}
+
+static void queue_draw (RobWidget* rw)
+{
+	queue_draw_area (rw, 0, 0, rw->area.width, rw->area.height);
+}
+
+static void queue_tiny_area (RobWidget* rw, float x, float y, float width, float height)
+{
+	queue_draw_area (rw, floorf (x), floorf (y), ceilf (width) + 1, ceilf (height) + 1);
+}
+
+/* layout is explicit, see layout () */
+static void queue_resize (RobWidget* rw) { }
+static bool resize_self (RobWidget* rw) { return TRUE; }
+static void resize_toplevel (RobWidget* rw, int w, int h) { }
+static void relayout_toplevel (RobWidget* rw) { }
+
+static void robtk_close_self (void* h) { }
+
+static int robtk_open_file_dialog (void* h, const char* title)
+{
+	return -1;
+}
+
+static void robtk_queue_scale_change (RobWidget* rw, const float ws) { }
+
+#include PLUGIN_SOURCE
+
+/* *****************************************************************************
+ * Benchmark
+ */
+
+#define BENCH_RESIZE 64 //< px, alternate between natural and larger size
+
+typedef struct {
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+	unsigned n;
+} BenchStat;
+
+static void stat_add (BenchStat* s, uint64_t ns)
+{
+	if (s->n == 0 || ns < s->min) s->min = ns;
+	if (ns > s->max) s->max = ns;
+	s->sum += ns;
+	++s->n;
+}
+
+static void stat_print (const char* what, BenchStat const* s)
+{
+	if (s->n == 0) {
+		return;
+	}
+	printf ("  %-12s avg %7.3f ms  min %7.3f ms  max %7.3f ms\n", what,
+			s->sum / (1e6 * s->n), s->min / 1e6, s->max / 1e6);
+}
+
+static void set_widget_scale (RobWidget* rw, float ws)
+{
+	rw->widget_scale = ws;
+	rw->resized = TRUE;
+	for (unsigned int i = 0; i < rw->childcount; ++i) {
+		set_widget_scale (rw->children[i], ws);
+	}
+}
+
+static void layout (RobWidget* tl, int* w, int* h, int grow)
+{
+	tl->size_request (tl, w, h);
+	*w += grow;
+	*h += grow;
+	tl->size_allocate (tl, *w, *h);
+}
+
+static uint64_t render (cairo_surface_t* s, RobWidget* tl, int x, int y, int w, int h)
+{
+	const uint64_t t0 = monotonic_ns ();
+	cairo_rectangle_t ev = { x, y, w, h };
+	cairo_t* cr = cairo_create (s);
+	cairo_rectangle (cr, x, y, w, h);
+	cairo_clip (cr);
+	tl->expose_event (tl, cr, &ev);
+	cairo_destroy (cr);
+	cairo_surface_flush (s);
+	return monotonic_ns () - t0;
+}
+
+static RobTkApp* bench_open (Device* d)
+{
+	RobTkApp* ui = (RobTkApp*)calloc (1, sizeof (RobTkApp));
+	if (open_mixer_offline (ui, d)) {
+		close_mixer (ui);
+		free (ui);
+		return NULL;
+	}
+	wq_init (ui);
+	ui->hist_key = -1;
+	ui->jrn.fd = -1;
+	ui->bank.fd = -1;
+
+	ui->disable_signals = true;
+	bench.tl = toplevel (ui, NULL);
+	ui->disable_signals = false;
+	while (sync_state (ui)) ;
+	wq_flush (ui);
+	return ui;
+}
+
+static void bench_close (RobTkApp* ui)
+{
+	bench.tl = NULL;
+	gui_cleanup (ui);
+	free (ui);
+}
+
+static void bench_device (Device* d, float scale, int frames, const char* png)
+{
+	RobTkApp* ui = bench_open (d);
+	if (!ui) {
+		return;
+	}
+
+	RobWidget* tl = bench.tl;
+	set_widget_scale (tl, scale);
+
+	int w, h;
+	layout (tl, &w, &h, 0);
+	const int nw = w;
+	const int nh = h;
+
+	cairo_surface_t* s = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, nw + BENCH_RESIZE, nh + BENCH_RESIZE);
+
+	BenchStat full, xpt, rsz;
+	memset (&full, 0, sizeof (BenchStat));
+	memset (&xpt, 0, sizeof (BenchStat));
+	memset (&rsz, 0, sizeof (BenchStat));
+
+	/* first frame populates caches (faceplates, text), not counted */
+	render (s, tl, 0, 0, w, h);
+
+	for (int i = 0; i < frames; ++i) {
+		stat_add (&full, render (s, tl, 0, 0, w, h));
+	}
+
+	const unsigned int n_mtx = d->smi * d->smo;
+	for (int i = 0; i < frames; ++i) {
+		const unsigned int n = (i * 7) % n_mtx;
+		const uint64_t t0 = monotonic_ns ();
+		bench.dirty = false;
+		robtk_dial_set_value (ui->mtx_gain[n], db_to_knob ((i & 1) ? -10.f : 0.f));
+		wq_flush (ui);
+		uint64_t t = monotonic_ns () - t0;
+		if (bench.dirty) {
+			t += render (s, tl, bench.x0, bench.y0, bench.x1 - bench.x0, bench.y1 - bench.y0);
+		}
+		stat_add (&xpt, t);
+	}
+
+	for (int i = 0; i < frames; ++i) {
+		const uint64_t t0 = monotonic_ns ();
+		layout (tl, &w, &h, (i & 1) ? 0 : BENCH_RESIZE);
+		const uint64_t t = monotonic_ns () - t0;
+		stat_add (&rsz, t + render (s, tl, 0, 0, w, h));
+	}
+
+	printf ("%s, scale %.0fx, %dx%d px, %u controls\n", d->name, scale, nw, nh, ui->sm.ctrl_cnt);
+	stat_print ("full redraw", &full);
+	stat_print ("crosspoint", &xpt);
+	stat_print ("resize", &rsz);
+
+	if (png) {
+		char fn[1024];
+		unsigned int i = 0;
+		while (scarlett_device (i) && scarlett_device (i) != d) {
+			++i;
+		}
+		layout (tl, &w, &h, 0);
+		render (s, tl, 0, 0, w, h);
+		snprintf (fn, sizeof (fn), "%s-%u-%.0fx.png", png, i, scale);
+		if (cairo_surface_write_to_png (s, fn) != CAIRO_STATUS_SUCCESS) {
+			fprintf (stderr, "Cannot write '%s'\n", fn);
+		}
+	}
+
+	cairo_surface_destroy (s);
+	bench_close (ui);
+}
+
+/* *****************************************************************************
+ * Interaction replay
+ *
+ * Events are dispatched the way robtk does: a press goes to the top-level
+ * widget, motion and release to the widget that accepted the press.
+ * Between events the main loop is emulated on a virtual clock: port_event ()
+ * followed by a redraw of the damaged area, REPLAY_FPS times per second.
+ * Only processing time is measured, so results do not depend on the pace
+ * of the recording and can be compared between builds.
+ */
+
+#define REPLAY_FPS    30  //< emulated idle callbacks per second
+#define REPLAY_SETTLE 100 //< frames, give up waiting for the GUI to settle
+
+enum ReplayKind {
+	RP_PRESS = 0,
+	RP_RELEASE,
+	RP_MOVE,
+	RP_SCROLL,
+	RP_SIZE,
+	RP_KINDS
+};
+
+static const char* rp_kind_name[RP_KINDS] = {
+	"press", "release", "move", "scroll", "size"
+};
+
+typedef struct {
+	double        ms;
+	int           kind;
+	RobTkBtnEvent ev;
+	int           w, h; //< RP_SIZE
+	float         scale;
+
+	/* measured */
+	uint64_t      t_in;     //< monotonic_ns () before dispatch
+	uint64_t      t_write;  //< first control write after t_in, 0: none
+	uint64_t      t_settle; //< end of the last frame with work
+	uint64_t      writes;   //< ui->perf.writes before dispatch
+	unsigned int  frames;   //< frames until settled
+} ReplayEvent;
+
+typedef struct {
+	RobTkApp*        ui;
+	RobWidget*       tl;
+	RobWidget*       focus;
+	cairo_surface_t* s;
+	int              sw, sh;
+	ReplayEvent*     ev;
+	size_t           n_ev;
+	size_t           pending; //< first event that has not settled
+	size_t           next;    //< first event not yet dispatched
+	unsigned int     n_frames;
+	uint64_t         busy_ns; //< total dispatch and frame time
+} Replay;
+
+static int rp_load (Replay* rp, const char* path, char* device, size_t len)
+{
+	FILE* f = fopen (path, "r");
+	if (!f) {
+		fprintf (stderr, "Cannot open '%s': %s\n", path, strerror (errno));
+		return -1;
+	}
+
+	size_t alloc = 0;
+	double ms = 0;
+	char line[1024];
+	unsigned int lineno = 0;
+	*device = '\0';
+
+	while (fgets (line, sizeof (line), f)) {
+		++lineno;
+		line[strcspn (line, "\r\n")] = '\0';
+		if (line[0] == '\0' || line[0] == '#') {
+			continue;
+		}
+		if (!strncmp (line, "device ", 7)) {
+			snprintf (device, len, "%s", line + 7);
+			continue;
+		}
+
+		if (rp->n_ev == alloc) {
+			alloc = alloc ? 2 * alloc : 1024;
+			rp->ev = (ReplayEvent*)realloc (rp->ev, alloc * sizeof (ReplayEvent));
+		}
+		ReplayEvent* e = &rp->ev[rp->n_ev];
+		memset (e, 0, sizeof (ReplayEvent));
+
+		char what[16];
+		int a, b;
+		bool ok;
+		if (!strncmp (line, "size ", 5)) {
+			e->kind = RP_SIZE;
+			e->ms   = ms;
+			ok = 3 == sscanf (line + 5, "%d %d %f", &e->w, &e->h, &e->scale) && e->w > 0 && e->h > 0 && e->scale > 0;
+		} else if (2 <= sscanf (line, "%lf %15s", &e->ms, what)) {
+			ok = e->ms >= ms;
+			ms = e->ms;
+			if (!strcmp (what, "move")) {
+				e->kind = RP_MOVE;
+				ok &= 3 == sscanf (line, "%*f %*s %d %d %d", &e->ev.x, &e->ev.y, &e->ev.state);
+			} else {
+				ok &= 4 == sscanf (line, "%*f %*s %d %d %d %d", &e->ev.x, &e->ev.y, &a, &b);
+				e->ev.state = b;
+				if (!strcmp (what, "press")) {
+					e->kind = RP_PRESS;
+					e->ev.button = a;
+				} else if (!strcmp (what, "release")) {
+					e->kind = RP_RELEASE;
+					e->ev.button = a;
+				} else if (!strcmp (what, "scroll")) {
+					e->kind = RP_SCROLL;
+					e->ev.direction = a;
+				} else {
+					ok = false;
+				}
+			}
+		} else {
+			ok = false;
+		}
+		if (!ok) {
+			fprintf (stderr, "%s:%u: invalid event '%s'\n", path, lineno, line);
+			fclose (f);
+			return -1;
+		}
+		++rp->n_ev;
+	}
+	fclose (f);
+
+	if (!*device || (rp->n_ev > 0 && rp->ev[0].kind != RP_SIZE)) {
+		fprintf (stderr, "%s: not a recording of scarlett-mixer --record\n", path);
+		return -1;
+	}
+	if (rp->n_ev == 0) {
+		fprintf (stderr, "%s: no events recorded\n", path);
+		return -1;
+	}
+	return 0;
+}
+
+static void rp_resize (Replay* rp, ReplayEvent const* e)
+{
+	RobWidget* tl = rp->tl;
+	int w, h;
+	if (tl->widget_scale != e->scale) {
+		set_widget_scale (tl, e->scale);
+	}
+	tl->size_request (tl, &w, &h);
+	w = w > e->w ? w : e->w;
+	h = h > e->h ? h : e->h;
+	tl->size_allocate (tl, w, h);
+
+	if (!rp->s || w > rp->sw || h > rp->sh) {
+		if (rp->s) {
+			cairo_surface_destroy (rp->s);
+		}
+		rp->s  = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, w, h);
+		rp->sw = w;
+		rp->sh = h;
+	}
+	queue_draw (tl);
+}
+
+static void rp_dispatch (Replay* rp, ReplayEvent* e)
+{
+	RobWidget* tl = rp->tl;
+	RobTkBtnEvent ev = e->ev;
+	int ox, oy;
+
+	switch (e->kind) {
+		case RP_SIZE:
+			rp_resize (rp, e);
+			break;
+		case RP_PRESS:
+			rp->focus = tl->mousedown ? tl->mousedown (tl, &ev) : NULL;
+			break;
+		case RP_MOVE:
+			if (rp->focus && rp->focus->mousemove) {
+				widget_offset (rp->focus, &ox, &oy);
+				ev.x -= ox;
+				ev.y -= oy;
+				rp->focus = rp->focus->mousemove (rp->focus, &ev);
+			} else if (tl->mousemove) {
+				tl->mousemove (tl, &ev);
+			}
+			break;
+		case RP_RELEASE:
+			if (rp->focus && rp->focus->mouseup) {
+				widget_offset (rp->focus, &ox, &oy);
+				ev.x -= ox;
+				ev.y -= oy;
+				rp->focus = rp->focus->mouseup (rp->focus, &ev);
+			} else if (tl->mouseup) {
+				tl->mouseup (tl, &ev);
+			}
+			break;
+		case RP_SCROLL:
+			if (tl->mousescroll) {
+				tl->mousescroll (tl, &ev);
+			}
+			break;
+	}
+}
+
+/* attribute writes to all dispatched events that did not yet see one */
+static void rp_check_writes (Replay* rp)
+{
+	RobTkApp* ui = rp->ui;
+	for (size_t i = rp->pending; i < rp->next; ++i) {
+		ReplayEvent* e = &rp->ev[i];
+		if (!e->t_write && ui->perf.writes > e->writes) {
+			e->t_write = ui->perf.t_write;
+		}
+	}
+}
+
+/* one iteration of the emulated main loop, returns false if idle */
+static bool rp_frame (Replay* rp)
+{
+	RobTkApp* ui = rp->ui;
+	const uint64_t t0 = monotonic_ns ();
+	const uint64_t writes = ui->perf.writes;
+
+	port_event (ui, 0, 0, 0, NULL);
+	const bool busy = bench.dirty || ui->perf.writes != writes;
+	if (bench.dirty) {
+		render (rp->s, rp->tl, bench.x0, bench.y0, bench.x1 - bench.x0, bench.y1 - bench.y0);
+		bench.dirty = false;
+	}
+
+	const uint64_t t1 = monotonic_ns ();
+	rp->busy_ns += t1 - t0;
+	++rp->n_frames;
+
+	rp_check_writes (rp);
+	for (size_t i = rp->pending; i < rp->next; ++i) {
+		ReplayEvent* e = &rp->ev[i];
+		if (busy) {
+			e->t_settle = t1;
+			++e->frames;
+		}
+	}
+	if (!busy || (rp->pending < rp->next && rp->ev[rp->pending].frames >= REPLAY_SETTLE)) {
+		rp->pending = rp->next;
+	}
+	return busy;
+}
+
+static int cmp_u64 (const void* a, const void* b)
+{
+	const uint64_t x = *(const uint64_t*)a;
+	const uint64_t y = *(const uint64_t*)b;
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static void rp_print_stat (uint64_t* v, size_t n)
+{
+	if (n == 0) {
+		printf ("  %7s %7s %7s", "-", "-", "-");
+		return;
+	}
+	qsort (v, n, sizeof (uint64_t), cmp_u64);
+	printf ("  %7.3f %7.3f %7.3f", v[n / 2] / 1e6, v[(size_t)(.99 * (n - 1))] / 1e6, v[n - 1] / 1e6);
+}
+
+static void rp_report (Replay const* rp)
+{
+	uint64_t* wr = (uint64_t*)malloc (rp->n_ev * sizeof (uint64_t));
+	uint64_t* st = (uint64_t*)malloc (rp->n_ev * sizeof (uint64_t));
+
+	printf ("  %-8s %6s  %-23s  %-23s  %s\n", "", "", "to write (ms)", "to settle (ms)", "frames");
+	printf ("  %-8s %6s  %7s %7s %7s  %7s %7s %7s  %6s\n", "event", "count",
+			"p50", "p99", "max", "p50", "p99", "max", "avg");
+
+	for (int k = 0; k < RP_KINDS; ++k) {
+		size_t n = 0, n_wr = 0;
+		unsigned int frames = 0;
+		for (size_t i = 0; i < rp->n_ev; ++i) {
+			ReplayEvent const* e = &rp->ev[i];
+			if (e->kind != k) {
+				continue;
+			}
+			if (e->t_write) {
+				wr[n_wr++] = e->t_write - e->t_in;
+			}
+			st[n++] = e->t_settle - e->t_in;
+			frames += e->frames;
+		}
+		if (n == 0) {
+			continue;
+		}
+		printf ("  %-8s %6zu", rp_kind_name[k], n);
+		rp_print_stat (wr, n_wr);
+		rp_print_stat (st, n);
+		printf ("  %6.2f\n", frames / (float)n);
+	}
+	printf ("  %u frames, %.3f ms busy\n", rp->n_frames, rp->busy_ns / 1e6);
+	free (wr);
+	free (st);
+}
+
+static int bench_replay (const char* path)
+{
+	Replay rp;
+	char name[256];
+	memset (&rp, 0, sizeof (Replay));
+
+	if (rp_load (&rp, path, name, sizeof (name))) {
+		free (rp.ev);
+		return -1;
+	}
+
+	Device* d = NULL;
+	Device* di;
+	for (unsigned int i = 0; (di = scarlett_device (i)); ++i) {
+		if (!strcmp (di->name, name)) {
+			d = di;
+		}
+	}
+	if (!d) {
+		fprintf (stderr, "%s: unknown device '%s'\n", path, name);
+		free (rp.ev);
+		return -1;
+	}
+
+	rp.ui = bench_open (d);
+	if (!rp.ui) {
+		free (rp.ev);
+		return -1;
+	}
+	rp.tl = bench.tl;
+
+	/* initial layout and first frame populate caches, not counted */
+	rp_dispatch (&rp, &rp.ev[0]);
+	render (rp.s, rp.tl, 0, 0, rp.tl->area.width, rp.tl->area.height);
+	bench.dirty = false;
+	rp.pending = rp.next = 1;
+
+	const double period = 1000. / REPLAY_FPS;
+	double frame = 0;
+
+	for (size_t i = 1; i < rp.n_ev; ++i) {
+		ReplayEvent* e = &rp.ev[i];
+		while (e->ms >= frame) {
+			if (rp.pending == rp.next && !bench.dirty) {
+				/* idle, skip ahead */
+				frame = (floor (e->ms / period) + 1) * period;
+				break;
+			}
+			rp_frame (&rp);
+			frame += period;
+		}
+
+		e->writes = rp.ui->perf.writes;
+		e->t_in   = monotonic_ns ();
+		rp_dispatch (&rp, e);
+		e->t_settle = monotonic_ns ();
+		rp.busy_ns += e->t_settle - e->t_in;
+		rp.next = i + 1;
+		rp_check_writes (&rp);
+	}
+
+	while (rp.pending < rp.next) {
+		rp_frame (&rp);
+	}
+
+	printf ("%s, replay of %zu events, %.1f s\n", d->name, rp.n_ev - 1, rp.ev[rp.n_ev - 1].ms / 1000.);
+	rp_report (&rp);
+
+	if (rp.s) {
+		cairo_surface_destroy (rp.s);
+	}
+	bench_close (rp.ui);
+	free (rp.ev);
+	return 0;
+}
+
+static void bench_usage (int status)
+{
+	printf ("scarlett-mixer-bench - Headless GUI render benchmark.\n\n\
+Builds the mixer GUI for every supported device against an offline\n\
+mixer and reports the time per frame for a full redraw, a single\n\
+matrix crosspoint change and a resize at 1x and 2x scale.\n\n\
+Alternatively replays pointer events recorded with\n\
+`scarlett-mixer --record` and reports the time from each event to\n\
+the control write and until the GUI settled.\n\n");
+	printf ("Usage: scarlett-mixer-bench [ OPTIONS ]\n\n");
+	printf ("Options:\n\
+  -d, --device <name>        only benchmark devices matching name\n\
+  -h, --help                 display this help and exit\n\
+  -n, --frames <num>         frames per measurement (default 100)\n\
+  -o, --png <prefix>         write a snapshot of each layout\n\
+  -r, --replay <file>        replay recorded interactions\n\
+  -V, --version              print version information and exit\n\
+\n");
+	exit (status);
+}
+
+int main (int argc, char** argv)
+{
+	static struct option const bench_options[] =
+	{
+		{"device", required_argument, 0, 'd'},
+		{"frames", required_argument, 0, 'n'},
+		{"help", no_argument, 0, 'h'},
+		{"png", required_argument, 0, 'o'},
+		{"replay", required_argument, 0, 'r'},
+		{"version", no_argument, 0, 'V'},
+		{NULL, 0, NULL, 0}
+	};
+
+	const char* match = NULL;
+	const char* png = NULL;
+	const char* replay = NULL;
+	int frames = 100;
+	int c;
+
+	while ((c = getopt_long (argc, argv,
+			   "d:" /* device */
+			   "h"  /* help */
+			   "n:" /* frames */
+			   "o:" /* png */
+			   "r:" /* replay */
+			   "V", /* version */
+			   bench_options, (int *) 0)) != EOF) {
+		switch (c) {
+			case 'd':
+				match = optarg;
+				break;
+			case 'h':
+				bench_usage (0);
+			case 'n':
+				frames = atoi (optarg);
+				break;
+			case 'o':
+				png = optarg;
+				break;
+			case 'r':
+				replay = optarg;
+				break;
+			case 'V':
+				printf ("scarlett-mixer-bench version %s\n", VERSION);
+				exit (0);
+			default:
+				bench_usage (EXIT_FAILURE);
+		}
+	}
+
+	if (optind < argc || frames < 1) {
+		bench_usage (EXIT_FAILURE);
+	}
+
+	if (replay) {
+		return bench_replay (replay) ? EXIT_FAILURE : 0;
+	}
+
+	Device* d;
+	for (unsigned int i = 0; (d = scarlett_device (i)); ++i) {
+		if (match && !strstr (d->name, match)) {
+			continue;
+		}
+		bench_device (d, 1.f, frames, png);
+		bench_device (d, 2.f, frames, png);
+	}
+	return 0;
+}
@@ -0,0 +1,772 @@
+/* scarlett mixer - ALSA control plugin emulating a Scarlett interface
+ *
+ * Copyright 2015-2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/* ctl_external plugin that presents the mixer controls of a device in
+ * device.h the way the kernel driver (sound/usb/mixer_scarlett.c) does:
+ * same element names, types, enum items and dB ranges, laid out so that
+ * ALSA's simple mixer yields the control indices of the description.
+ * scarlett-mixer, amixer etc. can open it like a card:
+ *
+ *   ctl_type.scarlett {
+ *     lib "/path/to/libasound_module_ctl_scarlett.so"
+ *   }
+ *   ctl.scarlett_emu {
+ *     type scarlett
+ *     device "18i8"       # (part of) the device name, default: first
+ *     latency 1000        # usec per value change, default 0
+ *     read_latency 0      # usec per value read, default 0
+ *   }
+ *
+ * State is held in memory, shared by all handles of the same device in
+ * a process. Like the kernel, a change is notified to every subscribed
+ * handle, including the writer. Index gaps of the description (controls
+ * of the kernel driver the mixer does not use) are filled with read-only
+ * placeholders that sort into the same position.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <alsa/asoundlib.h>
+#include <alsa/control_external.h>
+
+#include "device.h"
+
+#define EMU_VOL_MAX  134    //< 0..134 = -128..+6 dB
+#define EMU_VOL_0DB  128
+#define EMU_DB_MIN   -12800 //< 1/100 dB
+#define EMU_DB_STEP  100
+
+/* sources of the routing enums, per device:
+ * Off, PCM 1.., Analog 1.., SPDIF 1.., ADAT 1.., Mix A.. */
+static const struct {
+	const char* name;
+	unsigned    pcm, analog, spdif, adat;
+} emu_ports[] = {
+	{ "Scarlett 18i6 USB",   6, 8, 2, 8 },
+	{ "Scarlett 18i8 USB",   8, 8, 2, 8 },
+	{ "Scarlett 6i6 USB",    6, 4, 2, 0 },
+	{ "Scarlett 18i20 USB", 20, 8, 2, 8 },
+};
+
+/* *****************************************************************************
+ * Control layout
+ */
+
+enum EmuKind {
+	EK_NONE = 0, //< placeholder
+	EK_MASTER,
+	EK_OUT_GAIN, //< a: output pair
+	EK_OUT_SRC,  //< a: output
+	EK_HIZ,      //< a: input
+	EK_PAD,      //< a: input
+	EK_INPUT,    //< a: capture
+	EK_MTX_IN,   //< a: matrix row
+	EK_MTX_MIX,  //< a: matrix row, b: mix-bus
+};
+
+typedef struct {
+	int kind;
+	int a, b;
+} EmuSel;
+
+typedef struct {
+	char      name[44];
+	int       type;    //< SND_CTL_ELEM_TYPE_*
+	unsigned  access;
+	unsigned  count;   //< channels
+	unsigned  n_items; //< enum
+	char    (*items)[32];
+	long      val[2];
+} EmuElem;
+
+typedef struct EmuCtl EmuCtl;
+
+typedef struct {
+	Device const* dev;
+	EmuElem*      elem;
+	unsigned      n_elem;
+	char        (*src_items)[32];
+	unsigned      n_src; //< master source enum
+	unsigned      n_mtx; //< matrix and capture enum, no mix-busses
+	unsigned      n_mix;
+	int           refcnt;
+	EmuCtl*       ctls;  //< open handles
+} EmuCard;
+
+struct EmuCtl {
+	snd_ctl_ext_t ext;
+	EmuCard*      card;
+	EmuCtl*       next;
+	int           fd[2];   //< poll pipe, one byte per queued event
+	bool          subscribed;
+	unsigned*     evq;     //< [n_elem + 1] ring of pending keys
+	unsigned      ev_r, ev_w;
+	uint8_t*      pending; //< [n_elem] coalesce events
+	unsigned      latency;
+	unsigned      read_latency;
+};
+
+static EmuCard         emu_cards[NUM_DEVICES];
+static pthread_mutex_t emu_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static char emu_imp_items[2][32] = { "Line", "Hi-Z" };
+static char emu_pad_items[2][32] = { "0dB", "-10dB" };
+static char emu_sync_items[2][32] = { "No Lock", "Locked" };
+
+static int emu_set_sel (EmuSel* sel, unsigned n_sel, int idx, int kind, int a, int b)
+{
+	if (idx < 0 || (unsigned)idx >= n_sel || sel[idx].kind != EK_NONE) {
+		return -1;
+	}
+	sel[idx].kind = kind;
+	sel[idx].a    = a;
+	sel[idx].b    = b;
+	return 0;
+}
+
+static int emu_mtx_mix_idx (Device const* d, unsigned r, unsigned c)
+{
+	if (d->matrix_mix_map) {
+		return d->matrix_mix_map[r * d->smo + c];
+	}
+	return d->matrix_mix_offset + r * d->matrix_mix_stride + c;
+}
+
+static int emu_mtx_in_idx (Device const* d, unsigned r)
+{
+	if (d->matrix_in_map) {
+		return d->matrix_in_map[r];
+	}
+	return d->matrix_in_offset + r * d->matrix_in_stride;
+}
+
+static int emu_input_idx (Device const* d, unsigned i)
+{
+	if (d->input_map) {
+		return d->input_map[i];
+	}
+	return d->input_offset + i;
+}
+
+/* placeholders are named to sort before the next control of the
+ * description, see snd_mixer_selem_compare () */
+static const char* emu_fill_prefix (int next_kind)
+{
+	switch (next_kind) {
+		case EK_HIZ:
+		case EK_PAD:
+		case EK_INPUT:
+			return "Clock";
+		case EK_MTX_IN:
+		case EK_MTX_MIX:
+			return "Level";
+		default:
+			return "Sync";
+	}
+}
+
+static EmuElem* emu_add (EmuCard* c, int type, unsigned count, const char* fmt, ...)
+{
+	EmuElem* e = &c->elem[c->n_elem++];
+	va_list  ap;
+	va_start (ap, fmt);
+	vsnprintf (e->name, sizeof (e->name), fmt, ap);
+	va_end (ap);
+	e->type   = type;
+	e->count  = count;
+	e->access = SND_CTL_EXT_ACCESS_READWRITE;
+	if (type == SND_CTL_ELEM_TYPE_INTEGER) {
+		e->access |= SND_CTL_EXT_ACCESS_TLV_READ | SND_CTL_EXT_ACCESS_TLV_CALLBACK;
+	}
+	return e;
+}
+
+static EmuElem* emu_add_enum (EmuCard* c, unsigned n_items, char (*items)[32], long val, const char* name)
+{
+	EmuElem* e = emu_add (c, SND_CTL_ELEM_TYPE_ENUMERATED, 1, "%s", name);
+	e->n_items = n_items;
+	e->items   = items;
+	e->val[0]  = val < (long)n_items ? val : 0;
+	return e;
+}
+
+static int emu_card_init (EmuCard* c, Device const* d)
+{
+	unsigned pcm = 0, analog = 0, spdif = 0, adat = 0;
+	for (unsigned int i = 0; i < sizeof (emu_ports) / sizeof (emu_ports[0]); ++i) {
+		if (!strcmp (emu_ports[i].name, d->name)) {
+			pcm    = emu_ports[i].pcm;
+			analog = emu_ports[i].analog;
+			spdif  = emu_ports[i].spdif;
+			adat   = emu_ports[i].adat;
+		}
+	}
+
+	/* the kernel driver creates a control for every mix-bus, the
+	 * description may use fewer, cf. 6i6 */
+	c->n_mix = d->matrix_mix_map ? d->smo : d->matrix_mix_stride - 1;
+	if (c->n_mix < d->smo || c->n_mix > 26) {
+		SNDERR ("Invalid matrix layout of '%s'", d->name);
+		return -EINVAL;
+	}
+
+	c->dev   = d;
+	c->n_mtx = 1 + pcm + analog + spdif + adat;
+	c->n_src = c->n_mtx + c->n_mix;
+
+	c->src_items = (char (*)[32])calloc (c->n_src, sizeof (char[32]));
+	unsigned n = 0;
+	strcpy (c->src_items[n++], "Off");
+	for (unsigned int i = 0; i < pcm; ++i) { snprintf (c->src_items[n++], 32, "PCM %u", i + 1); }
+	for (unsigned int i = 0; i < analog; ++i) { snprintf (c->src_items[n++], 32, "Analog %u", i + 1); }
+	for (unsigned int i = 0; i < spdif; ++i) { snprintf (c->src_items[n++], 32, "SPDIF %u", i + 1); }
+	for (unsigned int i = 0; i < adat; ++i) { snprintf (c->src_items[n++], 32, "ADAT %u", i + 1); }
+	for (unsigned int i = 0; i < c->n_mix; ++i) { snprintf (c->src_items[n++], 32, "Mix %c", 'A' + i); }
+
+	/* map simple-mixer control index -> kind */
+	unsigned n_sel = 1;
+	for (unsigned int i = 0; i < d->smst; ++i) {
+		if (d->out_gain_map[i] >= (int)n_sel) { n_sel = d->out_gain_map[i] + 1; }
+	}
+	for (unsigned int i = 0; i < d->sout; ++i) {
+		if (d->out_bus_map[i] >= (int)n_sel) { n_sel = d->out_bus_map[i] + 1; }
+	}
+	for (unsigned int i = 0; i < d->num_hiz; ++i) {
+		if (d->hiz_map[i] >= (int)n_sel) { n_sel = d->hiz_map[i] + 1; }
+	}
+	for (unsigned int i = 0; i < d->num_pad; ++i) {
+		if (d->pad_map[i] >= (int)n_sel) { n_sel = d->pad_map[i] + 1; }
+	}
+	for (unsigned int i = 0; i < d->sin; ++i) {
+		if (emu_input_idx (d, i) >= (int)n_sel) { n_sel = emu_input_idx (d, i) + 1; }
+	}
+	for (unsigned int r = 0; r < d->smi; ++r) {
+		if (emu_mtx_in_idx (d, r) >= (int)n_sel) { n_sel = emu_mtx_in_idx (d, r) + 1; }
+		for (unsigned int m = 0; m < c->n_mix; ++m) {
+			if (emu_mtx_mix_idx (d, r, m) >= (int)n_sel) { n_sel = emu_mtx_mix_idx (d, r, m) + 1; }
+		}
+	}
+
+	EmuSel* sel = (EmuSel*)calloc (n_sel, sizeof (EmuSel));
+	int     err = emu_set_sel (sel, n_sel, 0, EK_MASTER, 0, 0);
+	for (unsigned int i = 0; i < d->smst; ++i) {
+		err |= emu_set_sel (sel, n_sel, d->out_gain_map[i], EK_OUT_GAIN, i, 0);
+	}
+	for (unsigned int i = 0; i < d->sout; ++i) {
+		err |= emu_set_sel (sel, n_sel, d->out_bus_map[i], EK_OUT_SRC, i, 0);
+	}
+	for (unsigned int i = 0; i < d->num_hiz; ++i) {
+		err |= emu_set_sel (sel, n_sel, d->hiz_map[i], EK_HIZ, i, 0);
+	}
+	for (unsigned int i = 0; i < d->num_pad; ++i) {
+		err |= emu_set_sel (sel, n_sel, d->pad_map[i], EK_PAD, i, 0);
+	}
+	for (unsigned int i = 0; i < d->sin; ++i) {
+		err |= emu_set_sel (sel, n_sel, emu_input_idx (d, i), EK_INPUT, i, 0);
+	}
+	for (unsigned int r = 0; r < d->smi; ++r) {
+		err |= emu_set_sel (sel, n_sel, emu_mtx_in_idx (d, r), EK_MTX_IN, r, 0);
+		for (unsigned int m = 0; m < c->n_mix; ++m) {
+			err |= emu_set_sel (sel, n_sel, emu_mtx_mix_idx (d, r, m), EK_MTX_MIX, r, m);
+		}
+	}
+
+	if (err) {
+		SNDERR ("Overlapping control indices in the description of '%s'", d->name);
+		free (sel);
+		free (c->src_items);
+		c->src_items = NULL;
+		return -EINVAL;
+	}
+
+	/* master and output gains have a switch and a volume element */
+	c->elem   = (EmuElem*)calloc (n_sel + 1 + d->smst, sizeof (EmuElem));
+	c->n_elem = 0;
+
+	int next_kind = EK_NONE;
+	for (unsigned int i = n_sel; i > 0; --i) {
+		if (sel[i - 1].kind == EK_NONE) {
+			sel[i - 1].b = next_kind;
+		} else {
+			next_kind = sel[i - 1].kind;
+		}
+	}
+
+	for (unsigned int i = 0; i < n_sel; ++i) {
+		const int a = sel[i].a;
+		const int b = sel[i].b;
+		char      name[44];
+		EmuElem*  e;
+
+		switch (sel[i].kind) {
+			case EK_MASTER:
+				e = emu_add (c, SND_CTL_ELEM_TYPE_BOOLEAN, 1, "Master Playback Switch");
+				e->val[0] = 1;
+				e = emu_add (c, SND_CTL_ELEM_TYPE_INTEGER, 1, "Master Playback Volume");
+				e->val[0] = EMU_VOL_0DB;
+				break;
+			case EK_OUT_GAIN:
+				e = emu_add (c, SND_CTL_ELEM_TYPE_BOOLEAN, 2, "Master %d (%s) Playback Switch", a + 1, d->out_gain_labels[a]);
+				e->val[0] = e->val[1] = 1;
+				e = emu_add (c, SND_CTL_ELEM_TYPE_INTEGER, 2, "Master %d (%s) Playback Volume", a + 1, d->out_gain_labels[a]);
+				e->val[0] = e->val[1] = EMU_VOL_0DB;
+				break;
+			case EK_OUT_SRC:
+				/* outputs default to the mix-busses */
+				snprintf (name, sizeof (name), "Master %d%c (%s) Source Playback Enum", a / 2 + 1, (a & 1) ? 'R' : 'L', d->out_gain_labels[a / 2]);
+				emu_add_enum (c, c->n_src, c->src_items, c->n_mtx + a % c->n_mix, name);
+				break;
+			case EK_HIZ:
+				snprintf (name, sizeof (name), "Input %d Impedance Switch", a + 1);
+				emu_add_enum (c, 2, emu_imp_items, 0, name);
+				break;
+			case EK_PAD:
+				snprintf (name, sizeof (name), "Input %d Pad Switch", a + 1);
+				emu_add_enum (c, 2, emu_pad_items, 0, name);
+				break;
+			case EK_INPUT:
+				/* capture and matrix inputs default to Analog 1.. */
+				snprintf (name, sizeof (name), "Input Source %02d Capture Route", a + 1);
+				emu_add_enum (c, c->n_mtx, c->src_items, a < (int)analog ? 1 + pcm + a : 0, name);
+				break;
+			case EK_MTX_IN:
+				snprintf (name, sizeof (name), "Matrix %02d Input Playback Route", a + 1);
+				emu_add_enum (c, c->n_mtx, c->src_items, a < (int)analog ? 1 + pcm + a : 0, name);
+				break;
+			case EK_MTX_MIX:
+				emu_add (c, SND_CTL_ELEM_TYPE_INTEGER, 1, "Matrix %02d Mix %c Playback Volume", a + 1, 'A' + b);
+				break;
+			default:
+				snprintf (name, sizeof (name), "%s %02u", emu_fill_prefix (b), i);
+				e = emu_add_enum (c, 2, emu_sync_items, 1, name);
+				e->access = SND_CTL_EXT_ACCESS_READ;
+				break;
+		}
+	}
+
+	free (sel);
+	return 0;
+}
+
+static void emu_card_free (EmuCard* c)
+{
+	free (c->elem);
+	free (c->src_items);
+	memset (c, 0, sizeof (EmuCard));
+}
+
+/* call with emu_lock held */
+static void emu_notify (EmuCard* c, unsigned key)
+{
+	for (EmuCtl* ctl = c->ctls; ctl; ctl = ctl->next) {
+		if (!ctl->subscribed || ctl->pending[key]) {
+			continue;
+		}
+		ctl->pending[key] = 1;
+		ctl->evq[ctl->ev_w] = key;
+		ctl->ev_w = (ctl->ev_w + 1) % (c->n_elem + 1);
+		if (write (ctl->fd[1], "", 1) != 1) {
+			; // pipe is full, poll () reports POLLIN regardless
+		}
+	}
+}
+
+/* *****************************************************************************
+ * ctl_external callbacks
+ */
+
+static int emu_elem_count (snd_ctl_ext_t* ext)
+{
+	EmuCtl* ctl = (EmuCtl*)ext->private_data;
+	return ctl->card->n_elem;
+}
+
+static int emu_elem_list (snd_ctl_ext_t* ext, unsigned int offset, snd_ctl_elem_id_t* id)
+{
+	EmuCtl* ctl = (EmuCtl*)ext->private_data;
+	if (offset >= ctl->card->n_elem) {
+		return -EINVAL;
+	}
+	snd_ctl_elem_id_set_interface (id, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_id_set_name (id, ctl->card->elem[offset].name);
+	return 0;
+}
+
+static snd_ctl_ext_key_t emu_find_elem (snd_ctl_ext_t* ext, const snd_ctl_elem_id_t* id)
+{
+	EmuCtl*       ctl   = (EmuCtl*)ext->private_data;
+	const char*   name  = snd_ctl_elem_id_get_name (id);
+	const unsigned numid = snd_ctl_elem_id_get_numid (id);
+
+	/* ctl_ext numbers elements in list order, starting at 1 */
+	if (!name || !*name) {
+		if (numid > 0 && numid <= ctl->card->n_elem) {
+			return numid - 1;
+		}
+		return SND_CTL_EXT_KEY_NOT_FOUND;
+	}
+	if (snd_ctl_elem_id_get_index (id) != 0) {
+		return SND_CTL_EXT_KEY_NOT_FOUND;
+	}
+	if (numid > 0 && numid <= ctl->card->n_elem && !strcmp (ctl->card->elem[numid - 1].name, name)) {
+		return numid - 1;
+	}
+	for (unsigned int i = 0; i < ctl->card->n_elem; ++i) {
+		if (!strcmp (ctl->card->elem[i].name, name)) {
+			return i;
+		}
+	}
+	return SND_CTL_EXT_KEY_NOT_FOUND;
+}
+
+static int emu_get_attribute (snd_ctl_ext_t* ext, snd_ctl_ext_key_t key, int* type, unsigned int* acc, unsigned int* count)
+{
+	EmuCtl* ctl = (EmuCtl*)ext->private_data;
+	if (key >= ctl->card->n_elem) {
+		return -EINVAL;
+	}
+	EmuElem const* e = &ctl->card->elem[key];
+	*type  = e->type;
+	*acc   = e->access;
+	*count = e->count;
+	return 0;
+}
+
+static int emu_get_integer_info (snd_ctl_ext_t* ext, snd_ctl_ext_key_t key, long* imin, long* imax, long* istep)
+{
+	*imin  = 0;
+	*imax  = EMU_VOL_MAX;
+	*istep = 1;
+	return 0;
+}
+
+static int emu_get_enumerated_info (snd_ctl_ext_t* ext, snd_ctl_ext_key_t key, unsigned int* items)
+{
+	EmuCtl* ctl = (EmuCtl*)ext->private_data;
+	*items = ctl->card->elem[key].n_items;
+	return 0;
+}
+
+static int emu_get_enumerated_name (snd_ctl_ext_t* ext, snd_ctl_ext_key_t key, unsigned int item, char* name, size_t name_max_len)
+{
+	EmuCtl*        ctl = (EmuCtl*)ext->private_data;
+	EmuElem const* e   = &ctl->card->elem[key];
+	if (item >= e->n_items) {
+		return -EINVAL;
+	}
+	snprintf (name, name_max_len, "%s", e->items[item]);
+	return 0;
+}
+
+static int emu_read_integer (snd_ctl_ext_t* ext, snd_ctl_ext_key_t key, long* value)
+{
+	EmuCtl* ctl = (EmuCtl*)ext->private_data;
+	if (ctl->read_latency) {
+		usleep (ctl->read_latency);
+	}
+	pthread_mutex_lock (&emu_lock);
+	EmuElem const* e = &ctl->card->elem[key];
+	for (unsigned int i = 0; i < e->count; ++i) {
+		value[i] = e->val[i];
+	}
+	pthread_mutex_unlock (&emu_lock);
+	return 0;
+}
+
+static int emu_read_enumerated (snd_ctl_ext_t* ext, snd_ctl_ext_key_t key, unsigned int* items)
+{
+	EmuCtl* ctl = (EmuCtl*)ext->private_data;
+	if (ctl->read_latency) {
+		usleep (ctl->read_latency);
+	}
+	pthread_mutex_lock (&emu_lock);
+	items[0] = ctl->card->elem[key].val[0];
+	pthread_mutex_unlock (&emu_lock);
+	return 0;
+}
+
+/* Like the USB driver, a transfer only happens when the value changes.
+ * The lock is held during the latency: writes are serialized as they
+ * are on the bus. */
+static int emu_write (EmuCtl* ctl, snd_ctl_ext_key_t key, long const* value)
+{
+	EmuElem* e       = &ctl->card->elem[key];
+	bool     changed = false;
+
+	pthread_mutex_lock (&emu_lock);
+	for (unsigned int i = 0; i < e->count; ++i) {
+		if (e->val[i] != value[i]) {
+			changed = true;
+		}
+	}
+	if (changed) {
+		if (ctl->latency) {
+			usleep (ctl->latency);
+		}
+		for (unsigned int i = 0; i < e->count; ++i) {
+			e->val[i] = value[i];
+		}
+		emu_notify (ctl->card, key);
+	}
+	pthread_mutex_unlock (&emu_lock);
+	return changed ? 1 : 0;
+}
+
+static int emu_write_integer (snd_ctl_ext_t* ext, snd_ctl_ext_key_t key, long* value)
+{
+	EmuCtl*        ctl = (EmuCtl*)ext->private_data;
+	EmuElem const* e   = &ctl->card->elem[key];
+	const long     max = e->type == SND_CTL_ELEM_TYPE_BOOLEAN ? 1 : EMU_VOL_MAX;
+	for (unsigned int i = 0; i < e->count; ++i) {
+		if (value[i] < 0 || value[i] > max) {
+			return -EINVAL;
+		}
+	}
+	return emu_write (ctl, key, value);
+}
+
+static int emu_write_enumerated (snd_ctl_ext_t* ext, snd_ctl_ext_key_t key, unsigned int* items)
+{
+	EmuCtl*        ctl = (EmuCtl*)ext->private_data;
+	EmuElem const* e   = &ctl->card->elem[key];
+	if (!(e->access & SND_CTL_EXT_ACCESS_WRITE)) {
+		return -EPERM;
+	}
+	if (items[0] >= e->n_items) {
+		return -EINVAL;
+	}
+	const long v = items[0];
+	return emu_write (ctl, key, &v);
+}
+
+static int emu_read_tlv (snd_ctl_ext_t* ext, snd_ctl_ext_key_t key, int op_flag, unsigned int numid, unsigned int* tlv, unsigned int tlv_size)
+{
+	if (op_flag != 0) {
+		return -ENXIO;
+	}
+	if (tlv_size < 4 * sizeof (unsigned int)) {
+		return -ENOMEM;
+	}
+	tlv[0] = SND_CTL_TLVT_DB_SCALE;
+	tlv[1] = 2 * sizeof (unsigned int);
+	tlv[2] = (unsigned int)EMU_DB_MIN;
+	tlv[3] = EMU_DB_STEP;
+	return 0;
+}
+
+static void emu_subscribe_events (snd_ctl_ext_t* ext, int subscribe)
+{
+	EmuCtl* ctl = (EmuCtl*)ext->private_data;
+	char    buf[64];
+	pthread_mutex_lock (&emu_lock);
+	ctl->subscribed = subscribe != 0;
+	if (!ctl->subscribed) {
+		memset (ctl->pending, 0, ctl->card->n_elem);
+		ctl->ev_r = ctl->ev_w = 0;
+		while (read (ctl->fd[0], buf, sizeof (buf)) > 0) ;
+	}
+	pthread_mutex_unlock (&emu_lock);
+}
+
+static int emu_read_event (snd_ctl_ext_t* ext, snd_ctl_elem_id_t* id, unsigned int* event_mask)
+{
+	EmuCtl* ctl = (EmuCtl*)ext->private_data;
+	char    b;
+
+	pthread_mutex_lock (&emu_lock);
+	if (ctl->ev_r == ctl->ev_w) {
+		pthread_mutex_unlock (&emu_lock);
+		return -EAGAIN;
+	}
+	const unsigned key = ctl->evq[ctl->ev_r];
+	ctl->ev_r = (ctl->ev_r + 1) % (ctl->card->n_elem + 1);
+	ctl->pending[key] = 0;
+	if (read (ctl->fd[0], &b, 1) != 1) {
+		; // see emu_notify ()
+	}
+	pthread_mutex_unlock (&emu_lock);
+
+	snd_ctl_elem_id_set_numid (id, key + 1);
+	snd_ctl_elem_id_set_interface (id, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_id_set_name (id, ctl->card->elem[key].name);
+	*event_mask = SND_CTL_EVENT_MASK_VALUE;
+	return 1;
+}
+
+static void emu_close (snd_ctl_ext_t* ext)
+{
+	EmuCtl*  ctl  = (EmuCtl*)ext->private_data;
+	EmuCard* card = ctl->card;
+
+	pthread_mutex_lock (&emu_lock);
+	for (EmuCtl** p = &card->ctls; *p; p = &(*p)->next) {
+		if (*p == ctl) {
+			*p = ctl->next;
+			break;
+		}
+	}
+	if (--card->refcnt == 0) {
+		emu_card_free (card);
+	}
+	pthread_mutex_unlock (&emu_lock);
+
+	close (ctl->fd[0]);
+	close (ctl->fd[1]);
+	free (ctl->evq);
+	free (ctl->pending);
+	free (ctl);
+}
+
+static const snd_ctl_ext_callback_t emu_callback = {
+	.close                = emu_close,
+	.elem_count           = emu_elem_count,
+	.elem_list            = emu_elem_list,
+	.find_elem            = emu_find_elem,
+	.get_attribute        = emu_get_attribute,
+	.get_integer_info     = emu_get_integer_info,
+	.get_enumerated_info  = emu_get_enumerated_info,
+	.get_enumerated_name  = emu_get_enumerated_name,
+	.read_integer         = emu_read_integer,
+	.read_enumerated      = emu_read_enumerated,
+	.write_integer        = emu_write_integer,
+	.write_enumerated     = emu_write_enumerated,
+	.subscribe_events     = emu_subscribe_events,
+	.read_event           = emu_read_event,
+};
+
+/* *****************************************************************************
+ * Plugin entry
+ */
+
+SND_CTL_PLUGIN_DEFINE_FUNC (scarlett)
+{
+	snd_config_iterator_t i, next;
+	const char* device       = NULL;
+	long        latency      = 0;
+	long        read_latency = 0;
+	int         err;
+
+	snd_config_for_each (i, next, conf) {
+		snd_config_t* n = snd_config_iterator_entry (i);
+		const char*   id;
+		if (snd_config_get_id (n, &id) < 0) {
+			continue;
+		}
+		if (!strcmp (id, "comment") || !strcmp (id, "type") || !strcmp (id, "hint")) {
+			continue;
+		}
+		if (!strcmp (id, "device")) {
+			if (snd_config_get_string (n, &device) < 0) {
+				SNDERR ("Invalid type for %s", id);
+				return -EINVAL;
+			}
+			continue;
+		}
+		if (!strcmp (id, "latency")) {
+			if (snd_config_get_integer (n, &latency) < 0 || latency < 0) {
+				SNDERR ("Invalid value for %s", id);
+				return -EINVAL;
+			}
+			continue;
+		}
+		if (!strcmp (id, "read_latency")) {
+			if (snd_config_get_integer (n, &read_latency) < 0 || read_latency < 0) {
+				SNDERR ("Invalid value for %s", id);
+				return -EINVAL;
+			}
+			continue;
+		}
+		SNDERR ("Unknown field %s", id);
+		return -EINVAL;
+	}
+
+	int dev = device ? -1 : 0;
+	for (unsigned int d = 0; d < NUM_DEVICES && dev < 0; ++d) {
+		if (strstr (devices[d].name, device)) {
+			dev = d;
+		}
+	}
+	if (dev < 0) {
+		SNDERR ("Device '%s' is not supported", device);
+		return -ENODEV;
+	}
+
+	EmuCtl* ctl = (EmuCtl*)calloc (1, sizeof (EmuCtl));
+	if (!ctl) {
+		return -ENOMEM;
+	}
+	if (pipe2 (ctl->fd, O_NONBLOCK | O_CLOEXEC)) {
+		err = -errno;
+		free (ctl);
+		return err;
+	}
+
+	pthread_mutex_lock (&emu_lock);
+	EmuCard* card = &emu_cards[dev];
+	if (card->refcnt == 0 && (err = emu_card_init (card, &devices[dev])) < 0) {
+		pthread_mutex_unlock (&emu_lock);
+		close (ctl->fd[0]);
+		close (ctl->fd[1]);
+		free (ctl);
+		return err;
+	}
+	++card->refcnt;
+	ctl->card    = card;
+	ctl->next    = card->ctls;
+	card->ctls   = ctl;
+	ctl->evq     = (unsigned*)calloc (card->n_elem + 1, sizeof (unsigned));
+	ctl->pending = (uint8_t*)calloc (card->n_elem, sizeof (uint8_t));
+	pthread_mutex_unlock (&emu_lock);
+
+	ctl->latency      = latency;
+	ctl->read_latency = read_latency;
+
+	ctl->ext.version  = SND_CTL_EXT_VERSION;
+	ctl->ext.card_idx = 0;
+	strncpy (ctl->ext.id, "Scarlett", sizeof (ctl->ext.id) - 1);
+	strncpy (ctl->ext.driver, "USB-Audio", sizeof (ctl->ext.driver) - 1);
+	strncpy (ctl->ext.name, devices[dev].name, sizeof (ctl->ext.name) - 1);
+	snprintf (ctl->ext.longname, sizeof (ctl->ext.longname), "Focusrite %.48s (emulated)", devices[dev].name);
+	strncpy (ctl->ext.mixername, devices[dev].name, sizeof (ctl->ext.mixername) - 1);
+	ctl->ext.poll_fd      = ctl->fd[0];
+	ctl->ext.callback     = &emu_callback;
+	ctl->ext.private_data = ctl;
+	ctl->ext.tlv.c        = emu_read_tlv;
+
+	if ((err = snd_ctl_ext_create (&ctl->ext, name, mode)) < 0) {
+		emu_close (&ctl->ext);
+		return err;
+	}
+
+	*handlep = ctl->ext.handle;
+	return 0;
+}
+
+SND_CTL_PLUGIN_SYMBOL (scarlett);
@@ -0,0 +1,94 @@
+/* scarlett mixer - device descriptions
+ *
+ * Copyright 2015-2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifndef SCARLETT_DEVICE_H
+#define SCARLETT_DEVICE_H
+
+/* device specifics, see also
+ * https://git.kernel.org/pub/scm/linux/kernel/git/torvalds/linux.git/tree/sound/usb/mixer_scarlett.c#n635
+ */
+
+#include "scarlett_device.h"
+
+static Device devices[] = {
+	{
+		.name = "Scarlett 18i6 USB",
+		.smi = 18, .smo = 6,
+		.sin = 18, .sout = 6,
+		.smst = 3,
+		.num_hiz = 2,
+		.num_pad = 0,
+		.matrix_mix_offset = 33, .matrix_mix_stride = 7,
+		.matrix_in_offset = 32, .matrix_in_stride = 7,
+		.input_offset = 14,
+		.out_gain_map = (int[]) { 1 /* Monitor */, 4 /* Headphone */, 7 /* SPDIF */ }, // PBS
+		.out_gain_labels = (char[][16]) { "Monitor", "Headphone", "SPDIF" },
+		.out_bus_map = (int[]) { 2, 3, 5, 6, 8, 9 }, // Source, ENUM
+		.hiz_map = (int[]) { 12, 13 },
+	},
+	{
+		.name = "Scarlett 18i8 USB",
+		.smi = 18, .smo = 8,
+		.sin = 18, .sout = 8,
+		.smst = 4,
+		.num_hiz = 2,
+		.num_pad = 4,
+		.matrix_mix_offset = 40, .matrix_mix_stride = 9, // < Matrix 01 Mix A
+		.matrix_in_offset = 39, .matrix_in_stride = 9,   // Matrix 01 Input, ENUM
+		.input_offset = 21,   // < Input Source 01, ENUM
+		.out_gain_map = (int[]) { 1 /* Monitor */, 4 /* Headphone 1 */, 7 /* Headphone 2 */, 10 /* SPDIF */ },
+		.out_gain_labels = (char[][16]) { "Monitor", "Headphone 1", "Headphone 2", "SPDIF" },
+		.out_bus_map = (int[]) { 2, 3, 5, 6, 8, 9, 11, 12 },
+		.hiz_map = (int[]) { 15, 17 }, // < Input 1 Impedance, ENUM,  Input 2 Impedance, ENUM
+		.pad_map = (int[]) { 16, 18, 19, 20 },
+	},
+	{
+		.name = "Scarlett 6i6 USB",
+		.smi = 6, .smo = 6,
+		.sin = 6, .sout = 6,
+		.smst = 3,
+		.num_hiz = 2,
+		.num_pad = 4, // XXX does the device have pad? bug in kernel-driver?
+		.matrix_mix_offset = 26, .matrix_mix_stride = 9, // XXX stride should be 7, bug in kernel-driver ?!
+		.matrix_in_offset = 25, .matrix_in_stride = 9,   // XXX stride should be 7, bug in kernel-driver ?!
+		.out_gain_map = (int[]) { 1 /* Monitor */, 4 /* Headphone */, 7 /* SPDIF */ },
+		.out_gain_labels = (char[][16]) { "Monitor", "Headphone", "SPDIF" },
+		.out_bus_map = (int[]) { 2, 3, 5, 6, 8, 9 },
+		.input_offset = 18,
+		.hiz_map = (int[]) { 12, 14 },
+		.pad_map = (int[]) { 13, 15, 16, 17 },
+	},
+	{
+		.name = "Scarlett 18i20 USB",
+		.smi = 18, .smo = 8,
+		.sin = 18, .sout = 20,
+		.smst = 10,
+		.num_hiz = 0,
+		.num_pad = 0,
+		.matrix_mix_offset = 50, .matrix_mix_stride = 9,
+		.matrix_in_offset = 49, .matrix_in_stride = 9,
+		.input_offset = 31,
+		.out_gain_map = (int[]) { 1, 7, 10, 13, 16, 19, 22, 25, 28, 2 },
+		.out_gain_labels = (char[][16]) { "Monitor", "Line 3/4", "Line 5/6", "Line 7/8", "Line 9/10", "SPDIF", "ADAT 1/2", "ADAT 3/4", "ADAT 5/6", "ADAT 7/8" },
+		.out_bus_map = (int[]) { 5, 6, 8, 9, 11, 12, 14, 15, 17, 18, 20, 21, 23, 24, 26, 27, 29, 30, 3, 4 },
+	},
+};
+
+#define NUM_DEVICES     (sizeof (devices) / sizeof (devices[0]))
+
+#endif
@@ -0,0 +1,1116 @@
+/* scarlett mixer - device access library
+ *
+ * Copyright 2015-2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "scarlett_core.h"
+#include "device.h"
+
+int scarlett_verbose = 0;
+
+/* *****************************************************************************
+ * Device description
+ */
+
+Device* scarlett_device (unsigned int n)
+{
+	return n < NUM_DEVICES ? &devices[n] : NULL;
+}
+
+void scarlett_dump_device (Device const* d)
+{
+	printf ("--- Device: %s\n", d->name);
+	printf ("Matrix: in=%d, out=%d, off=%d, stride=%d\n",
+			d->smi, d->smo, d->matrix_mix_offset, d->matrix_mix_stride);
+	printf ("Matrix: input-select=%d, select-stride=%d\n",
+			d->matrix_in_offset, d->matrix_in_stride);
+	printf ("Inputs: ins=%d select-offset=%d\n",
+			d->sin, d->input_offset);
+	printf ("Masters: n_mst=%d n_out-select=%d\n",
+			d->smst, d->sout);
+	printf ("Switches: n_pad=%d, n_hiz=%d\n",
+			d->num_pad, d->num_hiz);
+
+#define DUMP_ARRAY(name, len, fmt)  \
+  printf (#name " = {");            \
+  for (int i = 0; i < len; ++i) {   \
+    printf (fmt ", ", d->name[i]);  \
+  }                                 \
+  printf ("};\n");
+
+	DUMP_ARRAY (hiz_map, d->num_hiz, "%d");
+	DUMP_ARRAY (pad_map, d->num_pad, "%d");
+	DUMP_ARRAY (out_gain_map, d->smst, "%d");
+	DUMP_ARRAY (out_gain_labels, d->smst, "%s");
+	DUMP_ARRAY (out_bus_map, d->sout, "%d");
+	if (d->matrix_mix_map) {
+		DUMP_ARRAY (matrix_mix_map, d->smi * d->smo, "%d");
+	}
+	if (d->matrix_in_map) {
+		DUMP_ARRAY (matrix_in_map, d->smi, "%d");
+	}
+	if (d->input_map) {
+		DUMP_ARRAY (input_map, d->sin, "%d");
+	}
+	printf ("---\n");
+}
+
+/* *****************************************************************************
+ * Open, detect and close
+ */
+
+static int elem_changed (snd_mixer_elem_t* elem, unsigned int mask)
+{
+	if (mask & SND_CTL_EVENT_MASK_VALUE) {
+		ScarlettCtrl* c = (ScarlettCtrl*)snd_mixer_elem_get_callback_private (elem);
+		c->changed = true;
+	}
+	return 0;
+}
+
+static void device_free (Device* d)
+{
+	free (d->out_gain_map);
+	free (d->out_gain_labels);
+	free (d->out_bus_map);
+	free (d->hiz_map);
+	free (d->pad_map);
+	free (d->matrix_mix_map);
+	free (d->matrix_in_map);
+	free (d->input_map);
+	memset (d, 0, sizeof (Device));
+}
+
+/* largest control index used by the device description, -1 if invalid */
+static int device_max_ctrl (Device const* d)
+{
+	int rv = 0;
+#define MAX_IDX(idx) { const int v = (idx); if (v < 0) { return -1; } if (v > rv) { rv = v; } }
+	for (unsigned int r = 0; r < d->smi; ++r) {
+		MAX_IDX (d->matrix_in_map ? d->matrix_in_map[r] : (int)(d->matrix_in_offset + r * d->matrix_in_stride));
+		for (unsigned int c = 0; c < d->smo; ++c) {
+			MAX_IDX (d->matrix_mix_map ? d->matrix_mix_map[r * d->smo + c] : (int)(d->matrix_mix_offset + r * d->matrix_mix_stride + c));
+		}
+	}
+	for (unsigned int i = 0; i < d->sin; ++i)     { MAX_IDX (d->input_map ? d->input_map[i] : (int)(d->input_offset + i)); }
+	for (unsigned int i = 0; i < d->smst; ++i)    { MAX_IDX (d->out_gain_map[i]); }
+	for (unsigned int i = 0; i < d->sout; ++i)    { MAX_IDX (d->out_bus_map[i]); }
+	for (unsigned int i = 0; i < d->num_hiz; ++i) { MAX_IDX (d->hiz_map[i]); }
+	for (unsigned int i = 0; i < d->num_pad; ++i) { MAX_IDX (d->pad_map[i]); }
+#undef MAX_IDX
+	return rv;
+}
+
+/* resolve matrix and input controls once, so that lookups do not
+ * depend on the kernel-driver's layout */
+static int device_index (ScarlettMixer* m)
+{
+	Device const* d = m->device;
+	const int max = device_max_ctrl (d);
+	if (max < 0 || max >= (int)m->ctrl_cnt) {
+		fprintf (stderr, "Device description of `%s' does not match the mixer\n", d->name);
+		return -1;
+	}
+
+	m->mtx_idx  = (unsigned int*)malloc (d->smi * d->smo * sizeof (unsigned int));
+	m->msel_idx = (unsigned int*)malloc (d->smi * sizeof (unsigned int));
+	m->src_idx  = (unsigned int*)malloc (d->sin * sizeof (unsigned int));
+
+	for (unsigned int r = 0; r < d->smi; ++r) {
+		m->msel_idx[r] = d->matrix_in_map ? d->matrix_in_map[r] : d->matrix_in_offset + r * d->matrix_in_stride;
+		for (unsigned int c = 0; c < d->smo; ++c) {
+			const unsigned int n = r * d->smo + c;
+			m->mtx_idx[n] = d->matrix_mix_map ? d->matrix_mix_map[n] : d->matrix_mix_offset + r * d->matrix_mix_stride + c;
+		}
+	}
+	for (unsigned int i = 0; i < d->sin; ++i) {
+		m->src_idx[i] = d->input_map ? d->input_map[i] : d->input_offset + i;
+	}
+	return 0;
+}
+
+/* index tables from control names, "Matrix 01 Mix A", "Matrix 01 Input"
+ * and "Input Source 01". Leaves them unset, unless complete */
+static void detect_index (ScarlettMixer* m, Device* d)
+{
+	int* mix = (int*)malloc (d->smi * d->smo * sizeof (int));
+	int* min = (int*)malloc (d->smi * sizeof (int));
+	int* src = (int*)malloc (d->sin * sizeof (int));
+
+	for (unsigned int n = 0; n < d->smi * d->smo; ++n) { mix[n] = -1; }
+	for (unsigned int n = 0; n < d->smi; ++n) { min[n] = -1; }
+	for (unsigned int n = 0; n < d->sin; ++n) { src[n] = -1; }
+
+	for (unsigned int i = 0; i < m->ctrl_cnt; ++i) {
+		const char* name = m->ctrl[i].name;
+		unsigned int r;
+		char x;
+		int len = 0;
+		if (sscanf (name, "Matrix %u Mix %c%n", &r, &x, &len) == 2 && len > 0) {
+			if (r >= 1 && r <= d->smi && x >= 'A' && x < 'A' + (int)d->smo) {
+				mix[(r - 1) * d->smo + x - 'A'] = i;
+			}
+		} else if (sscanf (name, "Matrix %u Input%n", &r, &len) == 1 && len > 0) {
+			if (r >= 1 && r <= d->smi) {
+				min[r - 1] = i;
+			}
+		} else if (sscanf (name, "Input Source %u%n", &r, &len) == 1 && len > 0) {
+			if (r >= 1 && r <= d->sin) {
+				src[r - 1] = i;
+			}
+		}
+	}
+
+	bool ok = true;
+	for (unsigned int n = 0; n < d->smi * d->smo; ++n) { ok &= mix[n] >= 0; }
+	for (unsigned int n = 0; n < d->smi; ++n) { ok &= min[n] >= 0; }
+	for (unsigned int n = 0; n < d->sin; ++n) { ok &= src[n] >= 0; }
+
+	if (!ok) {
+		free (mix);
+		free (min);
+		free (src);
+		return;
+	}
+	d->matrix_mix_map = mix;
+	d->matrix_in_map  = min;
+	d->input_map      = src;
+}
+
+int scarlett_open (ScarlettMixer* m, const char* card, int opts)
+{
+	int rv = 0;
+	int err;
+	snd_mixer_selem_id_t *sid;
+	snd_mixer_elem_t *elem;
+	snd_mixer_selem_id_alloca (&sid);
+
+	snd_ctl_t *hctl;
+	snd_ctl_card_info_t *card_info;
+	snd_ctl_card_info_alloca (&card_info);
+
+	pthread_mutex_init (&m->lock, NULL);
+
+	if ((err = snd_ctl_open (&hctl, card, 0)) < 0) {
+		fprintf (stderr, "Control device %s open error: %s\n", card, snd_strerror (err));
+		return err;
+	}
+
+	if ((err = snd_ctl_card_info (hctl, card_info)) < 0) {
+		fprintf (stderr, "Control device %s hw info error: %s\n", card, snd_strerror (err));
+		return err;
+	}
+
+	const char* card_name = snd_ctl_card_info_get_name (card_info);
+	snd_ctl_close (hctl);
+
+	if (!card_name) {
+		fprintf (stderr, "Device `%s' is unknown\n", card);
+		return -1;
+	}
+
+	m->device = NULL;
+
+	for (unsigned i = 0; i < NUM_DEVICES; i++) {
+		if (!strcmp (card_name, devices[i].name))
+			m->device = &devices[i];
+	}
+
+	if (m->device == NULL) {
+		fprintf (stderr, "Device `%s' is not supported\n", card);
+		rv = -1;
+		if ((opts & SCARLETT_PROBE) == 0) {
+			return -1;
+		}
+	}
+
+	if ((err = snd_mixer_open (&m->mixer, 0)) < 0) {
+		fprintf (stderr, "Mixer %s open error: %s\n", card, snd_strerror (err));
+		return err;
+	}
+	if ((err = snd_mixer_attach (m->mixer, card)) < 0) {
+		fprintf (stderr, "Mixer attach %s error: %s\n", card, snd_strerror (err));
+		snd_mixer_close (m->mixer);
+		return err;
+	}
+	if ((err = snd_mixer_selem_register (m->mixer, NULL, NULL)) < 0) {
+		fprintf (stderr, "Mixer register error: %s\n", snd_strerror (err));
+		snd_mixer_close (m->mixer);
+		return err;
+	}
+	err = snd_mixer_load (m->mixer);
+	if (err < 0) {
+		fprintf (stderr, "Mixer %s load error: %s\n", card, snd_strerror (err));
+		snd_mixer_close (m->mixer);
+		return err;
+	}
+
+	int cnt = 0;
+
+	for (elem = snd_mixer_first_elem (m->mixer); elem; elem = snd_mixer_elem_next (elem)) {
+		if (!snd_mixer_selem_is_active (elem)) {
+			continue;
+		}
+		++cnt;
+	}
+
+	m->ctrl_cnt = cnt;
+
+	if (cnt == 0) {
+		fprintf (stderr, "Mixer %s: no controls found\n", card);
+		return -1;
+	}
+
+	if (opts & SCARLETT_PROBE) {
+		fprintf (stderr, "Device `%s' has %d contols: \n", card_name, cnt);
+	}
+
+	m->ctrl = (ScarlettCtrl*)calloc (cnt, sizeof (ScarlettCtrl));
+	m->card = strdup (card);
+
+	Device d;
+	memset (&d, 0, sizeof (Device));
+	strncpy (d.name, card_name, 63);
+	if (opts & SCARLETT_DETECT) {
+		/* no device has more of any kind than it has controls */
+		d.out_gain_map    = (int*)calloc (cnt, sizeof (int));
+		d.out_gain_labels = (char (*)[16])calloc (cnt, sizeof (char[16]));
+		d.out_bus_map     = (int*)calloc (cnt, sizeof (int));
+		d.hiz_map         = (int*)calloc (cnt, sizeof (int));
+		d.pad_map         = (int*)calloc (cnt, sizeof (int));
+	}
+	int obm = 0;
+
+	int i = 0;
+	for (elem = snd_mixer_first_elem (m->mixer); elem; elem = snd_mixer_elem_next (elem)) {
+		if (!snd_mixer_selem_is_active (elem)) {
+			continue;
+		}
+
+		ScarlettCtrl* c = &m->ctrl[i];
+		c->elem = elem;
+		c->name = strdup (snd_mixer_selem_get_name (elem));
+		snd_mixer_elem_set_callback (elem, elem_changed);
+		snd_mixer_elem_set_callback_private (elem, c);
+
+		if (opts & SCARLETT_DETECT) {
+			if (snd_mixer_selem_is_enumerated (elem)) {
+				if (strstr (c->name, " Impedance")) {
+					d.hiz_map[d.num_hiz++] = i;
+				}
+				if (strstr (c->name, " Pad")) {
+					d.pad_map[d.num_pad++] = i;
+				}
+				if (strstr (c->name, "Input Source 01")) {
+					assert (d.input_offset == 0);
+					d.input_offset = i;
+				}
+				if (strstr (c->name, "Input Source")) {
+					++d.sin;
+				}
+				if (strstr (c->name, "Matrix 01 Input")) {
+					assert (d.matrix_in_offset == 0);
+					d.matrix_in_offset = i;
+				}
+				if (strstr (c->name, "Matrix ") && strstr (c->name, " Input")) {
+					++d.smi;
+				}
+				if (strstr (c->name, "Master ")) { // Source enum
+					d.out_bus_map[obm++] = i;
+				}
+			} else if (snd_mixer_selem_has_playback_switch (elem)) {
+				if (strstr (c->name, "Master ")) {
+					char* t1 = strchr (c->name, '(');
+					char* t2 = t1 ? strchr (t1, ')') : NULL;
+					if (t2) {
+						++t1;
+						const size_t len = t2 - t1 < 15 ? t2 - t1 : 15;
+						strncpy (d.out_gain_labels[d.smst], t1, len);
+						d.out_gain_labels[d.smst][len] = '\0';
+					}
+					d.out_gain_map[d.smst++] = i;
+					d.sout = d.smst * 2;
+				}
+			} else if (snd_mixer_selem_has_capture_switch (elem)) {
+				;
+			} else {
+				if (strstr (c->name, "Matrix 01 Mix A")) {
+					d.matrix_mix_offset = i;
+				}
+				if (strstr (c->name, "Matrix ") && strstr (c->name, " Mix ")) {
+					int last = c->name[strlen (c->name) - 1] - 'A' + 1;
+					if (last > 0 && last <= 26 && last > (int)d.smo) {
+						d.smo = last;
+
+						d.matrix_mix_stride = d.smo + 1;
+						d.matrix_in_stride = d.smo + 1;
+					}
+				}
+			}
+		}
+
+		if (opts & SCARLETT_PROBE) {
+			printf (" %d '%s'", i, c->name);
+			if (snd_mixer_selem_is_enumerated (elem)) { printf (", ENUM"); }
+			if (snd_mixer_selem_has_playback_switch (elem)) { printf (", PBS"); }
+			if (snd_mixer_selem_has_capture_switch (elem)) { printf (", CPS"); }
+			printf ("\n");
+		}
+		++i;
+		assert (i <= cnt);
+	}
+
+	if ((opts & SCARLETT_DETECT) && rv == 0 && m->device) {
+		if (d.smi != 0 && d.smo != 0) {
+			detect_index (m, &d);
+		}
+		if (scarlett_verbose > 1) {
+			scarlett_dump_device (&d);
+			scarlett_dump_device (m->device);
+		}
+		if (d.smi != 0 && d.smo != 0 && d.sin != 0 && d.sout != 0 && d.smst != 0 && d.input_offset != 0 && d.matrix_in_offset != 0 && d.matrix_mix_offset != 0 && obm >= (int)d.sout) {
+			if (scarlett_verbose) {
+				printf ("Using autodetected mapping.\n");
+			}
+			memcpy (&m->dev, &d, sizeof (Device));
+			m->device = &m->dev;
+		} else {
+			device_free (&d);
+		}
+	} else {
+		device_free (&d);
+	}
+
+	if (rv == 0 && device_index (m)) {
+		rv = -1;
+	}
+	return rv;
+}
+
+void scarlett_close (ScarlettMixer* m)
+{
+	for (unsigned int i = 0; i < m->ctrl_cnt; ++i) {
+		free (m->ctrl[i].name);
+	}
+	free (m->ctrl);
+	free (m->card);
+	free (m->mtx_idx);
+	free (m->msel_idx);
+	free (m->src_idx);
+	device_free (&m->dev);
+	if (m->mixer) {
+		snd_mixer_close (m->mixer);
+	}
+	pthread_mutex_destroy (&m->lock);
+	memset (m, 0, sizeof (ScarlettMixer));
+}
+
+static bool card_matches (const char* card, const char* name)
+{
+	snd_ctl_t* ctl;
+	snd_ctl_card_info_t* info;
+	snd_ctl_card_info_alloca (&info);
+	if (snd_ctl_open (&ctl, card, 0) < 0) {
+		return false;
+	}
+	bool rv = false;
+	if (snd_ctl_card_info (ctl, info) == 0) {
+		const char* card_name = snd_ctl_card_info_get_name (info);
+		if (scarlett_verbose > 1) {
+			printf ("* %s \"%s\"\n", card, card_name ? card_name : "");
+		}
+		for (unsigned i = 0; card_name && i < NUM_DEVICES; i++) {
+			if (!strcmp (card_name, devices[i].name) && (!name || !strcmp (card_name, name))) {
+				rv = true;
+			}
+		}
+	}
+	snd_ctl_close (ctl);
+	return rv;
+}
+
+char* scarlett_find_card (const char* name, const char* hint)
+{
+	if (hint && card_matches (hint, name)) {
+		return strdup (hint);
+	}
+	int number = -1;
+	while (snd_card_next (&number) == 0 && number >= 0) {
+		char buf[16];
+		sprintf (buf, "hw:%d", number);
+		if (card_matches (buf, name)) {
+			return strdup (buf);
+		}
+	}
+	return NULL;
+}
+
+int scarlett_reopen (ScarlettMixer* m, const char* card)
+{
+	snd_mixer_t* mixer;
+	snd_mixer_elem_t* elem;
+	if (!m->mixer || snd_mixer_open (&mixer, 0) < 0) {
+		return -1;
+	}
+	if (snd_mixer_attach (mixer, card) < 0
+	    || snd_mixer_selem_register (mixer, NULL, NULL) < 0
+	    || snd_mixer_load (mixer) < 0) {
+		snd_mixer_close (mixer);
+		return -1;
+	}
+
+	unsigned int i = 0;
+	for (elem = snd_mixer_first_elem (mixer); elem; elem = snd_mixer_elem_next (elem)) {
+		if (!snd_mixer_selem_is_active (elem)) {
+			continue;
+		}
+		if (i >= m->ctrl_cnt || strcmp (snd_mixer_selem_get_name (elem), m->ctrl[i].name)) {
+			break;
+		}
+		++i;
+	}
+	if (elem || i != m->ctrl_cnt) {
+		fprintf (stderr, "Mixer %s has different controls\n", card);
+		snd_mixer_close (mixer);
+		return -1;
+	}
+
+	pthread_mutex_lock (&m->lock);
+	i = 0;
+	for (elem = snd_mixer_first_elem (mixer); elem; elem = snd_mixer_elem_next (elem)) {
+		if (!snd_mixer_selem_is_active (elem)) {
+			continue;
+		}
+		ScarlettCtrl* c = &m->ctrl[i++];
+		c->elem    = elem;
+		c->changed = false;
+		snd_mixer_elem_set_callback (elem, elem_changed);
+		snd_mixer_elem_set_callback_private (elem, c);
+	}
+
+	snd_mixer_close (m->mixer);
+	m->mixer = mixer;
+	free (m->card);
+	m->card = strdup (card);
+	pthread_mutex_unlock (&m->lock);
+	return 0;
+}
+
+/* *****************************************************************************
+ * Offline mixer
+ */
+
+/* Offline mixer: controls are laid out according to the device
+ * description and hold their value in ScarlettCtrl::val. Used to build
+ * and benchmark the GUI without hardware. Like ALSA, writes that
+ * modify a value flag the control as changed. */
+
+static void mock_ctrl (ScarlettMixer* m, int id, int type, int n_items)
+{
+	if (id < 0) {
+		return;
+	}
+	assert ((unsigned int)id < m->ctrl_cnt);
+	ScarlettCtrl* c = &m->ctrl[id];
+	c->caps |= 1 << type;
+	if (type == SCARLETT_ENUM) {
+		c->n_items = n_items;
+	}
+}
+
+int scarlett_open_offline (ScarlettMixer* m, Device* d)
+{
+	/* enum items: Off, 6 PCM, 8 Analog, 2 SPDIF, 8 ADAT, Mix busses */
+	const int n_src = 25 + (d->sout > d->smo ? d->sout : d->smo);
+
+	pthread_mutex_init (&m->lock, NULL);
+
+	const int max = device_max_ctrl (d);
+	if (max < 0) {
+		fprintf (stderr, "Device description of `%s' is not valid\n", d->name);
+		return -1;
+	}
+	const unsigned int cnt = max + 1;
+
+	m->device   = d;
+	m->mixer    = NULL;
+	m->card     = strdup ("offline");
+	m->ctrl_cnt = cnt;
+	m->ctrl     = (ScarlettCtrl*)calloc (cnt, sizeof (ScarlettCtrl));
+
+	for (unsigned int i = 0; i < cnt; ++i) {
+		char name[64];
+		snprintf (name, sizeof (name), "Offline %u", i);
+		m->ctrl[i].name = strdup (name);
+	}
+
+	if (device_index (m)) {
+		return -1;
+	}
+
+	mock_ctrl (m, 0, SCARLETT_DB, 0);
+	mock_ctrl (m, 0, SCARLETT_MUTE, 0);
+	for (unsigned int r = 0; r < d->smi; ++r) {
+		mock_ctrl (m, m->msel_idx[r], SCARLETT_ENUM, n_src);
+		for (unsigned int c = 0; c < d->smo; ++c) {
+			mock_ctrl (m, m->mtx_idx[r * d->smo + c], SCARLETT_DB, 0);
+		}
+	}
+	for (unsigned int r = 0; r < d->sin; ++r) {
+		mock_ctrl (m, m->src_idx[r], SCARLETT_ENUM, n_src);
+	}
+	for (unsigned int o = 0; o < d->smst; ++o) {
+		mock_ctrl (m, d->out_gain_map[o], SCARLETT_DB, 0);
+		mock_ctrl (m, d->out_gain_map[o], SCARLETT_MUTE, 0);
+	}
+	for (unsigned int o = 0; o < d->sout; ++o) {
+		mock_ctrl (m, d->out_bus_map[o], SCARLETT_ENUM, n_src);
+	}
+	for (unsigned int i = 0; i < d->num_hiz; ++i) {
+		mock_ctrl (m, d->hiz_map[i], SCARLETT_ENUM, 2);
+	}
+	for (unsigned int i = 0; i < d->num_pad; ++i) {
+		mock_ctrl (m, d->pad_map[i], SCARLETT_ENUM, 2);
+	}
+	return 0;
+}
+
+/* *****************************************************************************
+ * Control mapping
+ *
+ * NOTE: these are numerically hardcoded, unless detected from control
+ * names. see `amixer -D hw:2 control` and scarlett-mixer --print-controls
+ */
+
+/* mixer-matrix ; colums(src) x rows (dest) */
+ScarlettCtrl* scarlett_matrix_gain (ScarlettMixer* m, unsigned int c, unsigned int r)
+{
+	/* Matrix 01 Mix A
+	 *  ..
+	 * Matrix 18 Mix F
+	 */
+	if (r >= m->device->smi || c >= m->device->smo) {
+		return NULL;
+	}
+	return &m->ctrl[m->mtx_idx[r * m->device->smo + c]];
+}
+
+/* matrix input selector (per row)*/
+ScarlettCtrl* scarlett_matrix_input (ScarlettMixer* m, unsigned int r)
+{
+	if (r >= m->device->smi) {
+		return NULL;
+	}
+	/* Matrix 01 Input, ENUM
+	 *  ..
+	 * Matrix 18 Input, ENUM
+	 */
+	return &m->ctrl[m->msel_idx[r]];
+}
+
+/* Input/Capture selector */
+ScarlettCtrl* scarlett_capture_source (ScarlettMixer* m, unsigned int r)
+{
+	if (r >= m->device->sin) {
+		return NULL;
+	}
+	/* Input Source 01, ENUM
+	 *  ..
+	 * Input Source 18, ENUM
+	 */
+	return &m->ctrl[m->src_idx[r]];
+}
+
+/* Output Gains */
+ScarlettCtrl* scarlett_output_gain (ScarlettMixer* m, unsigned int c)
+{
+	if (c >= m->device->smst) {
+		return NULL;
+	}
+	return &m->ctrl[m->device->out_gain_map[c]];
+}
+
+/* Output Bus assignment (matrix-out to master) */
+ScarlettCtrl* scarlett_output_source (ScarlettMixer* m, unsigned int c)
+{
+	if (c >= m->device->sout) {
+		return NULL;
+	}
+	return &m->ctrl[m->device->out_bus_map[c]];
+}
+
+/* Hi-Z switches */
+ScarlettCtrl* scarlett_hiz (ScarlettMixer* m, unsigned int c)
+{
+	if (c >= m->device->num_hiz) {
+		return NULL;
+	}
+	return &m->ctrl[m->device->hiz_map[c]];
+}
+
+/* Pad switches */
+ScarlettCtrl* scarlett_pad (ScarlettMixer* m, unsigned int c)
+{
+	if (c >= m->device->num_pad) {
+		return NULL;
+	}
+	return &m->ctrl[m->device->pad_map[c]];
+}
+
+/* master gain */
+ScarlettCtrl* scarlett_master (ScarlettMixer* m)
+{
+	return &m->ctrl[0]; /* Master, PBS */
+}
+
+/* *****************************************************************************
+ * Control access
+ */
+
+void scarlett_set_mute (ScarlettCtrl* c, bool muted)
+{
+	int v = muted ? 0 : 1;
+	if (c && !c->elem) {
+		c->changed |= c->val[SCARLETT_MUTE] != (muted ? 1 : 0);
+		c->val[SCARLETT_MUTE] = muted ? 1 : 0;
+		return;
+	}
+	assert (c && snd_mixer_selem_has_playback_switch (c->elem));
+	for (int chn = 0; chn <= 2; ++chn) {
+		snd_mixer_selem_channel_id_t cid = (snd_mixer_selem_channel_id_t) chn;
+		if (snd_mixer_selem_has_playback_channel (c->elem, cid)) {
+			snd_mixer_selem_set_playback_switch (c->elem, cid, v);
+		}
+	}
+}
+
+bool scarlett_get_mute (ScarlettCtrl* c)
+{
+	int v = 0;
+	if (c && !c->elem) {
+		return c->val[SCARLETT_MUTE] != 0;
+	}
+	assert (c && snd_mixer_selem_has_playback_switch (c->elem));
+	snd_mixer_selem_get_playback_switch (c->elem, (snd_mixer_selem_channel_id_t)0, &v);
+	return v == 0;
+}
+
+float scarlett_get_dB (ScarlettCtrl* c)
+{
+	assert (c);
+	long val = 0;
+	if (!c->elem) {
+		return c->val[SCARLETT_DB] / 100.f;
+	}
+	snd_mixer_selem_get_playback_dB (c->elem, (snd_mixer_selem_channel_id_t)0, &val);
+	return val / 100.f;
+}
+
+void scarlett_set_cdB (ScarlettCtrl* c, long val)
+{
+	if (!c->elem) {
+		c->changed |= c->val[SCARLETT_DB] != val;
+		c->val[SCARLETT_DB] = val;
+		return;
+	}
+	for (int chn = 0; chn <= 2; ++chn) {
+		snd_mixer_selem_channel_id_t cid = (snd_mixer_selem_channel_id_t) chn;
+		if (snd_mixer_selem_has_playback_channel (c->elem, cid)) {
+			snd_mixer_selem_set_playback_dB (c->elem, cid, val, /*playback*/0);
+		}
+		if (snd_mixer_selem_has_capture_channel (c->elem, cid)) {
+			snd_mixer_selem_set_playback_dB (c->elem, cid, val, /*capture*/1);
+		}
+	}
+}
+
+void scarlett_set_dB (ScarlettCtrl* c, float dB)
+{
+	scarlett_set_cdB (c, lrintf (100.f * dB));
+}
+
+float scarlett_get_dB_range (ScarlettCtrl* c, bool maximum)
+{
+	long min, max;
+	min = max = 0;
+	if (!c->elem) {
+		min = -12800;
+		max = 600;
+	} else {
+		snd_mixer_selem_get_playback_dB_range (c->elem, &min, &max);
+	}
+	if (maximum) {
+		return max / 100.f;
+	} else {
+		return min / 100.f;
+	}
+}
+
+void scarlett_set_enum (ScarlettCtrl* c, int v)
+{
+	if (!c->elem) {
+		assert (v >= 0 && v < c->n_items);
+		c->changed |= c->val[SCARLETT_ENUM] != v;
+		c->val[SCARLETT_ENUM] = v;
+		return;
+	}
+	assert (snd_mixer_selem_is_enumerated (c->elem));
+	snd_mixer_selem_set_enum_item (c->elem, (snd_mixer_selem_channel_id_t)0, v);
+}
+
+int scarlett_get_enum (ScarlettCtrl* c)
+{
+	unsigned int idx = 0;
+	if (!c->elem) {
+		return c->val[SCARLETT_ENUM];
+	}
+	assert (snd_mixer_selem_is_enumerated (c->elem));
+	snd_mixer_selem_get_enum_item (c->elem, (snd_mixer_selem_channel_id_t)0, &idx);
+	return idx;
+}
+
+int scarlett_get_enum_items (ScarlettCtrl* c)
+{
+	if (!c->elem) {
+		return c->n_items;
+	}
+	return snd_mixer_selem_get_enum_items (c->elem);
+}
+
+/* item names of the offline mixer follow the 18i8 source list,
+ * which is what src_sel_default() and out_sel_default() assume */
+static void mock_enum_item_name (ScarlettCtrl* c, int item, size_t len, char* name)
+{
+	if (c->n_items == 2) {
+		snprintf (name, len, "%s", item ? "On" : "Off");
+	} else if (item == 0) {
+		snprintf (name, len, "Off");
+	} else if (item < 7) {
+		snprintf (name, len, "PCM %d", item);
+	} else if (item < 15) {
+		snprintf (name, len, "Analog %d", item - 6);
+	} else if (item < 17) {
+		snprintf (name, len, "SPDIF %d", item - 14);
+	} else if (item < 25) {
+		snprintf (name, len, "ADAT %d", item - 16);
+	} else {
+		snprintf (name, len, "Mix %c", 'A' + item - 25);
+	}
+}
+
+int scarlett_get_enum_item_name (ScarlettCtrl* c, int item, size_t len, char* name)
+{
+	if (!c->elem) {
+		if (item < 0 || item >= c->n_items) {
+			return -1;
+		}
+		mock_enum_item_name (c, item, len, name);
+		return 0;
+	}
+	return snd_mixer_selem_get_enum_item_name (c->elem, item, len, name);
+}
+
+unsigned int scarlett_ctrl_id (ScarlettMixer* m, ScarlettCtrl* c)
+{
+	assert (c >= m->ctrl && c < &m->ctrl[m->ctrl_cnt]);
+	return c - m->ctrl;
+}
+
+int32_t scarlett_ctrl_get (ScarlettMixer* m, unsigned int id, int type)
+{
+	ScarlettCtrl* c = &m->ctrl[id];
+	long val = 0;
+	switch (type) {
+		case SCARLETT_DB:
+			if (!c->elem) {
+				return c->val[SCARLETT_DB];
+			}
+			snd_mixer_selem_get_playback_dB (c->elem, (snd_mixer_selem_channel_id_t)0, &val);
+			return val;
+		case SCARLETT_MUTE:
+			return scarlett_get_mute (c) ? 1 : 0;
+		case SCARLETT_ENUM:
+			return scarlett_get_enum (c);
+		default:
+			assert (0);
+	}
+	return 0;
+}
+
+void scarlett_ctrl_set (ScarlettMixer* m, unsigned int id, int type, int32_t val)
+{
+	ScarlettCtrl* c = &m->ctrl[id];
+	switch (type) {
+		case SCARLETT_DB:
+			scarlett_set_cdB (c, val);
+			break;
+		case SCARLETT_MUTE:
+			scarlett_set_mute (c, val != 0);
+			break;
+		case SCARLETT_ENUM:
+			scarlett_set_enum (c, val);
+			break;
+		default:
+			assert (0);
+	}
+}
+
+bool scarlett_ctrl_has (ScarlettMixer* m, unsigned int id, int type)
+{
+	snd_mixer_elem_t* elem = m->ctrl[id].elem;
+	if (!elem) {
+		return m->ctrl[id].caps & (1 << type);
+	}
+	switch (type) {
+		case SCARLETT_DB:
+			return snd_mixer_selem_has_playback_volume (elem);
+		case SCARLETT_MUTE:
+			return snd_mixer_selem_has_playback_switch (elem);
+		case SCARLETT_ENUM:
+			return snd_mixer_selem_is_enumerated (elem);
+		default:
+			break;
+	}
+	return false;
+}
+
+/* *****************************************************************************
+ * Batched access
+ */
+
+static bool vals_valid (ScarlettMixer* m, ScarlettVal const* v, unsigned int n)
+{
+	for (unsigned int i = 0; i < n; ++i) {
+		if (v[i].id >= m->ctrl_cnt || v[i].type >= SCARLETT_TYPES || !scarlett_ctrl_has (m, v[i].id, v[i].type)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int scarlett_read (ScarlettMixer* m, ScarlettVal* v, unsigned int n)
+{
+	pthread_mutex_lock (&m->lock);
+	if (!vals_valid (m, v, n)) {
+		pthread_mutex_unlock (&m->lock);
+		return -1;
+	}
+	for (unsigned int i = 0; i < n; ++i) {
+		v[i].val = scarlett_ctrl_get (m, v[i].id, v[i].type);
+	}
+	pthread_mutex_unlock (&m->lock);
+	return n;
+}
+
+int scarlett_write (ScarlettMixer* m, ScarlettVal const* v, unsigned int n)
+{
+	int rv = 0;
+	pthread_mutex_lock (&m->lock);
+	if (!vals_valid (m, v, n)) {
+		pthread_mutex_unlock (&m->lock);
+		return -1;
+	}
+	for (unsigned int i = 0; i < n; ++i) {
+		if (scarlett_ctrl_get (m, v[i].id, v[i].type) != v[i].val) {
+			scarlett_ctrl_set (m, v[i].id, v[i].type, v[i].val);
+			++rv;
+		}
+	}
+	pthread_mutex_unlock (&m->lock);
+	return rv;
+}
+
+int scarlett_changes (ScarlettMixer* m, ScarlettVal* v, unsigned int n)
+{
+	int rv = 0;
+	pthread_mutex_lock (&m->lock);
+
+	if (m->mixer) {
+		struct pollfd pfd[16];
+		unsigned short revents = 0;
+		int n_fd = snd_mixer_poll_descriptors (m->mixer, pfd, 16);
+		int rp   = -1;
+		if (n_fd >= 0) {
+			while ((rp = poll (pfd, n_fd, 0)) < 0 && errno == EINTR) ;
+		}
+		if (rp < 0
+		    || snd_mixer_poll_descriptors_revents (m->mixer, pfd, n_fd, &revents) < 0
+		    || (revents & (POLLERR | POLLNVAL))) {
+			pthread_mutex_unlock (&m->lock);
+			return -1;
+		}
+		if (revents & POLLIN) {
+			snd_mixer_handle_events (m->mixer);
+		}
+	}
+
+	for (unsigned int id = 0; id < m->ctrl_cnt; ++id) {
+		if (!m->ctrl[id].changed) {
+			continue;
+		}
+		/* report all types of a control or none, the flag stays
+		 * set for the next call */
+		unsigned int n_t = 0;
+		for (int t = 0; t < SCARLETT_TYPES; ++t) {
+			if (scarlett_ctrl_has (m, id, t)) {
+				++n_t;
+			}
+		}
+		if (rv + n_t > n) {
+			break;
+		}
+		m->ctrl[id].changed = false;
+		for (int t = 0; t < SCARLETT_TYPES; ++t) {
+			if (scarlett_ctrl_has (m, id, t)) {
+				v[rv].id   = id;
+				v[rv].type = t;
+				v[rv].val  = scarlett_ctrl_get (m, id, t);
+				++rv;
+			}
+		}
+	}
+	pthread_mutex_unlock (&m->lock);
+	return rv;
+}
+
+/* *****************************************************************************
+ * Shared memory state, see scarlett_shm.h
+ *
+ * The segment is updated under a sequence-lock, readers retry while
+ * the sequence number is odd or changed during their copy.
+ */
+
+static int32_t shm_val (ScarlettMixer* m, ScarlettCtrl* c, int type)
+{
+	return scarlett_ctrl_get (m, scarlett_ctrl_id (m, c), type);
+}
+
+void scarlett_shm_publish (ScarlettMixer* m, ScarlettShm* shm)
+{
+	int32_t* mtx_gain = scarlett_shm_mtx_gain (shm);
+	int32_t* mtx_sel  = scarlett_shm_mtx_sel (shm);
+	int32_t* src_sel  = scarlett_shm_src_sel (shm);
+	int32_t* out_sel  = scarlett_shm_out_sel (shm);
+	int32_t* out_gain = scarlett_shm_out_gain (shm);
+	int32_t* out_mute = scarlett_shm_out_mute (shm);
+	int32_t* hiz      = scarlett_shm_hiz (shm);
+	int32_t* pad      = scarlett_shm_pad (shm);
+
+	pthread_mutex_lock (&m->lock);
+	++shm->seq;
+	__sync_synchronize ();
+
+	for (unsigned int r = 0; r < shm->smi; ++r) {
+		mtx_sel[r] = shm_val (m, scarlett_matrix_input (m, r), SCARLETT_ENUM);
+		for (unsigned int c = 0; c < shm->smo; ++c) {
+			mtx_gain[r * shm->smo + c] = shm_val (m, scarlett_matrix_gain (m, c, r), SCARLETT_DB);
+		}
+	}
+	for (unsigned int i = 0; i < shm->sin; ++i) {
+		src_sel[i] = shm_val (m, scarlett_capture_source (m, i), SCARLETT_ENUM);
+	}
+	for (unsigned int o = 0; o < shm->sout; ++o) {
+		out_sel[o] = shm_val (m, scarlett_output_source (m, o), SCARLETT_ENUM);
+	}
+	for (unsigned int o = 0; o < shm->smst; ++o) {
+		out_gain[o] = shm_val (m, scarlett_output_gain (m, o), SCARLETT_DB);
+		out_mute[o] = shm_val (m, scarlett_output_gain (m, o), SCARLETT_MUTE);
+	}
+	shm->mst_gain = shm_val (m, scarlett_master (m), SCARLETT_DB);
+	shm->mst_mute = shm_val (m, scarlett_master (m), SCARLETT_MUTE);
+	for (unsigned int i = 0; i < shm->num_hiz; ++i) {
+		hiz[i] = shm_val (m, scarlett_hiz (m, i), SCARLETT_ENUM);
+	}
+	for (unsigned int i = 0; i < shm->num_pad; ++i) {
+		pad[i] = shm_val (m, scarlett_pad (m, i), SCARLETT_ENUM);
+	}
+	++shm->serial;
+
+	__sync_synchronize ();
+	++shm->seq;
+	pthread_mutex_unlock (&m->lock);
+}
+
+ScarlettShm* scarlett_shm_create (ScarlettMixer* m, const char* name)
+{
+	Device const* d = m->device;
+
+	/* the arrays are sized by the device */
+	ScarlettShm hdr;
+	memset (&hdr, 0, sizeof (ScarlettShm));
+	hdr.smi     = d->smi;
+	hdr.smo     = d->smo;
+	hdr.sin     = d->sin;
+	hdr.sout    = d->sout;
+	hdr.smst    = d->smst;
+	hdr.num_hiz = d->num_hiz;
+	hdr.num_pad = d->num_pad;
+	const size_t size = scarlett_shm_size (&hdr);
+
+	int fd = shm_open (name, O_CREAT | O_RDWR, 0644);
+	if (fd < 0) {
+		fprintf (stderr, "Cannot create shared memory '%s': %s\n", name, strerror (errno));
+		return NULL;
+	}
+	if (ftruncate (fd, size)) {
+		fprintf (stderr, "Cannot resize shared memory '%s': %s\n", name, strerror (errno));
+		close (fd);
+		shm_unlink (name);
+		return NULL;
+	}
+	ScarlettShm* shm = (ScarlettShm*)mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close (fd);
+	if (shm == MAP_FAILED) {
+		fprintf (stderr, "Cannot map shared memory '%s': %s\n", name, strerror (errno));
+		shm_unlink (name);
+		return NULL;
+	}
+
+	/* readers check the magic first, it is set once the header and
+	 * the first snapshot are complete */
+	memset (shm, 0, size);
+	__sync_synchronize ();
+	memcpy (shm, &hdr, sizeof (ScarlettShm));
+	shm->version = SCARLETT_SHM_VERSION;
+	shm->size    = size;
+	shm->pid     = getpid ();
+	strncpy (shm->device, d->name, sizeof (shm->device) - 1);
+	scarlett_shm_publish (m, shm);
+	__sync_synchronize ();
+	memcpy (shm->magic, SCARLETT_SHM_MAGIC, 8);
+	return shm;
+}
+
+void scarlett_shm_destroy (ScarlettShm* shm, const char* name)
+{
+	/* invalidate for readers that keep the mapping */
+	memset (shm->magic, 0, 8);
+	munmap (shm, shm->size);
+	shm_unlink (name);
+}
@@ -0,0 +1,165 @@
+/* scarlett mixer - device access library
+ *
+ * Copyright 2015-2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifndef SCARLETT_CORE_H
+#define SCARLETT_CORE_H
+
+/* Mixer controls of the supported devices: detection, mapping of
+ * matrix, selectors, gains and switches to control indices, and access
+ * to their values. Used by scarlett-mixer and linkable as
+ * libscarlettmixer, without any GUI dependencies.
+ *
+ * Single control access (scarlett_ctrl_get() etc.) is not locked, the
+ * caller serializes. scarlett_read(), scarlett_write() and
+ * scarlett_changes() take ScarlettMixer::lock and may be called from
+ * any thread.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <alsa/asoundlib.h>
+
+#include "scarlett_device.h"
+#include "scarlett_shm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* value of a single control parameter */
+enum ScarlettValType {
+	SCARLETT_DB = 0, //< gain in 1/100 dB
+	SCARLETT_MUTE,   //< playback switch, 1: muted
+	SCARLETT_ENUM,   //< enum item
+	SCARLETT_TYPES
+};
+
+typedef struct {
+	uint16_t id;   //< index into ScarlettMixer::ctrl[]
+	uint8_t  type; //< ScarlettValType
+	int32_t  val;
+} ScarlettVal;
+
+typedef struct {
+	snd_mixer_elem_t* elem; //< NULL for the offline mixer
+	char* name;
+	bool  changed; //< value changed, set by ALSA element callback
+
+	/* offline mixer, see scarlett_open_offline() */
+	uint8_t caps;              //< 1 << ScarlettValType
+	int     n_items;           //< enum items
+	int32_t val[SCARLETT_TYPES];
+} ScarlettCtrl;
+
+/* scarlett_open() options */
+#define SCARLETT_PROBE  (1<<0) //< print all controls
+#define SCARLETT_DETECT (1<<1) //< use the mapping from control names, if complete
+
+/* fields are read-only for users of the library */
+typedef struct {
+	Device*       device;
+	Device        dev;      //< autodetected description, see scarlett_open()
+	unsigned int* mtx_idx;  //< [smi * smo] matrix gain control index
+	unsigned int* msel_idx; //< [smi] matrix input selector control index
+	unsigned int* src_idx;  //< [sin] capture selector control index
+	char*         card;
+	ScarlettCtrl* ctrl;
+	unsigned int  ctrl_cnt;
+	snd_mixer_t*  mixer;    //< NULL for the offline mixer
+
+	pthread_mutex_t lock;   //< batched access
+} ScarlettMixer;
+
+/* 0: quiet, 1: report mapping, 2: dump device descriptions */
+extern int scarlett_verbose;
+
+/* open/close, the struct is to be zero-initialized */
+int   scarlett_open (ScarlettMixer* m, const char* card, int opts);
+int   scarlett_open_offline (ScarlettMixer* m, Device* d);
+void  scarlett_close (ScarlettMixer* m);
+
+/* point controls to a new mixer handle after the device re-appeared,
+ * it must present the same controls */
+int   scarlett_reopen (ScarlettMixer* m, const char* card);
+
+/* first card named `name` (any supported device if NULL), `hint` is
+ * tried first. Returns a string to free() or NULL */
+char* scarlett_find_card (const char* name, const char* hint);
+
+/* supported devices, NULL if out of range */
+Device* scarlett_device (unsigned int n);
+
+void  scarlett_dump_device (Device const* d);
+
+/* control mapping, NULL if out of range */
+ScarlettCtrl* scarlett_matrix_gain (ScarlettMixer* m, unsigned int c, unsigned int r);
+ScarlettCtrl* scarlett_matrix_input (ScarlettMixer* m, unsigned int r);
+ScarlettCtrl* scarlett_capture_source (ScarlettMixer* m, unsigned int r);
+ScarlettCtrl* scarlett_output_gain (ScarlettMixer* m, unsigned int c);
+ScarlettCtrl* scarlett_output_source (ScarlettMixer* m, unsigned int c);
+ScarlettCtrl* scarlett_hiz (ScarlettMixer* m, unsigned int c);
+ScarlettCtrl* scarlett_pad (ScarlettMixer* m, unsigned int c);
+ScarlettCtrl* scarlett_master (ScarlettMixer* m);
+
+/* single control access */
+void  scarlett_set_mute (ScarlettCtrl* c, bool muted);
+bool  scarlett_get_mute (ScarlettCtrl* c);
+float scarlett_get_dB (ScarlettCtrl* c);
+void  scarlett_set_cdB (ScarlettCtrl* c, long val);
+void  scarlett_set_dB (ScarlettCtrl* c, float dB);
+float scarlett_get_dB_range (ScarlettCtrl* c, bool maximum);
+void  scarlett_set_enum (ScarlettCtrl* c, int v);
+int   scarlett_get_enum (ScarlettCtrl* c);
+int   scarlett_get_enum_items (ScarlettCtrl* c);
+int   scarlett_get_enum_item_name (ScarlettCtrl* c, int item, size_t len, char* name);
+
+unsigned int scarlett_ctrl_id (ScarlettMixer* m, ScarlettCtrl* c);
+int32_t      scarlett_ctrl_get (ScarlettMixer* m, unsigned int id, int type);
+void         scarlett_ctrl_set (ScarlettMixer* m, unsigned int id, int type, int32_t val);
+bool         scarlett_ctrl_has (ScarlettMixer* m, unsigned int id, int type);
+
+/* batched access, locked. Read fills in v[].val, write only sends
+ * values that differ. Return the number of values written (read: n),
+ * -1 if any id or type is invalid (nothing is accessed then) */
+int scarlett_read (ScarlettMixer* m, ScarlettVal* v, unsigned int n);
+int scarlett_write (ScarlettMixer* m, ScarlettVal const* v, unsigned int n);
+
+/* handle pending ALSA events and report the current value of
+ * controls that changed since the last call, up to n. All types of a
+ * control are reported together, controls that do not fit are kept
+ * for the next call (n >= SCARLETT_TYPES always makes progress).
+ * Returns the number of values, -1 if the device is gone */
+int scarlett_changes (ScarlettMixer* m, ScarlettVal* v, unsigned int n);
+
+/* publish the state in the POSIX shared memory object `name`, see
+ * scarlett_shm.h. Returns NULL on error */
+ScarlettShm* scarlett_shm_create (ScarlettMixer* m, const char* name);
+
+/* update the published state, locked */
+void scarlett_shm_publish (ScarlettMixer* m, ScarlettShm* shm);
+
+/* invalidate, unmap and remove the object */
+void scarlett_shm_destroy (ScarlettShm* shm, const char* name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,234 @@
+/* scarlett mixer - headless state publisher
+ *
+ * Copyright 2015-2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+
+#include "scarlett_core.h"
+
+#ifndef VERSION
+#define VERSION "0.0.0"
+#endif
+
+#define RETRY_MS 1000 //< reconnect interval
+#define N_VAL    64   //< values per scarlett_changes() call
+
+static int verbose = 0;
+
+static volatile sig_atomic_t quit = 0;
+
+static void sig_quit (int sig)
+{
+	quit = 1;
+}
+
+/* *****************************************************************************
+ * Main loop
+ *
+ * Blocks in poll() on the mixer descriptors and publishes once per
+ * batch of ALSA events. When the device disappears, it is looked up
+ * by name every RETRY_MS and the controls are re-attached.
+ */
+
+static bool reconnect (ScarlettMixer* m)
+{
+	/* the card may have a different index after it re-appeared */
+	char* card = scarlett_find_card (m->device->name, m->card);
+	if (!card) {
+		return false;
+	}
+	const bool ok = scarlett_reopen (m, card) == 0;
+	if (ok) {
+		fprintf (stderr, "Reconnected to %s\n", card);
+	}
+	free (card);
+	return ok;
+}
+
+static int run (ScarlettMixer* m, ScarlettShm* shm)
+{
+	struct pollfd* pfd = NULL;
+	int  n_pfd = 0;
+	bool lost  = false;
+
+	while (!quit) {
+		if (lost) {
+			if (reconnect (m)) {
+				lost = false;
+				scarlett_shm_publish (m, shm);
+			} else {
+				poll (NULL, 0, RETRY_MS);
+			}
+			continue;
+		}
+
+		int n = snd_mixer_poll_descriptors_count (m->mixer);
+		if (n != n_pfd) {
+			free (pfd);
+			n_pfd = n;
+			pfd = (struct pollfd*)calloc (n, sizeof (struct pollfd));
+		}
+		if (snd_mixer_poll_descriptors (m->mixer, pfd, n) < 0) {
+			break;
+		}
+		if (poll (pfd, n, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			fprintf (stderr, "Poll error\n");
+			break;
+		}
+
+		ScarlettVal v[N_VAL];
+		bool changed = false;
+		int  rv;
+		while ((rv = scarlett_changes (m, v, N_VAL)) > 0) {
+			changed = true;
+		}
+		if (rv < 0) {
+			fprintf (stderr, "Lost connection to %s, waiting for it to re-appear\n", m->card);
+			lost = true;
+			continue;
+		}
+		if (changed) {
+			scarlett_shm_publish (m, shm);
+			if (verbose > 1) {
+				printf ("Published state #%" PRIu64 "\n", shm->serial);
+			}
+		}
+	}
+	free (pfd);
+	return quit ? 0 : -1;
+}
+
+/* *****************************************************************************
+ * options + help
+ */
+
+static struct option const long_options[] =
+{
+	{"help", no_argument, 0, 'h'},
+	{"version", no_argument, 0, 'V'},
+	{"verbose", no_argument, 0, 'v'},
+	{NULL, 0, NULL, 0}
+};
+
+static void usage (int status) {
+	printf ("scarlett-mixerd - Mixer State Publisher for Focusrite Scarlett USB Devices.\n\n\
+Publishes the mixer state of a Scarlett device in a POSIX shared memory\n\
+object, so that other programs can read it without opening the mixer.\n\
+\n\
+Supported devices:\n\
+");
+
+	Device* d;
+	for (unsigned i = 0; (d = scarlett_device (i)); i++) {
+		printf ("* %s\n", d->name);
+	}
+
+	printf ("Usage: scarlett-mixerd [ OPTIONS ] <name> [ DEVICE ]\n\n");
+	printf ("Options:\n\
+  -h, --help                 display this help and exit\n\
+  -V, --version              print version information and exit\n\
+  -v, --verbose              print information, twice: every update\n\
+\n\n\
+The layout of the shared memory is described in src/scarlett_shm.h,\n\
+the object is removed on SIGINT and SIGTERM. Unless given, the first\n\
+supported device is used. scarlett-mixer --daemon offers the same with\n\
+state file, journal, preset and cue handling.\n\
+\n\
+Example:\n\
+scarlett-mixerd /scarlett-mixer hw:1\n\
+\n");
+	printf ("Report bugs to <https://github.com/x42/scarlett-mixer/issues>\n");
+	exit (status);
+}
+
+int main (int argc, char** argv)
+{
+	int c;
+
+	while ((c = getopt_long (argc, argv,
+			   "h"  /* help */
+			   "V"  /* version */
+			   "v", /* verbose */
+			   long_options, (int *) 0)) != EOF) {
+		switch (c) {
+			case 'h':
+				usage (0);
+			case 'V':
+				printf ("scarlett-mixerd version %s\n\n", VERSION);
+				printf ("Copyright (C) GPL 2019 Robin Gareus <robin@gareus.org>\n");
+				exit (0);
+			case 'v':
+				++verbose;
+				break;
+			default:
+				usage (EXIT_FAILURE);
+		}
+	}
+
+	if (argc != optind + 1 && argc != optind + 2) {
+		usage (EXIT_FAILURE);
+	}
+
+	const char* name = argv[optind];
+	scarlett_verbose = verbose;
+	char* card = argc > optind + 1 ? strdup (argv[optind + 1]) : scarlett_find_card (NULL, NULL);
+	if (!card) {
+		fprintf (stderr, "No supported device found\n");
+		return 1;
+	}
+
+	ScarlettMixer m;
+	memset (&m, 0, sizeof (ScarlettMixer));
+	if (scarlett_open (&m, card, SCARLETT_DETECT)) {
+		free (card);
+		return 1;
+	}
+	free (card);
+
+	ScarlettShm* shm = scarlett_shm_create (&m, name);
+	if (!shm) {
+		scarlett_close (&m);
+		return 1;
+	}
+
+	signal (SIGINT, sig_quit);
+	signal (SIGTERM, sig_quit);
+
+	if (verbose) {
+		printf ("Publishing state of %s (%s) in '%s'\n", m.device->name, m.card, name);
+	}
+
+	int rv = run (&m, shm) ? 1 : 0;
+
+	scarlett_shm_destroy (shm, name);
+	scarlett_close (&m);
+	return rv;
+}
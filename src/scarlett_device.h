@@ -0,0 +1,52 @@
+/* scarlett mixer - device description type
+ *
+ * Copyright 2015-2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifndef SCARLETT_DEVICE_TYPE_H
+#define SCARLETT_DEVICE_TYPE_H
+
+/* Control indices are given either as offset and stride, or, for
+ * devices where the kernel-driver does not lay them out regularly,
+ * as per-device index tables. Tables are sized by the counts below,
+ * a NULL table means offset/stride is used.
+ */
+
+typedef struct {
+	char        name[64];
+	unsigned    smi;  //< mixer matrix inputs
+	unsigned    smo;  //< mixer matrix outputs
+	unsigned    sin;  //< inputs (capture select)
+	unsigned    sout; //< outputs assigns
+	unsigned    smst; //< main outputs (stereo gain controls w/mute =?= sout / 2)
+	unsigned    num_hiz;
+	unsigned    num_pad;
+	unsigned    matrix_mix_offset;
+	unsigned    matrix_mix_stride;
+	unsigned    matrix_in_offset;
+	unsigned    matrix_in_stride;
+	unsigned    input_offset;
+	int*        out_gain_map;           //< [smst]
+	char        (*out_gain_labels)[16]; //< [smst]
+	int*        out_bus_map;            //< [sout]
+	int*        hiz_map;                //< [num_hiz]
+	int*        pad_map;                //< [num_pad]
+	int*        matrix_mix_map;         //< [smi * smo], optional
+	int*        matrix_in_map;          //< [smi], optional
+	int*        input_map;              //< [sin], optional
+} Device;
+
+#endif
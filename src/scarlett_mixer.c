@@ -24,11 +24,33 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <strings.h>
+#include <ctype.h>
 #include <assert.h>
 #include <errno.h>
 #include <getopt.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <alsa/asoundlib.h>
 
+#ifdef WITH_HOTKEY
+#include <X11/Xlib.h>
+#endif
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 #define RTK_URI "http://gareus.org/oss/scarlettmixer#"
 #define RTK_GUI "ui"
 
@@ -36,109 +58,369 @@
 #define GD_CX 20.5
 #define GD_CY 15.5
 
-/* device specifics, see also
- * https://git.kernel.org/pub/scm/linux/kernel/git/torvalds/linux.git/tree/sound/usb/mixer_scarlett.c#n635
- */
+#define OUT_COLS 5 //< max stereo pairs per row in the output section
+
+#include "scarlett_core.h"
+#include "scarlett_shm.h"
+
+/* GUI names of the library types, see scarlett_core.h */
+typedef ScarlettCtrl Mctrl;
+typedef ScarlettVal  CtrlVal;
+
+enum CtrlValType {
+	CV_DB    = SCARLETT_DB,
+	CV_MUTE  = SCARLETT_MUTE,
+	CV_ENUM  = SCARLETT_ENUM,
+	CV_TYPES = SCARLETT_TYPES
+};
+
+#define WQ_SIZE 512
 
-#define MAX_GAINS   10
-#define MAX_BUSSES  20
-#define MAX_HIZS    2
-#define MAX_PADS    4
+/* link groups */
+enum GangKind {
+	GANG_MIX = 0, //< matrix mix-busses (columns)
+	GANG_IN,      //< matrix inputs (rows)
+	GANG_OUT,     //< output gains
+};
 
 typedef struct {
-	char        name[64];
-	unsigned    smi;  //< mixer matrix inputs
-	unsigned    smo;  //< mixer matrix outputs
-	unsigned    sin;  //< inputs (capture select)
-	unsigned    sout; //< outputs assigns
-	unsigned    smst; //< main outputs (stereo gain controls w/mute =?= sout / 2)
-	unsigned    num_hiz;
-	unsigned    num_pad;
-	unsigned    matrix_mix_offset;
-	unsigned    matrix_mix_stride;
-	unsigned    matrix_in_offset;
-	unsigned    matrix_in_stride;
-	unsigned    input_offset;
-	int         out_gain_map[MAX_GAINS];
-	char        out_gain_labels[MAX_GAINS][16];
-	int         out_bus_map[MAX_BUSSES];
-	int         hiz_map[MAX_HIZS];
-	int         pad_map[MAX_PADS];
-} Device;
-
-static Device devices[] = {
-	{
-		.name = "Scarlett 18i6 USB",
-		.smi = 18, .smo = 6,
-		.sin = 18, .sout = 6,
-		.smst = 3,
-		.num_hiz = 2,
-		.num_pad = 0,
-		.matrix_mix_offset = 33, .matrix_mix_stride = 7,
-		.matrix_in_offset = 32, .matrix_in_stride = 7,
-		.input_offset = 14,
-		.out_gain_map = { 1 /* Monitor */, 4 /* Headphone */, 7 /* SPDIF */, -1, -1 , -1, -1, -1, -1, -1 }, // PBS
-		.out_gain_labels = { "Monitor", "Headphone", "SPDIF", "", "", "", "", "", "", "" },
-		.out_bus_map = { 2, 3, 5, 6, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 }, // Source, ENUM
-		.hiz_map = { 12, 13 },
-		.pad_map = { -1, -1, -1, -1 },
-	},
-	{
-		.name = "Scarlett 18i8 USB",
-		.smi = 18, .smo = 8,
-		.sin = 18, .sout = 8,
-		.smst = 4,
-		.num_hiz = 2,
-		.num_pad = 4,
-		.matrix_mix_offset = 40, .matrix_mix_stride = 9, // < Matrix 01 Mix A
-		.matrix_in_offset = 39, .matrix_in_stride = 9,   // Matrix 01 Input, ENUM
-		.input_offset = 21,   // < Input Source 01, ENUM
-		.out_gain_map = { 1 /* Monitor */, 4 /* Headphone 1 */, 7 /* Headphone 2 */, 10 /* SPDIF */, -1, -1 , -1, -1, -1, -1 },
-		.out_gain_labels = { "Monitor", "Headphone 1", "Headphone 2", "SPDIF", "", "", "", "", "", "" },
-		.out_bus_map = { 2, 3, 5, 6, 8, 9, 11, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
-		.hiz_map = { 15, 17 }, // < Input 1 Impedance, ENUM,  Input 2 Impedance, ENUM
-		.pad_map = { 16, 18, 19, 20 },
-	},
-	{
-		.name = "Scarlett 6i6 USB",
-		.smi = 6, .smo = 6,
-		.sin = 6, .sout = 6,
-		.smst = 3,
-		.num_hiz = 2,
-		.num_pad = 4, // XXX does the device have pad? bug in kernel-driver?
-		.matrix_mix_offset = 26, .matrix_mix_stride = 9, // XXX stride should be 7, bug in kernel-driver ?!
-		.matrix_in_offset = 25, .matrix_in_stride = 9,   // XXX stride should be 7, bug in kernel-driver ?!
-		.out_gain_map = { 1 /* Monitor */, 4 /* Headphone */, 7 /* SPDIF */, -1, -1, -1 , -1, -1, -1, -1 },
-		.out_gain_labels = { "Monitor", "Headphone", "SPDIF", "", "", "", "", "", "", "" },
-		.out_bus_map = { 2, 3, 5, 6, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
-		.input_offset = 18,
-		.hiz_map = { 12, 14 },
-		.pad_map = { 13, 15, 16, 17 },
-	},
-	{
-		.name = "Scarlett 18i20 USB",
-		.smi = 18, .smo = 8,
-		.sin = 18, .sout = 20,
-		.smst = 10,
-		.num_hiz = 0,
-		.num_pad = 0,
-		.matrix_mix_offset = 50, .matrix_mix_stride = 9,
-		.matrix_in_offset = 49, .matrix_in_stride = 9,
-		.input_offset = 31,
-		.out_gain_map = { 1, 7, 10, 13, 16, 19, 22, 25, 28, 2  },
-		.out_gain_labels = { "Monitor", "Line 3/4", "Line 5/6", "Line 7/8", "Line 9/10" , "SPDIF", "ADAT 1/2", "ADAT 3/4", "ADAT 5/6", "ADAT 7/8" },
-		.out_bus_map = { 5, 6, 8, 9, 11, 12, 14, 15, 17, 18, 20, 21, 23, 24, 26, 27, 29, 30, 3, 4 },
-		.hiz_map = { -1, -1 },
-		.pad_map = { -1, -1, -1, -1 },
-	},
+	uint8_t  kind;     //< GangKind
+	bool     relative; //< keep offsets between members
+	uint64_t members;  //< bitmask
+} Gang;
+
+#define MAX_GANGS 16
+
+/* bulk matrix operations */
+enum MtxOpType {
+	MTX_CLEAR = 0, //< all crosspoints off
+	MTX_IDENTITY,  //< input n to mix n, 0dB
+	MTX_COPY,      //< copy mix a to mix b
+	MTX_TRIM,      //< trim mix a by dB
+	MTX_SWAP,      //< swap matrix inputs (rows) a and b
+};
+
+typedef struct {
+	int   op; //< MtxOpType
+	int   a;
+	int   b;
+	float dB;
+} MtxOp;
+
+#define MAX_MTX_OPS 16
+
+/* solo / cue */
+enum SoloKind {
+	SOLO_ROW = 0, //< matrix input on the cue mix-busses
+	SOLO_BUS,     //< mix-bus on the cue output
+};
+
+typedef struct {
+	uint8_t      kind;  //< SoloKind
+	unsigned int n;     //< matrix input or mix-bus
+	CtrlVal*     saved; //< values to restore
+	unsigned int n_saved;
+} SoloState;
+
+#define SOLO_DEPTH 8
+
+/* cue list */
+enum CueTrigger {
+	CUE_MANUAL = 0, //< 'Go'
+	CUE_AT,         //< time of day
+	CUE_FOLLOW,     //< delay after the previous cue completed
 };
 
-#define NUM_DEVICES     (sizeof (devices) / sizeof (devices[0]))
+typedef struct {
+	unsigned int slot;    //< preset bank slot
+	uint8_t      trigger; //< CueTrigger
+	uint32_t     fade;    //< msec
+	uint32_t     when;    //< CUE_AT: sec since midnight, CUE_FOLLOW: msec
+} Cue;
+
+#define CUE_MAX      256
+#define CUE_FADE_HZ  50 //< crossfade steps per second
+#define CUE_LATE_MAX 60 //< sec, a later time of day waits for the next day
+#define CUE_RT_PRIO  4
+
+typedef struct {
+	Cue                   cue[CUE_MAX];
+	unsigned int          n_cues;
+	volatile unsigned int pos;     //< next cue
+	volatile bool         changed; //< pos changed, for the GUI
+	volatile bool         run;
+	bool                  abort;   //< panic, stop the current fade (ui->lock)
+	pthread_t             thread;
+	int                   tfd;     //< CLOCK_MONOTONIC timerfd
+	int                   tfd_rt;  //< CLOCK_REALTIME timerfd
+	int                   efd;     //< eventfd, 'Go'
+	CtrlVal*              from;    //< [n_val] values before the fade
+	CtrlVal*              to;      //< [n_val] preset values
+	unsigned int          n_val;
+} CueList;
+
+/* undo history */
+typedef struct {
+	uint16_t id;    //< index into ui->sm.ctrl[]
+	uint8_t  type;  //< CtrlValType
+	uint8_t  flags; //< HIST_START: first record of a gesture
+	int32_t  old_val;
+	int32_t  new_val;
+} HistRec;
+
+#define HIST_SIZE     4096
+#define HIST_START    1
+#define HIST_MERGE_MS 750
+
+/* automation journal */
+struct _JournalHdr;
+struct _JournalRec;
+
+typedef struct {
+	int                 fd;
+	size_t              len;
+	uint64_t            n_alloc;
+	uint64_t            t0;
+	struct _JournalHdr* hdr;
+	struct _JournalRec* rec;
+	int32_t*            shadow; //< [ctrl_cnt * CV_TYPES] last recorded value
+	uint64_t            n_dropped; //< records lost, the file could not grow
+	bool                grow_err;
+} Journal;
+
+/* preset bank */
+struct _BankHdr;
+
+typedef struct {
+	int              fd;
+	size_t           len;
+	struct _BankHdr* hdr;
+	CtrlVal*         tgt;   //< controls covered by a preset
+	unsigned int     n_tgt;
+	snd_seq_t*       seq;   //< program change input, or NULL
+} Bank;
+
+/* persisted state, see persist_open () */
+typedef struct {
+	char*        path;   //< NULL: disabled
+	CtrlVal*     val;    //< saved state
+	unsigned int n_val;
+	uint64_t     first;  //< monotonic_ms () of the first unsaved change, 0: none
+	uint64_t     last;   //< monotonic_ms () of the last change
+	bool         failed; //< last write failed, error was reported
+	bool         lost;   //< device disconnected
+	uint64_t     retry;  //< monotonic_ms () of the next reconnect attempt
+} Persist;
+
+/* read-back verification */
+typedef struct {
+	snd_hctl_elem_t*    helem;
+	unsigned int        id;      //< index into ui->sm.ctrl[]
+	snd_ctl_elem_type_t type;
+	bool                capture;
+	unsigned int        count;   //< number of channels
+} VerifyElem;
+
+typedef struct {
+	VerifyElem*           elem;
+	unsigned int          n_elem;
+	unsigned int          pos;      //< next element to verify
+	unsigned int          batch;    //< elements per run
+	uint64_t              interval; //< msec
+	uint64_t              next;
+	unsigned int          drift;    //< number of drifted controls
+	int                   recheck;  //< element with a mismatch, or -1
+	snd_ctl_elem_value_t* value;
+} Verify;
+
+/* capture meters */
+#define METER_MAX      32  //< max metered channels
+#define METER_BUS      8   //< max mix-bus estimates
+#define METER_CH       (METER_MAX + METER_BUS)
+#define METER_PERIOD   256 //< capture period, frames
+#define METER_WIN_RATE 50  //< integration windows per second
+#define METER_RT_PRIO  5
+#define METER_WAIT_MS  100 //< max. capture wait, see meter_stop ()
+#define METER_FPS      25
+#define METER_FLOOR    -60.f
+#define METER_FALLOFF  20.f //< dB/sec
+#define METER_HOLD_MS  2000
+#define METER_W        36
+#define METER_H        8
+
+typedef struct {
+	volatile uint32_t seq; //< odd while the writer is updating
+	volatile uint32_t gen; //< incremented with every update
+	volatile uint32_t ack; //< last gen seen by the GUI
+	float peak[METER_CH];  //< squared, max since last ack
+	float rms[METER_CH];   //< squared, mean of last window
+} MeterShared;
+
+/* mix-bus estimate, gain[i * bstride + bus] for capture channel in[i] */
+typedef struct {
+	unsigned int n_in;
+	unsigned int in[METER_MAX];
+	float        gain[METER_MAX * METER_BUS];
+} MeterMix;
+
+/* spectrum analyzer */
+#define SPEC_N       4096  //< FFT size
+#define SPEC_HOP     (SPEC_N / 2)
+#define SPEC_RING    16384 //< capture ring-buffer, power of two
+#define SPEC_BANDS   192
+#define SPEC_FMIN    20.f
+#define SPEC_FLOOR   -100.f
+#define SPEC_FALLOFF 40.f  //< dB/sec
+#define SPEC_H       120
+
+typedef struct {
+	volatile uint32_t seq; //< odd while the writer is updating
+	volatile uint32_t gen; //< incremented with every update
+	float band[SPEC_BANDS]; //< dBFS, max of the band's bins
+	float peak_hz;          //< strongest bin, interpolated
+	float peak_db;
+} SpecShared;
+
+typedef struct {
+	/* capture thread */
+	volatile int      chn;  //< analyzed capture channel, -1: off
+	volatile uint32_t wr;
+	float             ring[SPEC_RING];
+
+	/* analysis thread */
+	pthread_t         thread;
+	volatile bool     run;
+	unsigned int      rate;
+	float*            win;   //< [SPEC_N] Hann window
+	float             norm;
+	float*            re;    //< [SPEC_N / 2]
+	float*            im;
+	float*            tw_re; //< [SPEC_N / 2 - 1] FFT twiddles, per stage
+	float*            tw_im;
+	uint32_t*         rev;   //< [SPEC_N / 2] bit reversal
+	float*            pc;    //< [SPEC_N / 2 + 1] real split twiddles
+	float*            ps;
+	float*            pwr;   //< [SPEC_N / 2 + 1] power per bin
+	uint16_t          lo[SPEC_BANDS]; //< bins of each band
+	uint16_t          hi[SPEC_BANDS];
+
+	SpecShared        sh;
+
+	/* GUI */
+	uint32_t          gen;
+	float             disp[SPEC_BANDS];
+	float             peak_hz;
+	float             peak_db;
+	cairo_surface_t*  grid;
+	int               w;
+	int               h;
+} Spectrum;
+
+typedef struct {
+	snd_pcm_t*        pcm;
+	pthread_t         thread;
+	volatile bool     run;
+	snd_pcm_format_t  format;
+	unsigned int      n_chn;   //< PCM channels
+	unsigned int      n_met;   //< metered channels
+	unsigned int      stride;  //< n_met, padded to a multiple of 4
+	unsigned int      n_bus;   //< estimated mix-busses, at [stride ..]
+	unsigned int      bstride; //< n_bus, padded to a multiple of 4
+	unsigned int      rate;
+	snd_pcm_uframes_t period;
+	void*             raw;     //< PCM data
+	float*            buf;     //< [period * stride]
+	float*            mixbuf;  //< [period * bstride]
+	volatile uint32_t xruns;   //< capture overruns, shown in the HUD
+	bool              reopen;  //< the device re-appeared, see meter_reconnect ()
+	unsigned int      n_reopen;
+	uint64_t          retry;
+
+	/* written by the GUI, double-buffered */
+	MeterMix          mix[2];
+	volatile uint32_t mix_cur; //< used by the capture thread
+	volatile uint32_t mix_ack; //< last mix_cur seen by the capture thread
+	bool              mix_dirty;
+
+	/* capture thread */
+	float             win_peak[METER_CH];
+	float             win_sum[METER_CH];
+	unsigned int      win_n;
+	unsigned int      win_len;
+	float             pend_peak[METER_CH];
+	uint32_t          gen;
+
+	MeterShared       sh;
+	Spectrum*         spec; //< optional analyzer
+
+	/* GUI, in dBFS */
+	float             peak[METER_CH];
+	float             rms[METER_CH];
+	float             hold[METER_CH];
+	uint64_t          hold_time[METER_CH];
+	uint64_t          last_draw;
+} Meter;
+
+/* performance counters, see hud_tick () */
+#define HUD_LAT_BINS 48 //< write latency histogram, bin b < 2^(b/2) usec
+#define HUD_W        220
+#define HUD_H        98
+
+typedef struct {
+	bool     on;
+	uint64_t t0;
+
+	/* current one second window */
+	uint32_t frames;
+	uint64_t render_ns;
+	uint64_t render_max;
+	uint32_t widgets;
+	uint32_t events;  //< changed controls reported by ALSA
+	uint32_t wakeups; //< port_event () calls without any work
+	uint32_t wq_max;
+	uint32_t lat[HUD_LAT_BINS];
+	uint32_t n_lat;
+
+	uint64_t writes;  //< total control writes, not reset
+	uint64_t t_write; //< monotonic_ns () of the last write
+
+	/* at the previous port_event () call, see hud_tick () */
+	uint32_t prev_frames;
+	uint32_t prev_events;
+	uint64_t prev_writes;
+
+	/* previous window, displayed */
+	float        fps;
+	float        render_avg; //< msec
+	float        render_max_ms;
+	float        widgets_avg;
+	float        events_s;
+	float        wakeups_s;
+	unsigned int wq_depth;
+	float        lat_p50;    //< msec, queued to written
+	float        lat_p99;
+	unsigned int xruns;      //< meter capture, total
+} Perf;
+
+/* see hotkey_start () */
+typedef struct {
+	void*         dpy; //< X11 Display
+	pthread_t     thread;
+	volatile bool run;
+} Hotkey;
 
+/* see rec_open () */
 typedef struct {
-	snd_mixer_elem_t* elem;
-	char* name;
-} Mctrl;
+	FILE*      f;
+	uint64_t   t0;
+	int        w, h;  //< last recorded size
+	float      scale;
+	RobWidget* (*tl_down) (RobWidget*, RobTkBtnEvent*);
+	RobWidget* (*tl_scroll) (RobWidget*, RobTkBtnEvent*);
+	RobWidget* focus; //< widget that accepted the press
+	RobWidget* (*focus_move) (RobWidget*, RobTkBtnEvent*);
+	RobWidget* (*focus_up) (RobWidget*, RobTkBtnEvent*);
+} Recorder;
 
 typedef struct {
 	RobWidget*      rw;
@@ -164,129 +446,169 @@ typedef struct {
 	RobTkCBtn**     btn_hiz;
 	RobTkCBtn**     btn_pad;
 	RobTkPBtn*      btn_reset;
+	RobTkPBtn*      btn_undo;
+	RobTkPBtn*      btn_redo;
+	RobTkPBtn*      btn_panic;
+	RobTkCBtn*      btn_dim;
+	RobTkSelect*    preset_sel;
+	RobTkPBtn*      btn_recall;
+	RobTkPBtn*      btn_store;
+	RobTkSelect*    cue_sel;
+	RobTkPBtn*      btn_unsolo;
+	RobTkPBtn*      btn_go;
+	RobTkLbl*       go_lbl;
+	RobTkCBtn*      btn_hud;
+	RobTkSelect*    mtx_op_sel;
+	RobTkSelect*    mtx_a_sel;
+	RobTkSelect*    mtx_b_sel;
+	RobTkPBtn*      btn_mtx_op;
+	RobWidget*      tools;
 
 	RobTkLbl*       heading[3];
 
 	PangoFontDescription* font;
 	cairo_surface_t*      mtx_sf[6];
 
-	Device*      device;
-	Mctrl*       ctrl;
-	unsigned int ctrl_cnt;
-	snd_mixer_t* mixer;
+	ScarlettMixer sm; //< device and its controls
 
 	int nfds;
 	struct pollfd* pollfds;
 	bool disable_signals;
+
+	pthread_mutex_t lock; //< device writes, taken by the cue list thread
+
+	unsigned int sync_pos; //< progressive initial read, next item
+	unsigned int sync_cnt; //< total number of items to read
+	bool         need_refresh;
+
+	CtrlVal      wq[WQ_SIZE]; //< pending writes
+	uint64_t     wq_time[WQ_SIZE]; //< monotonic_ns () when queued
+	unsigned int wq_len;
+	int*         wq_slot;     //< [ctrl_cnt * CV_TYPES] index into wq[] or -1
+
+	Gang         gang[MAX_GANGS];
+	unsigned int n_gangs;
+
+	MtxOp        mtx_ops[MAX_MTX_OPS]; //< commandline matrix operations
+	unsigned int n_mtx_ops;
+
+	SoloState    solo[SOLO_DEPTH];
+	unsigned int n_solo;
+	unsigned int cue_out; //< output pair used for solo
+
+	HistRec      hist[HIST_SIZE];
+	uint32_t     hist_start;   //< oldest record
+	uint32_t     hist_pos;     //< undo from here
+	uint32_t     hist_end;     //< redo up to here
+	uint32_t     hist_gesture; //< first record of the current gesture
+	int          hist_key;
+	bool         hist_new;
+	bool         hist_merge;
+	int          hist_suspend;
+	uint64_t     hist_time;
+
+	Journal      jrn;
+	Bank         bank;
+	Persist      persist;
+	CueList*     cues;
+
+	Verify       vfy;
+	uint64_t     last_write; //< monotonic_ms () of last GUI write
+
+	int32_t      dim_restore; //< master gain before dim
+	uint64_t     panic_usec;  //< execution time of last panic/dim
+	Hotkey*      hotkey;
+
+	Meter*       meter;
+	RobWidget**  meter_rw; //< [sin], NULL if not metered
+	RobWidget**  bus_rw;   //< [smo], NULL if not metered
+	RobWidget*   spec_rw;
+
+	Perf         perf;
+	Recorder     rec;
+	bool       (*rw_expose) (RobWidget*, cairo_t*, cairo_rectangle_t*);
 } RobTkApp;
 
 
 /* *****************************************************************************
- * Mapping for the 18i6 and 18i8
- *
- * NOTE: these are numerically hardcoded. see `amixer -D hw:2 control`
- * and #if'd "Print Controls" debug dump below
+ * Control mapping, see scarlett_core.c
  */
 
 /* mixer-matrix ; colums(src) x rows (dest) */
 static Mctrl* matrix_ctrl_cr (RobTkApp* ui, unsigned int c, unsigned int r)
 {
-	/* Matrix 01 Mix A
-	 *  ..
-	 * Matrix 18 Mix F
-	 */
-	if (r >= ui->device->smi || c >= ui->device->smo) {
-		return NULL;
-	}
-	unsigned int ctrl_id = ui->device->matrix_mix_offset + r * ui->device->matrix_mix_stride + c;
-	return &ui->ctrl[ctrl_id];
+	return scarlett_matrix_gain (&ui->sm, c, r);
 }
 
 /* wrapper to the above, linear lookup */
 static Mctrl* matrix_ctrl_n (RobTkApp* ui, unsigned int n)
 {
-	unsigned c = n % ui->device->smo;
-	unsigned r = n / ui->device->smo;
+	unsigned c = n % ui->sm.device->smo;
+	unsigned r = n / ui->sm.device->smo;
 	return matrix_ctrl_cr (ui, c, r);
 }
 
 /* matrix input selector (per row)*/
 static Mctrl* matrix_sel (RobTkApp* ui, unsigned int r)
 {
-	if (r >= ui->device->smi) {
-		return NULL;
-	}
-	/* Matrix 01 Input, ENUM
-	 *  ..
-	 * Matrix 18 Input, ENUM
-	 */
-	unsigned int ctrl_id = ui->device->matrix_in_offset + r * ui->device->matrix_in_stride;
-	return &ui->ctrl[ctrl_id];
+	return scarlett_matrix_input (&ui->sm, r);
 }
 
 /* Input/Capture selector */
 static Mctrl* src_sel (RobTkApp* ui, unsigned int r)
 {
-	if (r >= ui->device->sin) {
-		return NULL;
-	}
-	/* Input Source 01, ENUM
-	 *  ..
-	 * Input Source 18, ENUM
-	 */
-	unsigned int ctrl_id = ui->device->input_offset + r;
-	return &ui->ctrl[ctrl_id];
+	return scarlett_capture_source (&ui->sm, r);
 }
 
 static int src_sel_default (unsigned int r, int max_values)
 {
-	/* 0 <= r < ui->device->sin;  return 0 .. max_values - 1 */
+	/* 0 <= r < ui->sm.device->sin;  return 0 .. max_values - 1 */
 	return (r + 7) % max_values; // XXX hardcoded defaults. offset 7: "Analog 1"
 }
 
 /* Output Gains */
 static Mctrl* out_gain (RobTkApp* ui, unsigned int c)
 {
-	assert (c < MAX_GAINS);
-	return &ui->ctrl[ui->device->out_gain_map[c]];
+	assert (c < ui->sm.device->smst);
+	return scarlett_output_gain (&ui->sm, c);
 }
 
 static const char* out_gain_label (RobTkApp *ui, int n)
 {
-	return ui->device->out_gain_labels[n];
+	return ui->sm.device->out_gain_labels[n];
 }
 
 /* Output Bus assignment (matrix-out to master) */
 static Mctrl* out_sel (RobTkApp* ui, unsigned int c)
 {
-	assert (c < MAX_BUSSES);
-	return &ui->ctrl[ui->device->out_bus_map[c]];
+	assert (c < ui->sm.device->sout);
+	return scarlett_output_source (&ui->sm, c);
 }
 
 static int out_sel_default (unsigned int c)
 {
-	/* 0 <= c < ui->device->sout; */
+	/* 0 <= c < ui->sm.device->sout; */
 	return 25 + c; // XXX hardcoded defaults. offset 25: "Mix 1"
 }
 
 /* Hi-Z switches */
 static Mctrl* hiz (RobTkApp* ui, unsigned int c)
 {
-	assert (c < ui->device->num_hiz);
-	return &ui->ctrl[ui->device->hiz_map[c]];
+	assert (c < ui->sm.device->num_hiz);
+	return scarlett_hiz (&ui->sm, c);
 }
 
 /* Pad switches */
 static Mctrl* pad (RobTkApp *ui, unsigned c)
 {
-	assert (c < ui->device->num_pad);
-	return &ui->ctrl[ui->device->pad_map[c]];
+	assert (c < ui->sm.device->num_pad);
+	return scarlett_pad (&ui->sm, c);
 }
 
 /* master gain */
 static Mctrl* mst_gain (RobTkApp* ui)
 {
-	return &ui->ctrl[0]; /* Master, PBS */
+	return scarlett_master (&ui->sm);
 }
 
 
@@ -300,433 +622,4886 @@ static Mctrl* mst_gain (RobTkApp* ui)
 
 static int verbose = 0;
 
-#define OPT_PROBE (1<<0)
-#define OPT_DETECT (1<<1)
-
-static void dump_device_desc (Device const* const d)
-{
-	printf ("--- Device: %s\n", d->name);
-	printf ("Matrix: in=%d, out=%d, off=%d, stride=%d\n",
-			d->smi, d->smo, d->matrix_mix_offset, d->matrix_mix_stride);
-	printf ("Matrix: input-select=%d, select-stride=%d\n",
-			d->matrix_in_offset, d->matrix_in_stride);
-	printf ("Inputs: ins=%d select-offset=%d\n",
-			d->sin, d->input_offset);
-	printf ("Masters: n_mst=%d n_out-select=%d\n",
-			d->smst, d->sout);
-	printf ("Switches: n_pad=%d, n_hiz=%d\n",
-			d->num_pad, d->num_hiz);
-
-#define DUMP_ARRAY(name, len, fmt)  \
-  printf (#name " = {");            \
-  for (int i = 0; i < len; ++i) {   \
-    printf (fmt ", ", d->name[i]);  \
-  }                                 \
-  printf ("};\n");
-
-	DUMP_ARRAY (hiz_map, MAX_HIZS, "%d");
-	DUMP_ARRAY (pad_map, MAX_PADS, "%d");
-	DUMP_ARRAY (out_gain_map, MAX_GAINS, "%d");
-	DUMP_ARRAY (out_gain_labels, MAX_GAINS, "%s");
-	DUMP_ARRAY (out_bus_map, MAX_BUSSES, "%d");
-	printf ("---\n");
-}
-
 /* *****************************************************************************
- * Alsa Mixer Interface
+ * Tracing
+ *
+ * Begin/end spans are recorded into per-thread ring-buffers, and written
+ * as Chrome trace JSON (chrome://tracing, ui.perfetto.dev) at exit or on
+ * SIGUSR2. When disabled, a span costs a single branch.
  */
 
-static int open_mixer (RobTkApp* ui, const char* card, int opts)
-{
-	int rv = 0;
-	int err;
-	snd_mixer_selem_id_t *sid;
-	snd_mixer_elem_t *elem;
-	snd_mixer_selem_id_alloca (&sid);
-
-	snd_ctl_t *hctl;
-	snd_ctl_card_info_t *card_info;
-	snd_ctl_card_info_alloca (&card_info);
+#define TRACE_SIZE    65536 //< events per thread, power of two
+#define TRACE_GUARD   1024  //< skip oldest events, may be overwritten during dump
+#define TRACE_THREADS 8
 
-	if ((err = snd_ctl_open (&hctl, card, 0)) < 0) {
-		fprintf (stderr, "Control device %s open error: %s\n", card, snd_strerror (err));
-		return err;
-	}
-
-	if ((err = snd_ctl_card_info (hctl, card_info)) < 0) {
-		fprintf (stderr, "Control device %s hw info error: %s\n", card, snd_strerror (err));
-		return err;
-	}
+#define TRACE_BEGIN(NAME) do { if (trace_on) trace_event (NAME, 'B'); } while (0)
+#define TRACE_END(NAME)   do { if (trace_on) trace_event (NAME, 'E'); } while (0)
 
-	const char* card_name = snd_ctl_card_info_get_name (card_info);
-	snd_ctl_close (hctl);
-
-	if (!card_name) {
-		fprintf (stderr, "Device `%s' is unknown\n", card);
-		return -1;
-	}
+typedef struct {
+	uint64_t    time; //< monotonic_ns ()
+	const char* name; //< string literal
+	char        ph;   //< 'B' or 'E'
+} TraceEvent;
 
-	ui->device = NULL;
+typedef struct {
+	pid_t             tid;
+	volatile uint32_t pos; //< total number of events
+	TraceEvent        ev[TRACE_SIZE];
+} TraceBuf;
+
+static bool                  trace_on = false;
+static const char*           trace_path = NULL;
+static uint64_t              trace_t0;
+static TraceBuf*             trace_buf[TRACE_THREADS];
+static uint32_t              trace_n_buf = 0;
+static __thread TraceBuf*    trace_tls = NULL;
+static volatile sig_atomic_t trace_request = 0;
+
+static uint64_t monotonic_ns ()
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
 
-	for (unsigned i = 0; i < NUM_DEVICES; i++) {
-		if (!strcmp (card_name, devices[i].name))
-			ui->device = &devices[i];
-	}
+static uint64_t monotonic_ms ()
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
-	if (ui->device == NULL) {
-		fprintf (stderr, "Device `%s' is not supported\n", card);
-		rv = -1;
-		if ((opts & OPT_PROBE) == 0) {
-			return -1;
+static void trace_event (const char* name, char ph)
+{
+	TraceBuf* tb = trace_tls;
+	if (!tb) {
+		/* first event of this thread */
+		const uint32_t n = __sync_fetch_and_add (&trace_n_buf, 1);
+		if (n >= TRACE_THREADS) {
+			return;
 		}
+		tb = (TraceBuf*)calloc (1, sizeof (TraceBuf));
+		tb->tid = syscall (SYS_gettid);
+		trace_buf[n] = tb;
+		trace_tls = tb;
 	}
+	TraceEvent* e = &tb->ev[tb->pos & (TRACE_SIZE - 1)];
+	e->time = monotonic_ns ();
+	e->name = name;
+	e->ph   = ph;
+	__sync_synchronize ();
+	++tb->pos;
+}
 
-	if ((err = snd_mixer_open (&ui->mixer, 0)) < 0) {
-		fprintf (stderr, "Mixer %s open error: %s\n", card, snd_strerror (err));
-		return err;
-	}
-	if ((err = snd_mixer_attach (ui->mixer, card)) < 0) {
-		fprintf (stderr, "Mixer attach %s error: %s\n", card, snd_strerror (err));
-		snd_mixer_close (ui->mixer);
-		return err;
-	}
-	if ((err = snd_mixer_selem_register (ui->mixer, NULL, NULL)) < 0) {
-		fprintf (stderr, "Mixer register error: %s\n", snd_strerror (err));
-		snd_mixer_close (ui->mixer);
-		return err;
-	}
-	err = snd_mixer_load (ui->mixer);
-	if (err < 0) {
-		fprintf (stderr, "Mixer %s load error: %s\n", card, snd_strerror (err));
-		snd_mixer_close (ui->mixer);
-		return err;
+static void trace_dump (void)
+{
+	FILE* f = fopen (trace_path, "w");
+	if (!f) {
+		fprintf (stderr, "Cannot write trace '%s': %s\n", trace_path, strerror (errno));
+		return;
 	}
 
-	int cnt = 0;
+	const int pid = getpid ();
+	const uint32_t n_buf = trace_n_buf < TRACE_THREADS ? trace_n_buf : TRACE_THREADS;
+	bool first = true;
 
-	for (elem = snd_mixer_first_elem (ui->mixer); elem; elem = snd_mixer_elem_next (elem)) {
-		if (!snd_mixer_selem_is_active (elem)) {
+	fprintf (f, "{\"traceEvents\":[\n");
+	for (uint32_t i = 0; i < n_buf; ++i) {
+		TraceBuf const* tb = trace_buf[i];
+		if (!tb) {
 			continue;
 		}
-		++cnt;
-	}
-
-	ui->ctrl_cnt = cnt;
-
-	if (cnt == 0) {
-		fprintf (stderr, "Mixer %s: no controls found\n", card);
-		return -1;
+		const uint32_t pos = tb->pos;
+		__sync_synchronize ();
+		const uint32_t start = pos > TRACE_SIZE ? pos - TRACE_SIZE + TRACE_GUARD : 0;
+		for (uint32_t k = start; k != pos; ++k) {
+			TraceEvent const* e = &tb->ev[k & (TRACE_SIZE - 1)];
+			fprintf (f, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}",
+					first ? "" : ",\n", e->name, e->ph, (e->time - trace_t0) / 1000.0, pid, (int)tb->tid);
+			first = false;
+		}
 	}
+	fprintf (f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	fclose (f);
 
-	if (opts & OPT_PROBE) {
-		fprintf (stderr, "Device `%s' has %d contols: \n", card_name, cnt);
+	if (verbose) {
+		printf ("Trace written to '%s'\n", trace_path);
 	}
+}
 
-	ui->ctrl = (Mctrl*)calloc (cnt, sizeof (Mctrl));
-
-	Device d;
-	memset (&d, 0, sizeof (Device));
-	strncpy (d.name, card_name, 63);
-	for (int i = 0; i < MAX_GAINS; ++i) { d.out_gain_map[i] = -1; }
-	for (int i = 0; i < MAX_BUSSES; ++i) { d.out_bus_map[i] = -1; }
-	for (int i = 0; i < MAX_HIZS; ++i) { d.hiz_map[i] = -1; }
-	for (int i = 0; i < MAX_PADS; ++i) { d.pad_map[i] = -1; }
-	int obm = 0;
-
-	int i = 0;
-	for (elem = snd_mixer_first_elem (ui->mixer); elem; elem = snd_mixer_elem_next (elem)) {
-		if (!snd_mixer_selem_is_active (elem)) {
-			continue;
-		}
+static void sig_trace (int sig)
+{
+	trace_request = 1;
+}
 
-		Mctrl* c = &ui->ctrl[i];
-		c->elem = elem;
-		c->name = strdup (snd_mixer_selem_get_name (elem));
+static void trace_start (const char* path)
+{
+	trace_path = path;
+	trace_t0   = monotonic_ns ();
+	trace_on   = true;
+	atexit (trace_dump);
+	signal (SIGUSR2, sig_trace);
+}
 
-		if (opts & OPT_DETECT) {
-			if (snd_mixer_selem_is_enumerated (elem)) {
-				if (strstr (c->name, " Impedance")) {
-					d.hiz_map[d.num_hiz++] = i;
-				}
-				if (strstr (c->name, " Pad")) {
-					d.pad_map[d.num_pad++] = i;
-				}
-				if (strstr (c->name, "Input Source 01")) {
-					assert (d.input_offset == 0);
-					d.input_offset = i;
-				}
-				if (strstr (c->name, "Input Source")) {
-					++d.sin;
-				}
-				if (strstr (c->name, "Matrix 01 Input")) {
-					assert (d.matrix_in_offset == 0);
-					d.matrix_in_offset = i;
-				}
-				if (strstr (c->name, "Matrix ") && strstr (c->name, " Input")) {
-					++d.smi;
-				}
-				if (strstr (c->name, "Master ")) { // Source enum
-					d.out_bus_map[obm++] = i;
-				}
-			} else if (snd_mixer_selem_has_playback_switch (elem)) {
-				if (strstr (c->name, "Master ")) {
-					char* t1 = strchr (c->name, '(');
-					char* t2 = t1 ? strchr (t1, ')') : NULL;
-					if (t2) {
-						++t1;
-						strncpy (d.out_gain_labels[d.smst], t1, t2 - t1);
-						d.out_gain_labels[d.smst][t2 - t1] = '\0';
-					}
-					d.out_gain_map[d.smst++] = i;
-					d.sout = d.smst * 2;
-				}
-			} else if (snd_mixer_selem_has_capture_switch (elem)) {
-				;
-			} else {
-				if (strstr (c->name, "Matrix 01 Mix A")) {
-					d.matrix_mix_offset = i;
-				}
-				if (strstr (c->name, "Matrix ") && strstr (c->name, " Mix ")) {
-					int last = c->name[strlen (c->name) - 1] - 'A' + 1;
-					assert (last > 0 && last <= 20);
-					if (last > d.smo) {
-						d.smo = last;
-
-						d.matrix_mix_stride = d.smo + 1;
-						d.matrix_in_stride = d.smo + 1;
-					}
-				}
-			}
-		}
+/* *****************************************************************************
+ * Alsa Mixer Interface, see scarlett_core.c
+ */
 
-		if (opts & OPT_PROBE) {
-			printf (" %d '%s'", i, c->name);
-			if (snd_mixer_selem_is_enumerated (elem)) { printf (", ENUM"); }
-			if (snd_mixer_selem_has_playback_switch (elem)) { printf (", PBS"); }
-			if (snd_mixer_selem_has_capture_switch (elem)) { printf (", CPS"); }
-			printf ("\n");
-		}
-		++i;
-		assert (i <= cnt);
-	}
+static int open_mixer (RobTkApp* ui, const char* card, int opts)
+{
+	scarlett_verbose = verbose;
+	return scarlett_open (&ui->sm, card, opts);
+}
 
-	if ((opts & OPT_DETECT) && rv == 0 && ui->device) {
-		if (verbose > 1) {
-			printf ("CMP %d\n", memcmp (ui->device, &d, sizeof (Device)));
-			dump_device_desc (&d);
-			dump_device_desc (ui->device);
-		}
-		if (d.smi != 0 && d.smo != 0 && d.sin != 0 && d.sout != 0 && d.smst != 0 && d.input_offset != 0 && d.matrix_in_offset != 0 && d.matrix_mix_offset != 0) {
-			if (verbose) {
-				printf ("Using autodetected mapping.\n");
-			}
-			memcpy (ui->device, &d, sizeof (Device));
-		}
-	}
-	return rv;
+static int open_mixer_offline (RobTkApp* ui, Device* d)
+{
+	return scarlett_open_offline (&ui->sm, d);
 }
 
 static void close_mixer (RobTkApp* ui)
 {
-	for (unsigned int i = 0; i < ui->ctrl_cnt; ++i) {
-		free (ui->ctrl[i].name);
-	}
-	free (ui->ctrl);
-	if (ui->mixer) {
-		snd_mixer_close (ui->mixer);
+	if (ui->wq_slot) {
+		pthread_mutex_destroy (&ui->lock);
 	}
+	free (ui->wq_slot);
+	scarlett_close (&ui->sm);
 }
 
 static void set_mute (Mctrl* c, bool muted)
 {
-	int v = muted ? 0 : 1;
-	assert (c && snd_mixer_selem_has_playback_switch (c->elem));
-	for (int chn = 0; chn <= 2; ++chn) {
-		snd_mixer_selem_channel_id_t cid = (snd_mixer_selem_channel_id_t) chn;
-		if (snd_mixer_selem_has_playback_channel (c->elem, cid)) {
-			snd_mixer_selem_set_playback_switch (c->elem, cid, v);
-		}
-	}
+	TRACE_BEGIN ("set_mute");
+	scarlett_set_mute (c, muted);
+	TRACE_END ("set_mute");
 }
 
 static bool get_mute (Mctrl* c)
 {
-	int v = 0;
-	assert (c && snd_mixer_selem_has_playback_switch (c->elem));
-	snd_mixer_selem_get_playback_switch (c->elem, (snd_mixer_selem_channel_id_t)0, &v);
-	return v == 0;
+	return scarlett_get_mute (c);
 }
 
 static float get_dB (Mctrl* c)
 {
-	assert (c);
-	long val = 0;
-	snd_mixer_selem_get_playback_dB (c->elem, (snd_mixer_selem_channel_id_t)0, &val);
-	return val / 100.f;
+	return scarlett_get_dB (c);
+}
+
+static void set_cdB (Mctrl* c, long val)
+{
+	TRACE_BEGIN ("set_dB");
+	scarlett_set_cdB (c, val);
+	TRACE_END ("set_dB");
 }
 
 static void set_dB (Mctrl* c, float dB)
 {
-	long val = 100.f * dB;
-	for (int chn = 0; chn <= 2; ++chn) {
-		snd_mixer_selem_channel_id_t cid = (snd_mixer_selem_channel_id_t) chn;
-		if (snd_mixer_selem_has_playback_channel (c->elem, cid)) {
-			snd_mixer_selem_set_playback_dB (c->elem, cid, val, /*playback*/0);
-		}
-		if (snd_mixer_selem_has_capture_channel (c->elem, cid)) {
-			snd_mixer_selem_set_playback_dB (c->elem, cid, val, /*capture*/1);
-		}
-	}
+	set_cdB (c, lrintf (100.f * dB));
 }
 
 static float get_dB_range (Mctrl* c, bool maximum)
 {
-	long min, max;
-	min = max = 0;
-	snd_mixer_selem_get_playback_dB_range (c->elem, &min, &max);
-	if (maximum) {
-		return max / 100.f;
-	} else {
-		return min / 100.f;
-	}
+	return scarlett_get_dB_range (c, maximum);
 }
 
 static void set_enum (Mctrl* c, int v)
 {
-	assert (snd_mixer_selem_is_enumerated (c->elem));
-	snd_mixer_selem_set_enum_item (c->elem, (snd_mixer_selem_channel_id_t)0, v);
+	TRACE_BEGIN ("set_enum");
+	scarlett_set_enum (c, v);
+	TRACE_END ("set_enum");
 }
 
 static int get_enum (Mctrl* c)
 {
-	unsigned int idx = 0;
-	assert (snd_mixer_selem_is_enumerated (c->elem));
-	snd_mixer_selem_get_enum_item (c->elem, (snd_mixer_selem_channel_id_t)0, &idx);
-	return idx;
+	return scarlett_get_enum (c);
 }
 
-/* *****************************************************************************
- * Helpers
- */
+static int get_enum_items (Mctrl* c)
+{
+	return scarlett_get_enum_items (c);
+}
 
-static float db_to_knob (float db)
+static int get_enum_item_name (Mctrl* c, int item, size_t len, char* name)
 {
-	float k = (db + 128.f) / 228.75f;
-	float s = k * sqrt (0.5) / (1 - k);
-	return s * s;
+	return scarlett_get_enum_item_name (c, item, len, name);
 }
 
-static float knob_to_db (float v)
+static unsigned int ctrl_id (RobTkApp* ui, Mctrl* c)
 {
-	// v = 0..1
-	float db = sqrtf (v) / (sqrtf (0.5) + sqrtf (v)) * 228.75f - 128.f;
-	if (db > 6.f) return 6.f;
-	return rint (db);
+	return scarlett_ctrl_id (&ui->sm, c);
+}
+
+static int32_t ctrl_get (RobTkApp* ui, unsigned int id, int type)
+{
+	return scarlett_ctrl_get (&ui->sm, id, type);
+}
+
+/* like scarlett_ctrl_set(), traced */
+static void ctrl_set (RobTkApp* ui, unsigned int id, int type, int32_t val)
+{
+	Mctrl* c = &ui->sm.ctrl[id];
+	switch (type) {
+		case CV_DB:
+			set_cdB (c, val);
+			break;
+		case CV_MUTE:
+			set_mute (c, val != 0);
+			break;
+		case CV_ENUM:
+			set_enum (c, val);
+			break;
+		default:
+			assert (0);
+	}
+}
+
+static bool ctrl_has (RobTkApp* ui, unsigned int id, int type)
+{
+	return scarlett_ctrl_has (&ui->sm, id, type);
 }
 
 /* *****************************************************************************
- * Callbacks
+ * Automation journal
+ *
+ * Control changes are appended as fixed-size binary records to a
+ * memory-mapped file. The writer only copies a record into the mapping,
+ * the file is grown ahead of time by jrn_reserve () from the event loop,
+ * outside of ui->lock. Records that do not fit are dropped.
+ * The journal starts with a snapshot of all control values.
  */
 
-static bool cb_btn_reset (RobWidget* w, void* handle) {
-	RobTkApp* ui = (RobTkApp*)handle;
-	/* toggle all values (force change) */
+#define JRN_MAGIC "SCMJRNL1"
+#define JRN_CHUNK 65536 //< records per allocation step
+#define JRN_GROW  (JRN_CHUNK / 4) //< grow when fewer records are left
 
-	for (int r = 0; r < ui->device->sin; ++r) {
-		Mctrl* sctrl = src_sel (ui, r);
-		int mcnt = snd_mixer_selem_get_enum_items (sctrl->elem);
-		const int val = robtk_select_get_value (ui->src_sel[r]);
-		set_enum (sctrl, (val + 1) % mcnt);
-		set_enum (sctrl, val);
+enum JrnSource {
+	JRN_INIT = 0, //< initial state
+	JRN_GUI,      //< written by this application
+	JRN_EXT,      //< external change, ALSA event
+};
+
+typedef struct _JournalRec {
+	uint64_t time;   //< nsec since start of journal (CLOCK_MONOTONIC)
+	uint16_t id;     //< index into ui->sm.ctrl[]
+	uint8_t  type;   //< CtrlValType
+	uint8_t  source; //< JrnSource
+	int32_t  val;
+} JournalRec;
+
+typedef struct _JournalHdr {
+	char     magic[8];
+	char     device[64];
+	uint32_t ctrl_cnt;
+	uint32_t rec_size;
+	uint64_t n_records;
+	int64_t  start;    //< wall-clock, unix-time
+	uint8_t  _pad[40];
+} JournalHdr;
+
+static int jrn_map (Journal* j, uint64_t n_alloc)
+{
+	size_t len = sizeof (JournalHdr) + n_alloc * sizeof (JournalRec);
+	if (ftruncate (j->fd, len)) {
+		return -1;
 	}
-	for (int r = 0; r < ui->device->smi; ++r) {
-		Mctrl* sctrl = matrix_sel (ui, r);
-		int mcnt = snd_mixer_selem_get_enum_items (sctrl->elem);
-		const int val = robtk_select_get_value (ui->mtx_sel[r]);
-		set_enum (sctrl, (val + 1) % mcnt);
-		set_enum (sctrl, val);
+	void* m = mmap (NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, j->fd, 0);
+	if (m == MAP_FAILED) {
+		return -1;
 	}
-	for (unsigned int o = 0; o < ui->device->sout; ++o) {
-		Mctrl* sctrl = out_sel (ui, o);
-		int mcnt = snd_mixer_selem_get_enum_items (sctrl->elem);
-		const int val = robtk_select_get_value (ui->out_sel[o]);
-		set_enum (sctrl, (val + 1) % mcnt);
-		set_enum (sctrl, val);
+	if (j->hdr) {
+		munmap (j->hdr, j->len);
 	}
+	j->hdr     = (JournalHdr*)m;
+	j->rec     = (JournalRec*)(j->hdr + 1);
+	j->len     = len;
+	j->n_alloc = n_alloc;
+	return 0;
+}
 
-	for (int r = 0; r < ui->device->smi; ++r) {
-		for (unsigned int c = 0; c < ui->device->smo; ++c) {
-			unsigned int n = r * ui->device->smo + c;
-			Mctrl* ctrl = matrix_ctrl_cr (ui, c, r);
-			const float val = knob_to_db (robtk_dial_get_value (ui->mtx_gain[n]));
-			if (val == -128) {
-				set_dB (ctrl, 127);
-			} else {
-				set_dB (ctrl, -128);
-			}
-			set_dB (ctrl, val);
-		}
+static void jrn_close (RobTkApp* ui)
+{
+	Journal* j = &ui->jrn;
+	if (j->fd < 0) {
+		return;
 	}
-	for (unsigned int n = 0; n < ui->device->smst; ++n) {
-		Mctrl* ctrl = out_gain (ui, n);
-		const bool mute = robtk_dial_get_state (ui->out_gain[n]) == 1;
-		const float val = knob_to_db (robtk_dial_get_value (ui->out_gain[n]));
-		set_mute (ctrl, !mute);
-		set_mute (ctrl, mute);
-		if (val == -128) {
-			set_dB (ctrl, 127);
-		} else {
-			set_dB (ctrl, -128);
-		}
-		set_dB (ctrl, val);
+	uint64_t n = j->hdr->n_records;
+	munmap (j->hdr, j->len);
+	if (ftruncate (j->fd, sizeof (JournalHdr) + n * sizeof (JournalRec))) {
+		;
 	}
-	return TRUE;
+	if (j->n_dropped > 0) {
+		fprintf (stderr, "Journal: %" PRIu64 " records were dropped.\n", j->n_dropped);
+	}
+	close (j->fd);
+	free (j->shadow);
+	j->fd     = -1;
+	j->hdr    = NULL;
+	j->shadow = NULL;
 }
 
-static bool cb_set_hiz (RobWidget* w, void* handle) {
-	RobTkApp* ui = (RobTkApp*)handle;
-	if (ui->disable_signals) return TRUE;
-	for (uint32_t i = 0; i < 2; ++i) {
-		int val = robtk_cbtn_get_active (ui->btn_hiz[i]) ? 1 : 0;
-		set_enum (hiz (ui, i), val);
+static void jrn_append (RobTkApp* ui, unsigned int id, int type, int source, int32_t val)
+{
+	Journal* j = &ui->jrn;
+	if (j->fd < 0) {
+		return;
 	}
-	return TRUE;
+	uint64_t n = j->hdr->n_records;
+	if (n == j->n_alloc) {
+		/* never grow here, this may run with ui->lock held */
+		++j->n_dropped;
+		return;
+	}
+	JournalRec* r = &j->rec[n];
+	r->time   = monotonic_ns () - j->t0;
+	r->id     = id;
+	r->type   = type;
+	r->source = source;
+	r->val    = val;
+	j->shadow[id * CV_TYPES + type] = val;
+	__sync_synchronize ();
+	j->hdr->n_records = n + 1;
 }
 
-static bool cb_set_pad (RobWidget* w, void* handle) {
-	RobTkApp* ui = (RobTkApp*)handle;
-	if (ui->disable_signals) return TRUE;
-	for (uint32_t i = 0; i < 4; ++i) {
-		int val = robtk_cbtn_get_active (ui->btn_pad[i]) ? 1 : 0;
-		set_enum (pad (ui, i), val);
+/* called from the event loop, without ui->lock, before the mapping is full */
+static void jrn_reserve (RobTkApp* ui)
+{
+	Journal* j = &ui->jrn;
+	if (j->fd < 0 || j->n_alloc - j->hdr->n_records > JRN_GROW) {
+		return;
+	}
+	if (jrn_map (j, j->n_alloc + JRN_CHUNK)) {
+		if (!j->grow_err) {
+			fprintf (stderr, "Journal: cannot grow file: %s\n", strerror (errno));
+		}
+		j->grow_err = true;
+	} else {
+		j->grow_err = false;
 	}
-	return TRUE;
 }
 
-static bool cb_src_sel (RobWidget* w, void* handle) {
-	RobTkApp* ui = (RobTkApp*)handle;
-	if (ui->disable_signals) return TRUE;
-	unsigned int n;
-	memcpy (&n, w->name, sizeof (unsigned int));
-	const float val = robtk_select_get_value (ui->src_sel[n]);
-	set_enum (src_sel (ui, n), val);
-	return TRUE;
+static int jrn_open (RobTkApp* ui, const char* path)
+{
+	Journal* j = &ui->jrn;
+	j->fd = open (path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (j->fd < 0) {
+		fprintf (stderr, "Cannot open journal '%s': %s\n", path, strerror (errno));
+		return -1;
+	}
+	if (jrn_map (j, JRN_CHUNK)) {
+		fprintf (stderr, "Cannot map journal '%s': %s\n", path, strerror (errno));
+		close (j->fd);
+		j->fd = -1;
+		return -1;
+	}
+
+	JournalHdr* h = j->hdr;
+	memcpy (h->magic, JRN_MAGIC, 8);
+	strncpy (h->device, ui->sm.device->name, 63);
+	h->ctrl_cnt  = ui->sm.ctrl_cnt;
+	h->rec_size  = sizeof (JournalRec);
+	h->n_records = 0;
+	h->start     = time (NULL);
+
+	j->shadow = (int32_t*)malloc (ui->sm.ctrl_cnt * CV_TYPES * sizeof (int32_t));
+	j->t0     = monotonic_ns ();
+
+	for (unsigned int id = 0; id < ui->sm.ctrl_cnt; ++id) {
+		for (int t = 0; t < CV_TYPES; ++t) {
+			if (ctrl_has (ui, id, t)) {
+				jrn_append (ui, id, t, JRN_INIT, ctrl_get (ui, id, t));
+			}
+		}
+	}
+	return 0;
 }
 
-static bool cb_mtx_src (RobWidget* w, void* handle) {
+/* record controls that were modified externally, see elem_changed() */
+static void jrn_external (RobTkApp* ui, unsigned int id)
+{
+	Journal* j = &ui->jrn;
+	if (j->fd < 0) {
+		return;
+	}
+	for (int t = 0; t < CV_TYPES; ++t) {
+		if (!ctrl_has (ui, id, t)) {
+			continue;
+		}
+		int32_t val = ctrl_get (ui, id, t);
+		if (val != j->shadow[id * CV_TYPES + t]) {
+			jrn_append (ui, id, t, JRN_EXT, val);
+		}
+	}
+}
+
+/* *****************************************************************************
+ * Undo history
+ *
+ * User initiated changes are recorded as control-id/old/new records in a
+ * fixed size ring-buffer. Records of one gesture are grouped, consecutive
+ * changes of the same control (e.g. a dial drag) are merged.
+ */
+
+/* start a new gesture, key identifies the control that was modified */
+static void hist_begin (RobTkApp* ui, int key)
+{
+	const uint64_t now = monotonic_ms ();
+	const bool merge = key >= 0 && key == ui->hist_key
+		&& now - ui->hist_time < HIST_MERGE_MS
+		&& ui->hist_pos == ui->hist_end;
+
+	ui->hist_time  = now;
+	ui->hist_merge = merge;
+	if (!merge) {
+		ui->hist_key = key;
+		ui->hist_new = true;
+	}
+}
+
+static void hist_record (RobTkApp* ui, unsigned int id, int type, int32_t old_val, int32_t new_val)
+{
+	if (ui->hist_suspend > 0) {
+		return;
+	}
+
+	if (ui->hist_merge) {
+		uint32_t i = ui->hist_gesture;
+		if (i - ui->hist_start > ui->hist_end - ui->hist_start) {
+			i = ui->hist_start;
+		}
+		for (; i != ui->hist_end; ++i) {
+			HistRec* h = &ui->hist[i % HIST_SIZE];
+			if (h->id == id && h->type == type) {
+				h->new_val = new_val;
+				return;
+			}
+		}
+	}
+
+	if (old_val == new_val) {
+		return;
+	}
+
+	/* discard redo */
+	ui->hist_end = ui->hist_pos;
+
+	if (ui->hist_end - ui->hist_start == HIST_SIZE) {
+		/* drop oldest gesture */
+		do {
+			++ui->hist_start;
+		} while (ui->hist_start != ui->hist_end && !(ui->hist[ui->hist_start % HIST_SIZE].flags & HIST_START));
+	}
+
+	HistRec* h = &ui->hist[ui->hist_end % HIST_SIZE];
+	h->id      = id;
+	h->type    = type;
+	h->flags   = 0;
+	h->old_val = old_val;
+	h->new_val = new_val;
+
+	if (ui->hist_new || ui->hist_end == ui->hist_start) {
+		h->flags |= HIST_START;
+		ui->hist_gesture = ui->hist_end;
+		ui->hist_new = false;
+	}
+
+	ui->hist_pos = ++ui->hist_end;
+}
+
+/* *****************************************************************************
+ * Performance HUD
+ *
+ * Counters are always updated, they are summarized once per second and
+ * drawn as an overlay on top of the window only when enabled.
+ */
+
+static unsigned int hud_lat_bin (uint64_t ns)
+{
+	const float us = ns / 1000.f;
+	if (us < 1.f) {
+		return 0;
+	}
+	const unsigned int b = 1 + (unsigned int)(2.f * log2f (us));
+	return b < HUD_LAT_BINS ? b : HUD_LAT_BINS - 1;
+}
+
+/* upper edge of the bin that contains the given fraction, in msec */
+static float hud_percentile (Perf const* p, float frac)
+{
+	const uint32_t n = ceilf (frac * p->n_lat);
+	uint32_t sum = 0;
+	for (unsigned int b = 0; b < HUD_LAT_BINS; ++b) {
+		sum += p->lat[b];
+		if (sum >= n) {
+			return powf (2.f, b * .5f) / 1000.f;
+		}
+	}
+	return 0;
+}
+
+/* leaf widgets intersecting the exposed area */
+static unsigned int hud_count_widgets (RobWidget* rw, float x0, float y0, cairo_rectangle_t const* ev)
+{
+	if (rw->hidden) {
+		return 0;
+	}
+	const float x = x0 + rw->area.x;
+	const float y = y0 + rw->area.y;
+	if (x >= ev->x + ev->width || y >= ev->y + ev->height || x + rw->area.width <= ev->x || y + rw->area.height <= ev->y) {
+		return 0;
+	}
+	if (rw->childcount == 0) {
+		return 1;
+	}
+	unsigned int n = 0;
+	for (unsigned int i = 0; i < rw->childcount; ++i) {
+		n += hud_count_widgets (rw->children[i], x, y, ev);
+	}
+	return n;
+}
+
+/* the top-level box' self is robtk's container, the owner is kept here
+ * for callbacks wrapping it */
+static RobTkApp* hud_ui = NULL;
+
+static void hud_area (RobTkApp* ui, cairo_rectangle_t* a)
+{
+	a->width  = HUD_W;
+	a->height = HUD_H;
+	a->x      = ui->rw->area.width - HUD_W - 4;
+	a->y      = 4;
+}
+
+static void hud_draw (RobTkApp* ui, cairo_t* cr)
+{
+	Perf const* p = &ui->perf;
+	cairo_rectangle_t a;
+	char txt[512];
+	hud_area (ui, &a);
+
+	snprintf (txt, sizeof (txt),
+			"render   %5.2f ms avg %5.2f max\n"
+			"frames   %5.1f /s  %5.1f widgets\n"
+			"alsa     %5.0f events/s\n"
+			"idle     %5.0f wakeups/s\n"
+			"queue    %5u max depth\n"
+			"write    %5.2f ms p50 %5.2f p99\n"
+			"meters   %5u xruns",
+			p->render_avg, p->render_max_ms,
+			p->fps, p->widgets_avg,
+			p->events_s,
+			p->wakeups_s,
+			p->wq_depth,
+			p->lat_p50, p->lat_p99,
+			p->xruns);
+
+	cairo_save (cr);
+	cairo_set_source_rgba (cr, 0, 0, 0, .75);
+	rounded_rectangle (cr, a.x, a.y, a.width, a.height, 4);
+	cairo_fill (cr);
+
+	PangoLayout* pl = pango_cairo_create_layout (cr);
+	pango_layout_set_font_description (pl, ui->font);
+	pango_layout_set_text (pl, txt, -1);
+	cairo_move_to (cr, a.x + 4, a.y + 4);
+	CairoSetSouerceRGBA (c_wht);
+	pango_cairo_show_layout (cr, pl);
+	g_object_unref (pl);
+	cairo_restore (cr);
+}
+
+/* replaces the expose callback of the top-level box */
+static bool hud_expose_event (RobWidget* rw, cairo_t* cr, cairo_rectangle_t* ev)
+{
+	RobTkApp* ui = hud_ui;
+	Perf* p = &ui->perf;
+
+	const uint64_t t0 = monotonic_ns ();
+	const bool rv = ui->rw_expose (rw, cr, ev);
+	const uint64_t dt = monotonic_ns () - t0;
+
+	++p->frames;
+	p->render_ns += dt;
+	if (dt > p->render_max) {
+		p->render_max = dt;
+	}
+
+	if (p->on) {
+		p->widgets += hud_count_widgets (rw, -rw->area.x, -rw->area.y, ev);
+		hud_draw (ui, cr);
+	}
+	return rv;
+}
+
+/* from every port_event () call, the display is updated once per second */
+static void hud_tick (RobTkApp* ui)
+{
+	Perf* p = &ui->perf;
+	const uint64_t now = monotonic_ns ();
+
+	/* the previous call was idle if it did not handle any events,
+	 * wrote or queued nothing and did not cause a redraw */
+	if (p->events == p->prev_events && p->writes == p->prev_writes
+	    && p->frames == p->prev_frames && ui->wq_len == 0) {
+		++p->wakeups;
+	}
+	p->prev_events = p->events;
+	p->prev_writes = p->writes;
+	p->prev_frames = p->frames;
+
+	if (now - p->t0 < 1000000000ULL) {
+		return;
+	}
+	const float dt = (now - p->t0) * 1e-9f;
+	p->t0 = now;
+
+	p->fps           = p->frames / dt;
+	p->render_avg    = p->frames > 0 ? p->render_ns / (1e6f * p->frames) : 0;
+	p->render_max_ms = p->render_max / 1e6f;
+	p->widgets_avg   = p->frames > 0 ? p->widgets / (float)p->frames : 0;
+	p->events_s      = p->events / dt;
+	p->wakeups_s     = p->wakeups / dt;
+	p->wq_depth      = p->wq_max;
+	p->lat_p50       = hud_percentile (p, .50f);
+	p->lat_p99       = hud_percentile (p, .99f);
+	p->xruns         = ui->meter ? ui->meter->xruns : 0;
+
+	p->frames = p->widgets = p->events = p->wakeups = p->wq_max = p->n_lat = 0;
+	p->prev_frames = p->prev_events = 0;
+	p->render_ns = p->render_max = 0;
+	memset (p->lat, 0, sizeof (p->lat));
+
+	if (p->on) {
+		cairo_rectangle_t a;
+		hud_area (ui, &a);
+		queue_draw_area (ui->rw, a.x, a.y, a.width, a.height);
+	}
+}
+
+/* *****************************************************************************
+ * Interaction recording
+ *
+ * Pointer events are written as time-stamped lines in top-level
+ * coordinates, to be replayed headlessly by scarlett-mixer-bench:
+ *
+ *   device <name>
+ *   size <width> <height> <scale>
+ *   <msec> press|release <x> <y> <button> <state>
+ *   <msec> move <x> <y> <state>
+ *   <msec> scroll <x> <y> <direction> <state>
+ *
+ * robtk delivers motion and release to the widget that accepted the
+ * press, so that widget's callbacks are wrapped for the duration of the
+ * grab.
+ */
+
+static void rec_event (RobTkApp* ui, RobWidget* rw, const char* what, RobTkBtnEvent const* ev)
+{
+	Recorder* r = &ui->rec;
+	RobWidget* tl = ui->rw;
+	int x = ev->x;
+	int y = ev->y;
+
+	/* widget to top-level coordinates */
+	for (; rw && rw != tl; rw = rw->parent) {
+		x += rw->area.x;
+		y += rw->area.y;
+	}
+
+	if (r->w != tl->area.width || r->h != tl->area.height || r->scale != tl->widget_scale) {
+		r->w     = tl->area.width;
+		r->h     = tl->area.height;
+		r->scale = tl->widget_scale;
+		fprintf (r->f, "size %d %d %.2f\n", r->w, r->h, r->scale);
+	}
+
+	const double ms = (monotonic_ns () - r->t0) / 1e6;
+	if (!strcmp (what, "move")) {
+		fprintf (r->f, "%.3f %s %d %d %d\n", ms, what, x, y, ev->state);
+	} else {
+		fprintf (r->f, "%.3f %s %d %d %d %d\n", ms, what, x, y,
+				strcmp (what, "scroll") ? ev->button : ev->direction, ev->state);
+	}
+}
+
+/* track the widget that holds the pointer grab, wrap its callbacks */
+static RobWidget* rec_grab (Recorder* r, RobWidget* rw,
+		RobWidget* (*move) (RobWidget*, RobTkBtnEvent*),
+		RobWidget* (*up) (RobWidget*, RobTkBtnEvent*))
+{
+	if (rw == r->focus) {
+		return rw;
+	}
+	if (r->focus) {
+		r->focus->mousemove = r->focus_move;
+		r->focus->mouseup   = r->focus_up;
+	}
+	r->focus = rw;
+	if (rw) {
+		r->focus_move = rw->mousemove;
+		r->focus_up   = rw->mouseup;
+		if (rw->mousemove && move) {
+			rw->mousemove = move;
+		}
+		if (rw->mouseup && up) {
+			rw->mouseup = up;
+		}
+	}
+	return rw;
+}
+
+static RobWidget* rec_focus_up (RobWidget* rw, RobTkBtnEvent* ev)
+{
+	RobTkApp* ui = hud_ui;
+	rec_event (ui, rw, "release", ev);
+	return rec_grab (&ui->rec, ui->rec.focus_up (rw, ev), NULL, rec_focus_up);
+}
+
+static RobWidget* rec_focus_move (RobWidget* rw, RobTkBtnEvent* ev)
+{
+	RobTkApp* ui = hud_ui;
+	rec_event (ui, rw, "move", ev);
+	return rec_grab (&ui->rec, ui->rec.focus_move (rw, ev), rec_focus_move, rec_focus_up);
+}
+
+static RobWidget* rec_mousedown (RobWidget* rw, RobTkBtnEvent* ev)
+{
+	RobTkApp* ui = hud_ui;
+	rec_event (ui, NULL, "press", ev);
+	return rec_grab (&ui->rec, ui->rec.tl_down (rw, ev), rec_focus_move, rec_focus_up);
+}
+
+static RobWidget* rec_mousescroll (RobWidget* rw, RobTkBtnEvent* ev)
+{
+	RobTkApp* ui = hud_ui;
+	rec_event (ui, NULL, "scroll", ev);
+	return ui->rec.tl_scroll (rw, ev);
+}
+
+static int rec_open (RobTkApp* ui, const char* path)
+{
+	Recorder* r = &ui->rec;
+	r->f = fopen (path, "w");
+	if (!r->f) {
+		fprintf (stderr, "Cannot open '%s': %s\n", path, strerror (errno));
+		return -1;
+	}
+	fprintf (r->f, "device %s\n", ui->sm.device->name);
+	r->t0 = monotonic_ns ();
+	return 0;
+}
+
+/* called from toplevel (), once the widget tree exists */
+static void rec_start (RobTkApp* ui)
+{
+	Recorder* r = &ui->rec;
+	if (!r->f) {
+		return;
+	}
+	r->tl_down   = ui->rw->mousedown;
+	r->tl_scroll = ui->rw->mousescroll;
+	robwidget_set_mousedown (ui->rw, rec_mousedown);
+	robwidget_set_mousescroll (ui->rw, rec_mousescroll);
+}
+
+static void rec_close (RobTkApp* ui)
+{
+	Recorder* r = &ui->rec;
+	if (!r->f) {
+		return;
+	}
+	rec_grab (r, NULL, NULL, NULL);
+	fclose (r->f);
+	r->f = NULL;
+}
+
+/* *****************************************************************************
+ * Batched writes
+ *
+ * Changes are queued as control-id/value pairs, coalesced per control
+ * and written at most once per idle cycle, and only if the value differs
+ * from the current device state.
+ */
+
+static void wq_init (RobTkApp* ui)
+{
+	pthread_mutex_init (&ui->lock, NULL);
+	ui->wq_len  = 0;
+	ui->wq_slot = (int*)malloc (ui->sm.ctrl_cnt * CV_TYPES * sizeof (int));
+	for (unsigned int i = 0; i < ui->sm.ctrl_cnt * CV_TYPES; ++i) {
+		ui->wq_slot[i] = -1;
+	}
+}
+
+static void wq_flush (RobTkApp* ui)
+{
+	if (ui->wq_len == 0) {
+		return;
+	}
+	TRACE_BEGIN ("wq_flush");
+	if (ui->wq_len > ui->perf.wq_max) {
+		ui->perf.wq_max = ui->wq_len;
+	}
+	pthread_mutex_lock (&ui->lock);
+	for (unsigned int i = 0; i < ui->wq_len; ++i) {
+		CtrlVal const* cv = &ui->wq[i];
+		ui->wq_slot[cv->id * CV_TYPES + cv->type] = -1;
+		if (ctrl_get (ui, cv->id, cv->type) != cv->val) {
+			ctrl_set (ui, cv->id, cv->type, cv->val);
+			jrn_append (ui, cv->id, cv->type, JRN_GUI, ctrl_get (ui, cv->id, cv->type));
+			ui->perf.t_write = monotonic_ns ();
+			++ui->perf.lat[hud_lat_bin (ui->perf.t_write - ui->wq_time[i])];
+			++ui->perf.n_lat;
+			++ui->perf.writes;
+		}
+	}
+	ui->wq_len = 0;
+	pthread_mutex_unlock (&ui->lock);
+	ui->last_write = monotonic_ms ();
+	if (ui->meter) {
+		ui->meter->mix_dirty = true;
+	}
+	TRACE_END ("wq_flush");
+}
+
+/* pending value, if any, or current device state */
+static int32_t wq_get (RobTkApp* ui, unsigned int id, int type)
+{
+	int slot = ui->wq_slot[id * CV_TYPES + type];
+	if (slot >= 0) {
+		return ui->wq[slot].val;
+	}
+	return ctrl_get (ui, id, type);
+}
+
+/* the queue is locked, the cue thread modifies pending values */
+static void wq_push (RobTkApp* ui, Mctrl* c, int type, int32_t val)
+{
+	unsigned int id = ctrl_id (ui, c);
+	if (ui->wq_len == WQ_SIZE) {
+		wq_flush (ui);
+	}
+	pthread_mutex_lock (&ui->lock);
+	int slot = ui->wq_slot[id * CV_TYPES + type];
+	hist_record (ui, id, type, slot >= 0 ? ui->wq[slot].val : ctrl_get (ui, id, type), val);
+	if (slot >= 0) {
+		ui->wq[slot].val = val;
+		pthread_mutex_unlock (&ui->lock);
+		return;
+	}
+	ui->wq_slot[id * CV_TYPES + type] = ui->wq_len;
+	ui->wq_time[ui->wq_len] = monotonic_ns ();
+	ui->wq[ui->wq_len].id   = id;
+	ui->wq[ui->wq_len].type = type;
+	ui->wq[ui->wq_len].val  = val;
+	++ui->wq_len;
+	pthread_mutex_unlock (&ui->lock);
+}
+
+static void wq_push_dB (RobTkApp* ui, Mctrl* c, float dB)
+{
+	wq_push (ui, c, CV_DB, lrintf (100.f * dB));
+}
+
+/* *****************************************************************************
+ * Undo / Redo
+ */
+
+static void hist_update_buttons (RobTkApp* ui)
+{
+	if (!ui->btn_undo) {
+		return;
+	}
+	robtk_pbtn_set_sensitive (ui->btn_undo, ui->hist_pos != ui->hist_start);
+	robtk_pbtn_set_sensitive (ui->btn_redo, ui->hist_pos != ui->hist_end);
+}
+
+/* replay the old values of the last gesture */
+static void hist_undo (RobTkApp* ui)
+{
+	if (ui->hist_pos == ui->hist_start) {
+		return;
+	}
+	++ui->hist_suspend;
+	uint32_t i = ui->hist_pos;
+	do {
+		--i;
+		HistRec const* h = &ui->hist[i % HIST_SIZE];
+		wq_push (ui, &ui->sm.ctrl[h->id], h->type, h->old_val);
+		if (h->flags & HIST_START) {
+			break;
+		}
+	} while (i != ui->hist_start);
+	--ui->hist_suspend;
+
+	ui->hist_pos = i;
+	ui->hist_key = -1;
+	ui->need_refresh = true;
+}
+
+/* replay the new values of the next gesture */
+static void hist_redo (RobTkApp* ui)
+{
+	if (ui->hist_pos == ui->hist_end) {
+		return;
+	}
+	++ui->hist_suspend;
+	uint32_t i = ui->hist_pos;
+	do {
+		HistRec const* h = &ui->hist[i % HIST_SIZE];
+		wq_push (ui, &ui->sm.ctrl[h->id], h->type, h->new_val);
+		++i;
+	} while (i != ui->hist_end && !(ui->hist[i % HIST_SIZE].flags & HIST_START));
+	--ui->hist_suspend;
+
+	ui->hist_pos = i;
+	ui->hist_key = -1;
+	ui->need_refresh = true;
+}
+
+/* *****************************************************************************
+ * Journal replay
+ */
+
+/* re-apply a recorded session with the original timing */
+static int jrn_replay (RobTkApp* ui, const char* path)
+{
+	int fd = open (path, O_RDONLY);
+	if (fd < 0) {
+		fprintf (stderr, "Cannot open journal '%s': %s\n", path, strerror (errno));
+		return -1;
+	}
+
+	struct stat st;
+	if (fstat (fd, &st) || st.st_size < sizeof (JournalHdr)) {
+		fprintf (stderr, "Invalid journal '%s'\n", path);
+		close (fd);
+		return -1;
+	}
+
+	void* m = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);
+	if (m == MAP_FAILED) {
+		fprintf (stderr, "Cannot map journal '%s': %s\n", path, strerror (errno));
+		return -1;
+	}
+
+	JournalHdr const* h = (JournalHdr const*)m;
+	JournalRec const* rec = (JournalRec const*)(h + 1);
+	uint64_t n = (st.st_size - sizeof (JournalHdr)) / sizeof (JournalRec);
+
+	if (memcmp (h->magic, JRN_MAGIC, 8) || h->rec_size != sizeof (JournalRec) || h->ctrl_cnt != ui->sm.ctrl_cnt) {
+		fprintf (stderr, "Journal '%s' does not match this device\n", path);
+		munmap (m, st.st_size);
+		return -1;
+	}
+	if (strncmp (h->device, ui->sm.device->name, 64)) {
+		fprintf (stderr, "Warning: journal was recorded with '%.64s'\n", h->device);
+	}
+	if (h->n_records < n) {
+		n = h->n_records;
+	}
+
+	if (verbose) {
+		printf ("Replaying %" PRIu64 " records\n", n);
+	}
+
+	const uint64_t t0 = monotonic_ns ();
+
+	for (uint64_t i = 0; i < n; ++i) {
+		JournalRec const* r = &rec[i];
+		if (r->id >= ui->sm.ctrl_cnt || r->type >= CV_TYPES) {
+			continue;
+		}
+		const uint64_t when = t0 + r->time;
+		if (when > monotonic_ns () + 1000000) {
+			/* write all changes up to now as one batch, then wait */
+			wq_flush (ui);
+			struct timespec ts;
+			ts.tv_sec  = when / 1000000000ULL;
+			ts.tv_nsec = when % 1000000000ULL;
+			while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) ;
+		}
+		wq_push (ui, &ui->sm.ctrl[r->id], r->type, r->val);
+	}
+	wq_flush (ui);
+
+	munmap (m, st.st_size);
+	return 0;
+}
+
+/* *****************************************************************************
+ * Read-back verification
+ *
+ * Periodically re-read the device controls (bypassing alsa-lib's cache)
+ * and compare them to the state that is known to the mixer (and shown
+ * in the GUI). Controls that drifted are re-sent. Verification runs in
+ * small batches and backs off while the user is writing or the bus is slow.
+ */
+
+#define VFY_INTERVAL_MIN   40  //< msec between batches
+#define VFY_INTERVAL_MAX 2000
+#define VFY_BATCH_MAX      32
+#define VFY_IDLE_MS       500  //< no verification this long after a write
+
+static const char* vfy_suffix[] = {
+	" Playback Volume", " Playback Switch", " Playback Enum", " Playback Route",
+	" Capture Volume", " Capture Switch", " Capture Enum", " Capture Route",
+	" Volume", " Switch", "",
+};
+
+static bool vfy_match (const char* hname, const char* sname)
+{
+	const size_t len = strlen (sname);
+	if (strncmp (hname, sname, len)) {
+		return false;
+	}
+	for (size_t i = 0; i < sizeof (vfy_suffix) / sizeof (char*); ++i) {
+		if (!strcmp (hname + len, vfy_suffix[i])) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void vfy_init (RobTkApp* ui)
+{
+	Verify* v = &ui->vfy;
+	snd_hctl_t* hctl;
+
+	if (snd_mixer_get_hctl (ui->sm.mixer, ui->sm.card, &hctl) < 0) {
+		fprintf (stderr, "Verify: cannot access control interface\n");
+		return;
+	}
+
+	snd_ctl_elem_info_t* info;
+	snd_ctl_elem_info_alloca (&info);
+
+	v->elem = (VerifyElem*)calloc (2 * ui->sm.ctrl_cnt, sizeof (VerifyElem));
+	v->n_elem = 0;
+
+	for (snd_hctl_elem_t* he = snd_hctl_first_elem (hctl); he; he = snd_hctl_elem_next (he)) {
+		if (snd_hctl_elem_info (he, info) < 0) {
+			continue;
+		}
+		const char* hname = snd_hctl_elem_get_name (he);
+		const snd_ctl_elem_type_t type = snd_ctl_elem_info_get_type (info);
+		if (type != SND_CTL_ELEM_TYPE_INTEGER && type != SND_CTL_ELEM_TYPE_BOOLEAN && type != SND_CTL_ELEM_TYPE_ENUMERATED) {
+			continue;
+		}
+		for (unsigned int id = 0; id < ui->sm.ctrl_cnt && v->n_elem < 2 * ui->sm.ctrl_cnt; ++id) {
+			snd_mixer_elem_t* elem = ui->sm.ctrl[id].elem;
+			if (snd_hctl_elem_get_index (he) != snd_mixer_selem_get_index (elem)) {
+				continue;
+			}
+			if (!vfy_match (hname, ui->sm.ctrl[id].name)) {
+				continue;
+			}
+			VerifyElem* ve = &v->elem[v->n_elem++];
+			ve->helem   = he;
+			ve->id      = id;
+			ve->type    = type;
+			ve->capture = strstr (hname + strlen (ui->sm.ctrl[id].name), "Capture") != NULL;
+			ve->count   = snd_ctl_elem_info_get_count (info);
+			break;
+		}
+	}
+
+	snd_ctl_elem_value_malloc (&v->value);
+	v->pos      = 0;
+	v->recheck  = -1;
+	v->batch    = 8;
+	v->interval = VFY_INTERVAL_MIN;
+	v->next     = monotonic_ms () + VFY_IDLE_MS;
+
+	if (verbose) {
+		printf ("Verify: %u elements\n", v->n_elem);
+	}
+}
+
+static void vfy_free (RobTkApp* ui)
+{
+	Verify* v = &ui->vfy;
+	if (v->value) {
+		snd_ctl_elem_value_free (v->value);
+	}
+	free (v->elem);
+	v->elem   = NULL;
+	v->value  = NULL;
+	v->n_elem = 0;
+}
+
+/* expected value from the mixer's state */
+static long vfy_expected (VerifyElem const* ve, snd_mixer_elem_t* elem, unsigned int i)
+{
+	snd_mixer_selem_channel_id_t cid = (snd_mixer_selem_channel_id_t)i;
+	long val = 0;
+	int sw = 0;
+	unsigned int item = 0;
+	switch (ve->type) {
+		case SND_CTL_ELEM_TYPE_INTEGER:
+			if (ve->capture) {
+				snd_mixer_selem_get_capture_volume (elem, cid, &val);
+			} else {
+				snd_mixer_selem_get_playback_volume (elem, cid, &val);
+			}
+			return val;
+		case SND_CTL_ELEM_TYPE_BOOLEAN:
+			if (ve->capture) {
+				snd_mixer_selem_get_capture_switch (elem, cid, &sw);
+			} else {
+				snd_mixer_selem_get_playback_switch (elem, cid, &sw);
+			}
+			return sw;
+		case SND_CTL_ELEM_TYPE_ENUMERATED:
+			snd_mixer_selem_get_enum_item (elem, cid, &item);
+			return item;
+		default:
+			break;
+	}
+	return 0;
+}
+
+static long vfy_value (VerifyElem const* ve, snd_ctl_elem_value_t* value, unsigned int i)
+{
+	switch (ve->type) {
+		case SND_CTL_ELEM_TYPE_INTEGER:
+			return snd_ctl_elem_value_get_integer (value, i);
+		case SND_CTL_ELEM_TYPE_BOOLEAN:
+			return snd_ctl_elem_value_get_boolean (value, i);
+		case SND_CTL_ELEM_TYPE_ENUMERATED:
+			return snd_ctl_elem_value_get_enumerated (value, i);
+		default:
+			break;
+	}
+	return 0;
+}
+
+static void vfy_set_value (VerifyElem const* ve, snd_ctl_elem_value_t* value, unsigned int i, long val)
+{
+	switch (ve->type) {
+		case SND_CTL_ELEM_TYPE_INTEGER:
+			snd_ctl_elem_value_set_integer (value, i, val);
+			break;
+		case SND_CTL_ELEM_TYPE_BOOLEAN:
+			snd_ctl_elem_value_set_boolean (value, i, val);
+			break;
+		case SND_CTL_ELEM_TYPE_ENUMERATED:
+			snd_ctl_elem_value_set_enumerated (value, i, val);
+			break;
+		default:
+			break;
+	}
+}
+
+static void vfy_run (RobTkApp* ui)
+{
+	Verify* v = &ui->vfy;
+	if (v->n_elem == 0) {
+		return;
+	}
+
+	const uint64_t now = monotonic_ms ();
+	if (now < v->next) {
+		return;
+	}
+	if (now < ui->last_write + VFY_IDLE_MS) {
+		/* user is busy, back off */
+		v->interval *= 2;
+		if (v->interval > VFY_INTERVAL_MAX) {
+			v->interval = VFY_INTERVAL_MAX;
+		}
+		v->next = now + v->interval;
+		return;
+	}
+
+	const uint64_t t0 = monotonic_ns ();
+
+	for (unsigned int k = 0; k < v->batch; ++k) {
+		unsigned int e;
+		const bool recheck = v->recheck >= 0;
+		if (recheck) {
+			e = v->recheck;
+			v->recheck = -1;
+		} else {
+			e = v->pos;
+			v->pos = (v->pos + 1) % v->n_elem;
+		}
+
+		VerifyElem const* ve = &v->elem[e];
+		Mctrl* c = &ui->sm.ctrl[ve->id];
+		if (snd_hctl_elem_read (ve->helem, v->value) < 0) {
+			continue;
+		}
+		bool drift = false;
+		for (unsigned int i = 0; i < ve->count; ++i) {
+			const long expect = vfy_expected (ve, c->elem, i);
+			if (vfy_value (ve, v->value, i) != expect) {
+				vfy_set_value (ve, v->value, i, expect);
+				drift = true;
+			}
+		}
+		if (!drift) {
+			continue;
+		}
+		if (!recheck) {
+			/* the change may be in flight, confirm after
+			 * pending events have been processed */
+			v->recheck = e;
+			break;
+		}
+		++v->drift;
+		fprintf (stderr, "Verify: '%s' drifted, re-sending (total %u)\n", snd_hctl_elem_get_name (ve->helem), v->drift);
+		snd_hctl_elem_write (ve->helem, v->value);
+	}
+
+	/* adapt batch-size to bus speed: keep a batch below 2ms */
+	const uint64_t dt = monotonic_ns () - t0;
+	if (dt > 2000000 && v->batch > 1) {
+		v->batch /= 2;
+	} else if (dt < 500000 && v->batch < VFY_BATCH_MAX) {
+		++v->batch;
+	}
+
+	v->interval /= 2;
+	if (v->interval < VFY_INTERVAL_MIN) {
+		v->interval = VFY_INTERVAL_MIN;
+	}
+	v->next = monotonic_ms () + v->interval;
+}
+
+/* *****************************************************************************
+ * Preset bank
+ *
+ * Up to BANK_SLOTS complete mixer states in a memory-mapped file of
+ * fixed layout: a header followed by slots of identical size. A slot
+ * holds control-id/type/value records of all controls that a preset
+ * covers. Recall queues only values that differ from the current state.
+ */
+
+#define BANK_MAGIC "SCMBANK1"
+#define BANK_SLOTS 128
+
+typedef struct _BankHdr {
+	char     magic[8];
+	char     device[64];
+	uint32_t ctrl_cnt;
+	uint32_t n_val;     //< records per slot
+	uint32_t slot_size; //< bytes per slot, including BankSlot
+	uint8_t  _pad[44];
+} BankHdr;
+
+typedef struct {
+	uint32_t used;
+	char     name[28];
+	/* followed by BankHdr::n_val CtrlVal records */
+} BankSlot;
+
+static BankSlot* bank_slot (Bank const* b, unsigned int n)
+{
+	assert (n < BANK_SLOTS);
+	return (BankSlot*)((uint8_t*)(b->hdr + 1) + n * b->hdr->slot_size);
+}
+
+static CtrlVal* bank_vals (BankSlot* s)
+{
+	return (CtrlVal*)(s + 1);
+}
+
+/* everything cb_btn_reset () touches, plus gains and switches.
+ * Returns the number of controls, ids and types are stored in *tgt */
+static unsigned int mixer_targets (RobTkApp* ui, CtrlVal** tgt)
+{
+	Device const* d = ui->sm.device;
+	unsigned int n = 0;
+	CtrlVal* t = (CtrlVal*)calloc (d->sin + d->smi * (1 + d->smo) + d->sout + 2 * d->smst + 2 + d->num_hiz + d->num_pad, sizeof (CtrlVal));
+
+#define BANK_TGT(CTRL, TYPE) { t[n].id = ctrl_id (ui, (CTRL)); t[n].type = (TYPE); ++n; }
+	for (unsigned int r = 0; r < d->sin; ++r) {
+		BANK_TGT (src_sel (ui, r), CV_ENUM);
+	}
+	for (unsigned int r = 0; r < d->smi; ++r) {
+		BANK_TGT (matrix_sel (ui, r), CV_ENUM);
+		for (unsigned int c = 0; c < d->smo; ++c) {
+			BANK_TGT (matrix_ctrl_cr (ui, c, r), CV_DB);
+		}
+	}
+	for (unsigned int o = 0; o < d->sout; ++o) {
+		BANK_TGT (out_sel (ui, o), CV_ENUM);
+	}
+	for (unsigned int o = 0; o < d->smst; ++o) {
+		BANK_TGT (out_gain (ui, o), CV_DB);
+		BANK_TGT (out_gain (ui, o), CV_MUTE);
+	}
+	BANK_TGT (mst_gain (ui), CV_DB);
+	BANK_TGT (mst_gain (ui), CV_MUTE);
+	for (unsigned int i = 0; i < d->num_hiz; ++i) {
+		BANK_TGT (hiz (ui, i), CV_ENUM);
+	}
+	for (unsigned int i = 0; i < d->num_pad; ++i) {
+		BANK_TGT (pad (ui, i), CV_ENUM);
+	}
+#undef BANK_TGT
+	*tgt = t;
+	return n;
+}
+
+static void bank_close (RobTkApp* ui)
+{
+	Bank* b = &ui->bank;
+	if (b->seq) {
+		snd_seq_close (b->seq);
+	}
+	if (b->hdr) {
+		munmap (b->hdr, b->len);
+	}
+	if (b->fd >= 0) {
+		close (b->fd);
+	}
+	free (b->tgt);
+	b->seq = NULL;
+	b->hdr = NULL;
+	b->tgt = NULL;
+	b->fd  = -1;
+}
+
+static int bank_open (RobTkApp* ui, const char* path)
+{
+	Bank* b = &ui->bank;
+	b->n_tgt = mixer_targets (ui, &b->tgt);
+
+	const size_t slot_size = sizeof (BankSlot) + b->n_tgt * sizeof (CtrlVal);
+	const size_t len = sizeof (BankHdr) + BANK_SLOTS * slot_size;
+
+	b->fd = open (path, O_RDWR | O_CREAT, 0644);
+	if (b->fd < 0) {
+		fprintf (stderr, "Cannot open preset bank '%s': %s\n", path, strerror (errno));
+		bank_close (ui);
+		return -1;
+	}
+
+	struct stat st;
+	if (fstat (b->fd, &st)) {
+		fprintf (stderr, "Cannot stat preset bank '%s': %s\n", path, strerror (errno));
+		bank_close (ui);
+		return -1;
+	}
+	const bool init = st.st_size == 0;
+	if (!init && (size_t)st.st_size != len) {
+		fprintf (stderr, "Preset bank '%s' does not match this device\n", path);
+		bank_close (ui);
+		return -1;
+	}
+	if (init && ftruncate (b->fd, len)) {
+		fprintf (stderr, "Cannot resize preset bank '%s': %s\n", path, strerror (errno));
+		bank_close (ui);
+		return -1;
+	}
+
+	void* m = mmap (NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, b->fd, 0);
+	if (m == MAP_FAILED) {
+		fprintf (stderr, "Cannot map preset bank '%s': %s\n", path, strerror (errno));
+		bank_close (ui);
+		return -1;
+	}
+	b->hdr = (BankHdr*)m;
+	b->len = len;
+
+	BankHdr* h = b->hdr;
+	if (init) {
+		strncpy (h->device, ui->sm.device->name, 63);
+		h->ctrl_cnt  = ui->sm.ctrl_cnt;
+		h->n_val     = b->n_tgt;
+		h->slot_size = slot_size;
+		memcpy (h->magic, BANK_MAGIC, 8);
+	} else if (memcmp (h->magic, BANK_MAGIC, 8) || strncmp (h->device, ui->sm.device->name, 64)
+	           || h->ctrl_cnt != ui->sm.ctrl_cnt || h->n_val != b->n_tgt || h->slot_size != slot_size) {
+		fprintf (stderr, "Preset bank '%s' does not match this device\n", path);
+		bank_close (ui);
+		return -1;
+	}
+	return 0;
+}
+
+/* save the current state, including pending writes, in slot n */
+static void bank_store (RobTkApp* ui, unsigned int n, const char* name)
+{
+	Bank* b = &ui->bank;
+	BankSlot* s = bank_slot (b, n);
+	CtrlVal* v = bank_vals (s);
+
+	s->used = 0;
+	__sync_synchronize ();
+	for (unsigned int i = 0; i < b->n_tgt; ++i) {
+		v[i].id   = b->tgt[i].id;
+		v[i].type = b->tgt[i].type;
+		v[i].val  = wq_get (ui, b->tgt[i].id, b->tgt[i].type);
+	}
+	snprintf (s->name, sizeof (s->name), "%s", name ? name : "");
+	__sync_synchronize ();
+	s->used = 1;
+	msync (b->hdr, b->len, MS_ASYNC);
+
+	if (verbose) {
+		printf ("Stored preset %u '%s'\n", n + 1, s->name);
+	}
+}
+
+/* queue the difference between slot n and the current state as
+ * one undo gesture, returns the number of changed values or -1 */
+static int bank_recall (RobTkApp* ui, unsigned int n)
+{
+	Bank* b = &ui->bank;
+	if (!b->hdr || n >= BANK_SLOTS) {
+		return -1;
+	}
+	BankSlot* s = bank_slot (b, n);
+	if (!s->used) {
+		fprintf (stderr, "Preset %u is empty\n", n + 1);
+		return -1;
+	}
+
+	TRACE_BEGIN ("preset_recall");
+	CtrlVal const* v = bank_vals (s);
+	int changed = 0;
+	hist_begin (ui, -1);
+	for (unsigned int i = 0; i < b->hdr->n_val; ++i) {
+		if (v[i].id >= ui->sm.ctrl_cnt || v[i].type >= CV_TYPES) {
+			continue;
+		}
+		if (wq_get (ui, v[i].id, v[i].type) == v[i].val) {
+			continue;
+		}
+		wq_push (ui, &ui->sm.ctrl[v[i].id], v[i].type, v[i].val);
+		++changed;
+	}
+	ui->hist_key = -1;
+	ui->need_refresh = true;
+	TRACE_END ("preset_recall");
+
+	if (verbose) {
+		printf ("Recall preset %u '%s': %d changes\n", n + 1, s->name, changed);
+	}
+	return changed;
+}
+
+/* ALSA sequencer port, program change n recalls slot n */
+static void bank_midi_open (RobTkApp* ui)
+{
+	Bank* b = &ui->bank;
+	if (snd_seq_open (&b->seq, "default", SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK) < 0) {
+		fprintf (stderr, "Cannot open ALSA sequencer, presets can not be recalled by program change\n");
+		b->seq = NULL;
+		return;
+	}
+	snd_seq_set_client_name (b->seq, "Scarlett Mixer");
+	if (snd_seq_create_simple_port (b->seq, "Program Change",
+				SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
+				SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION) < 0) {
+		fprintf (stderr, "Cannot create ALSA sequencer port\n");
+		snd_seq_close (b->seq);
+		b->seq = NULL;
+	}
+}
+
+/* drain pending events, only the last program change is recalled.
+ * Returns the recalled slot or -1 */
+static int bank_midi_poll (RobTkApp* ui)
+{
+	snd_seq_event_t* ev;
+	int pgm = -1;
+	if (!ui->bank.seq) {
+		return -1;
+	}
+	while (snd_seq_event_input (ui->bank.seq, &ev) >= 0) {
+		if (ev && ev->type == SND_SEQ_EVENT_PGMCHANGE) {
+			pgm = ev->data.control.value;
+		}
+	}
+	if (pgm < 0 || pgm >= BANK_SLOTS || bank_recall (ui, pgm) < 0) {
+		return -1;
+	}
+	return pgm;
+}
+
+/* *****************************************************************************
+ * Cue list
+ *
+ * Each cue recalls a preset of the bank with a crossfade. A cue is
+ * started manually ('Go' button or SIGHUP), at a time of day, or after
+ * a delay once the previous cue completed. The cues run on a separate
+ * thread that waits on timerfds and writes the crossfade steps itself,
+ * so the timing does not depend on the GUI. Planned and achieved times
+ * are printed for every cue.
+ */
+
+static volatile sig_atomic_t go_request = 0;
+
+static void sig_go (int sig)
+{
+	go_request = 1;
+}
+
+static const char* cue_name (RobTkApp* ui, Cue const* q)
+{
+	return bank_slot (&ui->bank, q->slot)->name;
+}
+
+static int cue_parse_time (const char* s, uint32_t* sec)
+{
+	unsigned int h, m, x = 0;
+	char c;
+	if (sscanf (s, "%u:%u%c", &h, &m, &c) == 2 || (sscanf (s, "%u:%u:%u%c", &h, &m, &x, &c) == 3)) {
+		if (h < 24 && m < 60 && x < 60) {
+			*sec = h * 3600 + m * 60 + x;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+static int cue_parse_msec (const char* s, uint32_t* ms)
+{
+	char* end;
+	const double v = strtod (s, &end);
+	if (end == s || *end || v < 0 || v > 86400) {
+		return -1;
+	}
+	*ms = lrint (v * 1000.);
+	return 0;
+}
+
+/* <preset> [fade <sec>] [at <hh:mm[:ss]> | wait <sec>] */
+static int cue_parse (RobTkApp* ui, Cue* q, char* line)
+{
+	char name[64] = "";
+	char* save = NULL;
+	memset (q, 0, sizeof (Cue));
+
+	for (char* tok = strtok_r (line, " \t\r\n", &save); tok; tok = strtok_r (NULL, " \t\r\n", &save)) {
+		if (!strcmp (tok, "fade") || !strcmp (tok, "at") || !strcmp (tok, "wait")) {
+			const char* arg = strtok_r (NULL, " \t\r\n", &save);
+			if (!arg) {
+				return -1;
+			}
+			if (tok[0] == 'f') {
+				if (cue_parse_msec (arg, &q->fade)) {
+					return -1;
+				}
+			} else if (q->trigger != CUE_MANUAL) {
+				return -1;
+			} else if (tok[0] == 'a') {
+				q->trigger = CUE_AT;
+				if (cue_parse_time (arg, &q->when)) {
+					return -1;
+				}
+			} else {
+				q->trigger = CUE_FOLLOW;
+				if (cue_parse_msec (arg, &q->when)) {
+					return -1;
+				}
+			}
+			continue;
+		}
+		if (strlen (name) + strlen (tok) + 2 > sizeof (name)) {
+			return -1;
+		}
+		if (name[0]) {
+			strcat (name, " ");
+		}
+		strcat (name, tok);
+	}
+
+	/* preset by number or name */
+	char* end;
+	const long n = strtol (name, &end, 10);
+	if (name[0] && !*end) {
+		if (n < 1 || n > BANK_SLOTS) {
+			return -1;
+		}
+		q->slot = n - 1;
+	} else {
+		unsigned int s;
+		for (s = 0; s < BANK_SLOTS; ++s) {
+			BankSlot const* bs = bank_slot (&ui->bank, s);
+			if (bs->used && !strncasecmp (bs->name, name, sizeof (bs->name))) {
+				break;
+			}
+		}
+		if (s == BANK_SLOTS) {
+			return -1;
+		}
+		q->slot = s;
+	}
+	if (!bank_slot (&ui->bank, q->slot)->used) {
+		return -1;
+	}
+	return 0;
+}
+
+static int cue_load (RobTkApp* ui, CueList* cl, const char* path)
+{
+	FILE* f = fopen (path, "r");
+	if (!f) {
+		fprintf (stderr, "Cannot open cue list '%s': %s\n", path, strerror (errno));
+		return -1;
+	}
+	char line[1024];
+	unsigned int ln = 0;
+	int rv = 0;
+	while (fgets (line, sizeof (line), f)) {
+		++ln;
+		char* c = strchr (line, '#');
+		if (c) {
+			*c = '\0';
+		}
+		c = line + strspn (line, " \t\r\n");
+		if (!*c) {
+			continue;
+		}
+		if (cl->n_cues == CUE_MAX) {
+			fprintf (stderr, "%s:%u: too many cues\n", path, ln);
+			rv = -1;
+			break;
+		}
+		if (cue_parse (ui, &cl->cue[cl->n_cues], c)) {
+			fprintf (stderr, "%s:%u: invalid cue or empty preset\n", path, ln);
+			rv = -1;
+			break;
+		}
+		++cl->n_cues;
+	}
+	fclose (f);
+	if (rv == 0 && cl->n_cues == 0) {
+		fprintf (stderr, "Cue list '%s' is empty\n", path);
+		rv = -1;
+	}
+	return rv;
+}
+
+static void cue_arm (int fd, uint64_t ns)
+{
+	struct itimerspec its;
+	memset (&its, 0, sizeof (its));
+	its.it_value.tv_sec  = ns / 1000000000ULL;
+	its.it_value.tv_nsec = ns % 1000000000ULL;
+	timerfd_settime (fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static uint64_t realtime_ns ()
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* wall-clock time of the next occurrence of a time of day, in ns */
+static uint64_t cue_time_of_day (uint32_t sec)
+{
+	const time_t now = time (NULL);
+	struct tm tm;
+	localtime_r (&now, &tm);
+	tm.tm_hour = sec / 3600;
+	tm.tm_min  = (sec / 60) % 60;
+	tm.tm_sec  = sec % 60;
+	tm.tm_isdst = -1;
+	time_t t = mktime (&tm);
+	if (t + CUE_LATE_MAX < now) {
+		++tm.tm_mday;
+		tm.tm_isdst = -1;
+		t = mktime (&tm);
+	}
+	return t * 1000000000ULL;
+}
+
+/* wait for the trigger, fd < 0: manual only.
+ * Returns 0 when triggered, -1 when stopped */
+static int cue_wait (CueList* cl, int fd)
+{
+	struct pollfd pfd[2];
+	uint64_t cnt;
+	pfd[0].fd     = cl->efd;
+	pfd[0].events = POLLIN;
+	pfd[1].fd     = fd;
+	pfd[1].events = POLLIN;
+	while (cl->run) {
+		if (poll (pfd, fd < 0 ? 1 : 2, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		if (pfd[0].revents & POLLIN) {
+			/* 'Go' also starts a timed cue early */
+			if (read (cl->efd, &cnt, sizeof (cnt)) != sizeof (cnt)) {
+				continue;
+			}
+			return cl->run ? 0 : -1;
+		}
+		if (fd >= 0 && (pfd[1].revents & POLLIN)) {
+			if (read (fd, &cnt, sizeof (cnt)) == sizeof (cnt)) {
+				return 0;
+			}
+		}
+	}
+	return -1;
+}
+
+/* write values at fade position p = 0..1, returns the number of writes,
+ * or -1 when the fade was aborted by panic_mute ().
+ * Mute and enum changes are written at the start, muting at the end. */
+static int cue_step (RobTkApp* ui, CueList* cl, float p)
+{
+	int n = 0;
+	pthread_mutex_lock (&ui->lock);
+	if (cl->abort) {
+		pthread_mutex_unlock (&ui->lock);
+		return -1;
+	}
+	for (unsigned int i = 0; i < cl->n_val; ++i) {
+		CtrlVal const* f = &cl->from[i];
+		CtrlVal const* t = &cl->to[i];
+		int32_t val = t->val;
+		switch (t->type) {
+			case CV_DB:
+				if (p < 1.f) {
+					/* linear in gain, -128dB is off */
+					const float gf = f->val > -12800 ? powf (10.f, .0005f * f->val) : 0.f;
+					const float gt = t->val > -12800 ? powf (10.f, .0005f * t->val) : 0.f;
+					const float g  = gf + (gt - gf) * p;
+					val = g > 4e-7f ? lrintf (2000.f * log10f (g)) : -12800;
+				}
+				break;
+			case CV_MUTE:
+				if (t->val && p < 1.f) {
+					val = f->val;
+				}
+				break;
+			default:
+				break;
+		}
+		/* a pending GUI write would undo the step when flushed */
+		const int slot = ui->wq_slot[t->id * CV_TYPES + t->type];
+		if (slot >= 0) {
+			ui->wq[slot].val = val;
+		}
+		if (ctrl_get (ui, t->id, t->type) != val) {
+			ctrl_set (ui, t->id, t->type, val);
+			++n;
+		}
+	}
+	ui->need_refresh = true;
+	pthread_mutex_unlock (&ui->lock);
+	return n;
+}
+
+static void cue_run (RobTkApp* ui, CueList* cl, Cue const* q, uint64_t planned)
+{
+	Bank* b = &ui->bank;
+	const uint64_t t0 = monotonic_ns ();
+
+	pthread_mutex_lock (&ui->lock);
+	BankSlot* s = bank_slot (b, q->slot);
+	CtrlVal const* v = bank_vals (s);
+	cl->abort = false;
+	cl->n_val = 0;
+	for (unsigned int i = 0; s->used && i < b->hdr->n_val; ++i) {
+		if (v[i].id >= ui->sm.ctrl_cnt || v[i].type >= CV_TYPES) {
+			continue;
+		}
+		cl->to[cl->n_val] = v[i];
+		cl->from[cl->n_val] = v[i];
+		cl->from[cl->n_val].val = ctrl_get (ui, v[i].id, v[i].type);
+		++cl->n_val;
+	}
+	pthread_mutex_unlock (&ui->lock);
+
+	if (cl->n_val == 0) {
+		printf ("Cue %u: preset %u is empty\n", cl->pos + 1, q->slot + 1);
+		return;
+	}
+
+	const unsigned int n_steps = (uint64_t)q->fade * CUE_FADE_HZ / 1000;
+	const uint64_t period = 1000000000ULL / CUE_FADE_HZ;
+	uint64_t jitter = 0;
+	int writes = cue_step (ui, cl, n_steps > 0 ? 0.f : 1.f);
+	bool aborted = writes < 0;
+	const uint64_t t_start = monotonic_ns ();
+
+	if (aborted) {
+		writes = 0;
+	}
+
+	for (unsigned int k = 1; k <= n_steps && cl->run && !aborted; ++k) {
+		uint64_t cnt;
+		const uint64_t when = t0 + k * period;
+		cue_arm (cl->tfd, when);
+		if (read (cl->tfd, &cnt, sizeof (cnt)) != sizeof (cnt)) {
+			continue;
+		}
+		const uint64_t now = monotonic_ns ();
+		if (now - when > jitter) {
+			jitter = now - when;
+		}
+		const int n = cue_step (ui, cl, k / (float)n_steps);
+		if (n < 0) {
+			aborted = true;
+		} else {
+			writes += n;
+		}
+	}
+
+	const uint64_t t_end = monotonic_ns ();
+	printf ("Cue %u '%.28s' (preset %u): started %+.3f ms from plan, fade %.1f ms (planned %u ms), max step jitter %.3f ms, %d writes%s\n",
+			cl->pos + 1, s->name, q->slot + 1,
+			((int64_t)t_start - (int64_t)planned) / 1e6,
+			(t_end - t_start) / 1e6, q->fade, jitter / 1e6, writes,
+			aborted ? ", aborted by panic" : "");
+	fflush (stdout);
+}
+
+static void* cue_thread (void* arg)
+{
+	RobTkApp* ui = (RobTkApp*)arg;
+	CueList* cl = ui->cues;
+
+	struct sched_param param;
+	param.sched_priority = CUE_RT_PRIO;
+	pthread_setschedparam (pthread_self (), SCHED_FIFO, &param);
+
+	uint64_t prev_end = monotonic_ns ();
+
+	while (cl->run) {
+		if (cl->pos >= cl->n_cues) {
+			/* end of list, wait until stopped */
+			cue_wait (cl, -1);
+			continue;
+		}
+		Cue const* q = &cl->cue[cl->pos];
+		uint64_t planned;
+		int rv;
+		switch (q->trigger) {
+			case CUE_AT:
+				{
+					const uint64_t rt = cue_time_of_day (q->when);
+					/* log against the monotonic clock */
+					planned = monotonic_ns () + (rt - realtime_ns ());
+					cue_arm (cl->tfd_rt, rt);
+					rv = cue_wait (cl, cl->tfd_rt);
+				}
+				break;
+			case CUE_FOLLOW:
+				planned = prev_end + q->when * 1000000ULL;
+				cue_arm (cl->tfd, planned);
+				rv = cue_wait (cl, cl->tfd);
+				break;
+			default:
+				rv = cue_wait (cl, -1);
+				planned = monotonic_ns ();
+				break;
+		}
+		if (rv) {
+			break;
+		}
+		if (q->trigger != CUE_MANUAL && monotonic_ns () < planned) {
+			/* started early by 'Go' */
+			planned = monotonic_ns ();
+		}
+		cue_run (ui, cl, q, planned);
+		prev_end = monotonic_ns ();
+		++cl->pos;
+		cl->changed = true;
+	}
+	return NULL;
+}
+
+static void cue_go (RobTkApp* ui)
+{
+	const uint64_t one = 1;
+	if (ui->cues && write (ui->cues->efd, &one, sizeof (one)) != sizeof (one)) {
+		fprintf (stderr, "Cue list: cannot trigger cue\n");
+	}
+}
+
+static void cue_free (CueList* cl)
+{
+	if (cl->tfd >= 0) close (cl->tfd);
+	if (cl->tfd_rt >= 0) close (cl->tfd_rt);
+	if (cl->efd >= 0) close (cl->efd);
+	free (cl->from);
+	free (cl->to);
+	free (cl);
+}
+
+static int cue_start (RobTkApp* ui, const char* path)
+{
+	CueList* cl = (CueList*)calloc (1, sizeof (CueList));
+	cl->tfd    = timerfd_create (CLOCK_MONOTONIC, TFD_CLOEXEC);
+	cl->tfd_rt = timerfd_create (CLOCK_REALTIME, TFD_CLOEXEC);
+	cl->efd    = eventfd (0, EFD_CLOEXEC);
+
+	if (cl->tfd < 0 || cl->tfd_rt < 0 || cl->efd < 0) {
+		fprintf (stderr, "Cue list: cannot create timers: %s\n", strerror (errno));
+		cue_free (cl);
+		return -1;
+	}
+	if (cue_load (ui, cl, path)) {
+		cue_free (cl);
+		return -1;
+	}
+	cl->from = (CtrlVal*)malloc (ui->bank.hdr->n_val * sizeof (CtrlVal));
+	cl->to   = (CtrlVal*)malloc (ui->bank.hdr->n_val * sizeof (CtrlVal));
+
+	ui->cues = cl;
+	cl->run = true;
+	cl->changed = true;
+	if (pthread_create (&cl->thread, NULL, cue_thread, ui)) {
+		fprintf (stderr, "Cue list: cannot start thread\n");
+		ui->cues = NULL;
+		cue_free (cl);
+		return -1;
+	}
+	if (verbose) {
+		printf ("Cue list: %u cues\n", cl->n_cues);
+	}
+	return 0;
+}
+
+static void cue_stop (RobTkApp* ui)
+{
+	CueList* cl = ui->cues;
+	if (!cl) {
+		return;
+	}
+	/* a running fade is stopped after the current step */
+	cl->run = false;
+	cue_go (ui);
+	pthread_join (cl->thread, NULL);
+	cue_free (cl);
+	ui->cues = NULL;
+}
+
+/* GUI, label for the next cue */
+static void cue_next_label (RobTkApp* ui, size_t len, char* txt)
+{
+	CueList const* cl = ui->cues;
+	const unsigned int pos = cl->pos;
+	if (pos >= cl->n_cues) {
+		snprintf (txt, len, "End of cues");
+		return;
+	}
+	Cue const* q = &cl->cue[pos];
+	switch (q->trigger) {
+		case CUE_AT:
+			snprintf (txt, len, "Next %u: %.27s at %02u:%02u:%02u", pos + 1, cue_name (ui, q),
+					q->when / 3600, (q->when / 60) % 60, q->when % 60);
+			break;
+		case CUE_FOLLOW:
+			snprintf (txt, len, "Next %u: %.27s after %.1fs", pos + 1, cue_name (ui, q), q->when / 1000.f);
+			break;
+		default:
+			snprintf (txt, len, "Next %u: %.27s", pos + 1, cue_name (ui, q));
+			break;
+	}
+}
+
+/* *****************************************************************************
+ * Persisted state
+ *
+ * The last known value of all preset targets is saved once the mixer has
+ * been quiet for STATE_QUIET_MS, at the latest STATE_MAX_MS after the
+ * first change. The file is written to a temporary name, synced and
+ * renamed, so that a crash or power loss leaves either the old or the
+ * new state. At startup, and when the device re-appears after it was
+ * disconnected or power cycled, only values that differ are sent.
+ */
+
+#define STATE_MAGIC    "SCMSTAT1"
+#define STATE_QUIET_MS 1000
+#define STATE_MAX_MS   10000
+#define STATE_RETRY_MS 1000 //< reconnect interval
+
+typedef struct {
+	char     magic[8];
+	char     device[64];
+	uint32_t ctrl_cnt;
+	uint32_t n_val;
+	/* followed by n_val CtrlVal records */
+} StateHdr;
+
+static bool persist_write_all (int fd, const void* buf, size_t len)
+{
+	const uint8_t* p = (const uint8_t*)buf;
+	while (len > 0) {
+		ssize_t n = write (fd, p, len);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		p   += n;
+		len -= n;
+	}
+	return true;
+}
+
+static int persist_write (RobTkApp* ui, CtrlVal const* v)
+{
+	Persist* p = &ui->persist;
+	char tmp[1024];
+	snprintf (tmp, sizeof (tmp), "%s.tmp", p->path);
+
+	StateHdr h;
+	memset (&h, 0, sizeof (StateHdr));
+	memcpy (h.magic, STATE_MAGIC, 8);
+	strncpy (h.device, ui->sm.device->name, 63);
+	h.ctrl_cnt = ui->sm.ctrl_cnt;
+	h.n_val    = p->n_val;
+
+	int fd = open (tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	bool ok = fd >= 0
+		&& persist_write_all (fd, &h, sizeof (StateHdr))
+		&& persist_write_all (fd, v, p->n_val * sizeof (CtrlVal))
+		&& fsync (fd) == 0;
+	if (fd >= 0 && close (fd)) {
+		ok = false;
+	}
+	if (!ok || rename (tmp, p->path)) {
+		if (!p->failed) {
+			fprintf (stderr, "Cannot save state '%s': %s\n", p->path, strerror (errno));
+		}
+		p->failed = true;
+		unlink (tmp);
+		return -1;
+	}
+	p->failed = false;
+
+	/* make the rename itself durable */
+	snprintf (tmp, sizeof (tmp), "%s", p->path);
+	int dfd = open (dirname (tmp), O_RDONLY);
+	if (dfd >= 0) {
+		fsync (dfd);
+		close (dfd);
+	}
+	return 0;
+}
+
+static int persist_load (RobTkApp* ui)
+{
+	Persist* p = &ui->persist;
+	int fd = open (p->path, O_RDONLY);
+	if (fd < 0) {
+		if (errno != ENOENT) {
+			fprintf (stderr, "Cannot open state '%s': %s\n", p->path, strerror (errno));
+		}
+		return -1;
+	}
+
+	StateHdr h;
+	CtrlVal* v = (CtrlVal*)malloc (p->n_val * sizeof (CtrlVal));
+	const size_t len = p->n_val * sizeof (CtrlVal);
+	bool ok = read (fd, &h, sizeof (StateHdr)) == sizeof (StateHdr)
+		&& !memcmp (h.magic, STATE_MAGIC, 8)
+		&& !strncmp (h.device, ui->sm.device->name, 64)
+		&& h.ctrl_cnt == ui->sm.ctrl_cnt && h.n_val == p->n_val
+		&& read (fd, v, len) == (ssize_t)len;
+	close (fd);
+
+	for (unsigned int i = 0; ok && i < p->n_val; ++i) {
+		ok = v[i].id == p->val[i].id && v[i].type == p->val[i].type;
+	}
+	if (ok) {
+		memcpy (p->val, v, len);
+	} else {
+		fprintf (stderr, "State '%s' does not match this device, ignored\n", p->path);
+	}
+	free (v);
+	return ok ? 0 : -1;
+}
+
+static void persist_snapshot (RobTkApp* ui, CtrlVal* v)
+{
+	Persist const* p = &ui->persist;
+	for (unsigned int i = 0; i < p->n_val; ++i) {
+		v[i].id   = p->val[i].id;
+		v[i].type = p->val[i].type;
+		v[i].val  = ctrl_get (ui, v[i].id, v[i].type);
+	}
+}
+
+/* queue values that differ from the saved state, as ALSA reports them.
+ * Controls with pending writes are left alone. Returns the count. */
+static int persist_restore (RobTkApp* ui)
+{
+	Persist const* p = &ui->persist;
+	int changed = 0;
+	++ui->hist_suspend;
+	for (unsigned int i = 0; i < p->n_val; ++i) {
+		CtrlVal const* v = &p->val[i];
+		if (ui->wq_slot[v->id * CV_TYPES + v->type] >= 0) {
+			continue;
+		}
+		if (ctrl_get (ui, v->id, v->type) == v->val) {
+			continue;
+		}
+		wq_push (ui, &ui->sm.ctrl[v->id], v->type, v->val);
+		++changed;
+	}
+	--ui->hist_suspend;
+	ui->need_refresh = true;
+	return changed;
+}
+
+static int persist_open (RobTkApp* ui, const char* path)
+{
+	Persist* p = &ui->persist;
+	p->path = strdup (path);
+	p->n_val = mixer_targets (ui, &p->val);
+
+	if (persist_load (ui) == 0) {
+		const int n = persist_restore (ui);
+		if (verbose) {
+			printf ("Restored state from '%s': %d changes\n", path, n);
+		}
+		return 0;
+	}
+
+	/* new file, save the current state */
+	persist_snapshot (ui, p->val);
+	return persist_write (ui, p->val);
+}
+
+/* controls have changed, see persist_poll () */
+static void persist_touch (RobTkApp* ui)
+{
+	Persist* p = &ui->persist;
+	if (!p->path) {
+		return;
+	}
+	p->last = monotonic_ms ();
+	if (p->first == 0) {
+		p->first = p->last;
+	}
+}
+
+/* msec until persist_poll () has something to do, or -1 */
+static int persist_timeout (RobTkApp* ui)
+{
+	Persist const* p = &ui->persist;
+	if (!p->path || p->first == 0 || p->lost) {
+		return -1;
+	}
+	const uint64_t now = monotonic_ms ();
+	uint64_t due = p->last + STATE_QUIET_MS;
+	if (due > p->first + STATE_MAX_MS) {
+		due = p->first + STATE_MAX_MS;
+	}
+	return due > now ? due - now : 0;
+}
+
+/* write the current state, if it differs from the saved one */
+static void persist_save (RobTkApp* ui)
+{
+	Persist* p = &ui->persist;
+	p->first = 0;
+
+	/* calloc: padding of CtrlVal is compared as well */
+	CtrlVal* v = (CtrlVal*)calloc (p->n_val, sizeof (CtrlVal));
+	pthread_mutex_lock (&ui->lock);
+	persist_snapshot (ui, v);
+	pthread_mutex_unlock (&ui->lock);
+	if (memcmp (v, p->val, p->n_val * sizeof (CtrlVal))) {
+		TRACE_BEGIN ("persist");
+		if (persist_write (ui, v) == 0) {
+			memcpy (p->val, v, p->n_val * sizeof (CtrlVal));
+		}
+		TRACE_END ("persist");
+	}
+	free (v);
+}
+
+static void persist_poll (RobTkApp* ui)
+{
+	if (persist_timeout (ui) == 0) {
+		persist_save (ui);
+	}
+}
+
+/* the device is gone. Controls keep their cached values, writes fail
+ * until it re-appears, see persist_reconnect () */
+static void persist_lost (RobTkApp* ui)
+{
+	Persist* p = &ui->persist;
+	if (p->lost) {
+		return;
+	}
+	fprintf (stderr, "Lost connection to %s, waiting for it to re-appear\n", ui->sm.card);
+	p->lost  = true;
+	p->retry = monotonic_ms () + STATE_RETRY_MS;
+}
+
+/* returns true once the device is connected again */
+static bool persist_reconnect (RobTkApp* ui)
+{
+	Persist* p = &ui->persist;
+	const uint64_t now = monotonic_ms ();
+	if (!p->lost) {
+		return true;
+	}
+	if (now < p->retry) {
+		return false;
+	}
+	p->retry = now + STATE_RETRY_MS;
+
+	/* the card may have a different index after it re-appeared */
+	char* card = scarlett_find_card (ui->sm.device->name, ui->sm.card);
+	if (!card) {
+		return false;
+	}
+	pthread_mutex_lock (&ui->lock);
+	const bool ok = scarlett_reopen (&ui->sm, card) == 0;
+	pthread_mutex_unlock (&ui->lock);
+	if (ok) {
+		p->lost  = false;
+		p->first = 0;
+		if (ui->vfy.elem) {
+			/* the hctl elements went with the old mixer handle */
+			vfy_free (ui);
+			vfy_init (ui);
+		}
+		const int n = persist_restore (ui);
+		fprintf (stderr, "Reconnected to %s, %d values differ from the saved state\n", card, n);
+	}
+	free (card);
+	return ok;
+}
+
+static void persist_close (RobTkApp* ui)
+{
+	Persist* p = &ui->persist;
+	if (!p->path) {
+		return;
+	}
+	if (p->first != 0 && !p->lost) {
+		persist_save (ui);
+	}
+	free (p->path);
+	free (p->val);
+	p->path = NULL;
+	p->val  = NULL;
+}
+
+/* *****************************************************************************
+ * Daemon
+ *
+ * Headless mode, the mixer state is published in POSIX shared memory
+ * (see scarlett_shm.h), guarded by a sequence-lock. The segment is
+ * updated once per batch of ALSA events. Unlike scarlett-mixerd this
+ * also handles the state file, journal, presets and cues.
+ */
+
+static volatile sig_atomic_t daemon_quit = 0;
+
+static void sig_daemon_quit (int sig)
+{
+	daemon_quit = 1;
+}
+
+static void shm_publish (RobTkApp* ui, ScarlettShm* shm)
+{
+	pthread_mutex_lock (&ui->lock);
+	scarlett_shm_publish (&ui->sm, shm);
+	pthread_mutex_unlock (&ui->lock);
+	if (verbose > 1) {
+		printf ("Published state #%" PRIu64 " for %s\n", shm->serial, ui->sm.device->name);
+	}
+}
+
+static int daemon_run (RobTkApp* ui, const char* name)
+{
+	Device const* d = ui->sm.device;
+	int rv = 0;
+
+	wq_flush (ui); /* e.g. the restored state */
+	pthread_mutex_lock (&ui->lock);
+	ScarlettShm* shm = scarlett_shm_create (&ui->sm, name);
+	pthread_mutex_unlock (&ui->lock);
+	if (!shm) {
+		return -1;
+	}
+
+	signal (SIGINT, sig_daemon_quit);
+	signal (SIGTERM, sig_daemon_quit);
+	signal (SIGHUP, sig_go);
+
+	if (verbose) {
+		printf ("Publishing state of %s (%s) in '%s'\n", d->name, ui->sm.card, name);
+	}
+
+	while (!daemon_quit) {
+		jrn_reserve (ui);
+		if (go_request) {
+			go_request = 0;
+			cue_go (ui);
+		}
+		if (ui->persist.lost) {
+			if (persist_reconnect (ui)) {
+				wq_flush (ui);
+				shm_publish (ui, shm);
+			} else {
+				poll (NULL, 0, STATE_RETRY_MS);
+			}
+			continue;
+		}
+		int n = snd_mixer_poll_descriptors_count (ui->sm.mixer);
+		int n_seq = ui->bank.seq ? snd_seq_poll_descriptors_count (ui->bank.seq, POLLIN) : 0;
+		unsigned short revents;
+
+		if (n + n_seq != ui->nfds) {
+			free (ui->pollfds);
+			ui->nfds = n + n_seq;
+			ui->pollfds = (struct pollfd*)calloc (n + n_seq, sizeof (struct pollfd));
+		}
+		if (snd_mixer_poll_descriptors (ui->sm.mixer, ui->pollfds, n) < 0) {
+			rv = -1;
+			break;
+		}
+		if (n_seq > 0) {
+			snd_seq_poll_descriptors (ui->bank.seq, &ui->pollfds[n], n_seq, POLLIN);
+		}
+		if (poll (ui->pollfds, n + n_seq, persist_timeout (ui)) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			rv = -1;
+			break;
+		}
+		persist_poll (ui);
+		for (int i = n; i < n + n_seq; ++i) {
+			if (ui->pollfds[i].revents & POLLIN) {
+				/* the device reports the changes, published below */
+				bank_midi_poll (ui);
+				wq_flush (ui);
+				break;
+			}
+		}
+		if (snd_mixer_poll_descriptors_revents (ui->sm.mixer, ui->pollfds, n, &revents) < 0 || (revents & (POLLERR | POLLNVAL))) {
+			if (ui->persist.path) {
+				persist_lost (ui);
+				continue;
+			}
+			fprintf (stderr, "Poll error\n");
+			rv = -1;
+			break;
+		}
+		if (!(revents & POLLIN)) {
+			continue;
+		}
+		pthread_mutex_lock (&ui->lock);
+		snd_mixer_handle_events (ui->sm.mixer);
+
+		bool changed = false;
+		for (unsigned int i = 0; i < ui->sm.ctrl_cnt; ++i) {
+			if (ui->sm.ctrl[i].changed) {
+				ui->sm.ctrl[i].changed = false;
+				jrn_external (ui, i);
+				changed = true;
+			}
+		}
+		pthread_mutex_unlock (&ui->lock);
+		if (changed) {
+			persist_touch (ui);
+			shm_publish (ui, shm);
+		}
+	}
+
+	scarlett_shm_destroy (shm, name);
+	return rv;
+}
+
+/* *****************************************************************************
+ * Helpers
+ */
+
+static float db_to_knob (float db)
+{
+	float k = (db + 128.f) / 228.75f;
+	float s = k * sqrt (0.5) / (1 - k);
+	return s * s;
+}
+
+static float clamp_db (float db)
+{
+	if (db < -128.f) return -128.f;
+	if (db > 6.f) return 6.f;
+	return db;
+}
+
+static float knob_to_db (float v)
+{
+	// v = 0..1
+	float db = sqrtf (v) / (sqrtf (0.5) + sqrtf (v)) * 228.75f - 128.f;
+	if (db > 6.f) return 6.f;
+	return rint (db);
+}
+
+/* *****************************************************************************
+ * Link groups
+ *
+ * A change to one member of a group is applied to all members,
+ * either with the same value (absolute) or by the same amount (relative).
+ * All writes of a gesture end up in the same write-queue batch.
+ */
+
+static Gang const* gang_find (RobTkApp* ui, int kind, unsigned int n)
+{
+	for (unsigned int i = 0; i < ui->n_gangs; ++i) {
+		if (ui->gang[i].kind == kind && (ui->gang[i].members & (1ULL << n))) {
+			return &ui->gang[i];
+		}
+	}
+	return NULL;
+}
+
+static float gang_target (bool relative, float val, float delta, float cur)
+{
+	return clamp_db (relative ? cur + delta : val);
+}
+
+static void gang_mtx_gain (RobTkApp* ui, unsigned int n, float val, float delta)
+{
+	const unsigned int smo = ui->sm.device->smo;
+	const unsigned int c = n % smo;
+	const unsigned int r = n / smo;
+
+	Gang const* gm = gang_find (ui, GANG_MIX, c);
+	Gang const* gi = gang_find (ui, GANG_IN, r);
+	if (!gm && !gi) {
+		return;
+	}
+
+	const uint64_t cols = gm ? gm->members : (1ULL << c);
+	const uint64_t rows = gi ? gi->members : (1ULL << r);
+	const bool relative = (gm && gm->relative) || (gi && gi->relative);
+	const bool ds = ui->disable_signals;
+
+	ui->disable_signals = true;
+	for (unsigned int rr = 0; rr < ui->sm.device->smi; ++rr) {
+		if (!(rows & (1ULL << rr))) {
+			continue;
+		}
+		for (unsigned int cc = 0; cc < smo; ++cc) {
+			if (!(cols & (1ULL << cc)) || (rr == r && cc == c)) {
+				continue;
+			}
+			unsigned int nn = rr * smo + cc;
+			Mctrl* ctrl = matrix_ctrl_n (ui, nn);
+			float db = gang_target (relative, val, delta, wq_get (ui, ctrl_id (ui, ctrl), CV_DB) / 100.f);
+			robtk_dial_set_value (ui->mtx_gain[nn], db_to_knob (db));
+			wq_push_dB (ui, ctrl, db);
+		}
+	}
+	ui->disable_signals = ds;
+}
+
+static void gang_out_gain (RobTkApp* ui, unsigned int n, bool mute, float val, float delta)
+{
+	Gang const* g = gang_find (ui, GANG_OUT, n);
+	if (!g) {
+		return;
+	}
+	const bool ds = ui->disable_signals;
+
+	ui->disable_signals = true;
+	for (unsigned int o = 0; o < ui->sm.device->smst; ++o) {
+		if (!(g->members & (1ULL << o)) || o == n) {
+			continue;
+		}
+		Mctrl* ctrl = out_gain (ui, o);
+		float db = gang_target (g->relative, val, delta, wq_get (ui, ctrl_id (ui, ctrl), CV_DB) / 100.f);
+		robtk_dial_set_value (ui->out_gain[o], db_to_knob (db));
+		robtk_dial_set_state (ui->out_gain[o], mute ? 1 : 0);
+		wq_push (ui, ctrl, CV_MUTE, mute ? 1 : 0);
+		wq_push_dB (ui, ctrl, db);
+	}
+	ui->disable_signals = ds;
+}
+
+/* parse "mix:A,B", "in:1-4", "out:2,3" with optional ":rel" suffix */
+static int gang_parse (RobTkApp* ui, const char* spec)
+{
+	Gang g;
+	const char* p;
+	memset (&g, 0, sizeof (Gang));
+
+	if (ui->n_gangs >= MAX_GANGS) {
+		fprintf (stderr, "Too many link groups\n");
+		return -1;
+	}
+
+	if (!strncmp (spec, "mix:", 4)) {
+		g.kind = GANG_MIX;
+		p = spec + 4;
+	} else if (!strncmp (spec, "in:", 3)) {
+		g.kind = GANG_IN;
+		p = spec + 3;
+	} else if (!strncmp (spec, "out:", 4)) {
+		g.kind = GANG_OUT;
+		p = spec + 4;
+	} else {
+		fprintf (stderr, "Invalid link group '%s'\n", spec);
+		return -1;
+	}
+
+	while (*p && *p != ':') {
+		long first, last;
+		if (g.kind == GANG_MIX) {
+			if (*p < 'A' || *p > 'Z') { break; }
+			first = last = *p++ - 'A';
+			if (*p == '-' && p[1] >= 'A' && p[1] <= 'Z') {
+				last = p[1] - 'A';
+				p += 2;
+			}
+		} else {
+			char* e;
+			first = last = strtol (p, &e, 10) - 1;
+			if (e == p) { break; }
+			p = e;
+			if (*p == '-') {
+				last = strtol (p + 1, &e, 10) - 1;
+				if (e == p + 1) { break; }
+				p = e;
+			}
+		}
+		if (first < 0 || last < first || last > 63) {
+			break;
+		}
+		for (long i = first; i <= last; ++i) {
+			g.members |= 1ULL << i;
+		}
+		if (*p == ',') {
+			++p;
+		}
+	}
+
+	if (*p == ':' && !strcmp (p, ":rel")) {
+		g.relative = true;
+	} else if (*p) {
+		fprintf (stderr, "Invalid link group '%s'\n", spec);
+		return -1;
+	}
+
+	memcpy (&ui->gang[ui->n_gangs++], &g, sizeof (Gang));
+	return 0;
+}
+
+/* drop members that do not exist on the given device */
+static void gang_validate (RobTkApp* ui)
+{
+	for (unsigned int i = 0; i < ui->n_gangs; ++i) {
+		Gang* g = &ui->gang[i];
+		unsigned int n = 0;
+		switch (g->kind) {
+			case GANG_MIX: n = ui->sm.device->smo; break;
+			case GANG_IN:  n = ui->sm.device->smi; break;
+			case GANG_OUT: n = ui->sm.device->smst; break;
+		}
+		uint64_t valid = n < 64 ? (1ULL << n) - 1 : ~0ULL;
+		if (g->members & ~valid) {
+			fprintf (stderr, "Link group %d: ignoring channels not present on this device\n", i + 1);
+			g->members &= valid;
+		}
+	}
+}
+
+/* *****************************************************************************
+ * Bulk matrix operations
+ *
+ * Target values for the whole matrix are computed first, then applied
+ * as a single batch: only cells that differ are queued and the GUI is
+ * refreshed once after the batch has been written.
+ */
+
+typedef struct {
+	float* gain; //< [smi * smo] target dB
+	int*   sel;  //< [smi] target matrix input enum
+} MtxState;
+
+static void mtx_state_init (RobTkApp* ui, MtxState* ms)
+{
+	const unsigned int smi = ui->sm.device->smi;
+	const unsigned int smo = ui->sm.device->smo;
+	ms->gain = (float*)malloc (smi * smo * sizeof (float));
+	ms->sel  = (int*)malloc (smi * sizeof (int));
+	for (unsigned int r = 0; r < smi; ++r) {
+		ms->sel[r] = wq_get (ui, ctrl_id (ui, matrix_sel (ui, r)), CV_ENUM);
+		for (unsigned int c = 0; c < smo; ++c) {
+			ms->gain[r * smo + c] = wq_get (ui, ctrl_id (ui, matrix_ctrl_cr (ui, c, r)), CV_DB) / 100.f;
+		}
+	}
+}
+
+static void mtx_state_free (MtxState* ms)
+{
+	free (ms->gain);
+	free (ms->sel);
+}
+
+/* queue all differences, refresh GUI once.
+ * Returns the number of queued writes */
+static int mtx_state_apply (RobTkApp* ui, MtxState const* ms)
+{
+	const unsigned int smi = ui->sm.device->smi;
+	const unsigned int smo = ui->sm.device->smo;
+	int n = 0;
+	for (unsigned int r = 0; r < smi; ++r) {
+		Mctrl* sctrl = matrix_sel (ui, r);
+		if (wq_get (ui, ctrl_id (ui, sctrl), CV_ENUM) != ms->sel[r]) {
+			wq_push (ui, sctrl, CV_ENUM, ms->sel[r]);
+			++n;
+		}
+		for (unsigned int c = 0; c < smo; ++c) {
+			Mctrl* ctrl = matrix_ctrl_cr (ui, c, r);
+			const int32_t val = lrintf (100.f * ms->gain[r * smo + c]);
+			if (wq_get (ui, ctrl_id (ui, ctrl), CV_DB) != val) {
+				wq_push (ui, ctrl, CV_DB, val);
+				++n;
+			}
+		}
+	}
+	ui->need_refresh = true;
+	return n;
+}
+
+static int mtx_op (RobTkApp* ui, MtxOp const* op)
+{
+	const unsigned int smi = ui->sm.device->smi;
+	const unsigned int smo = ui->sm.device->smo;
+
+	switch (op->op) {
+		case MTX_COPY:
+			if (op->b < 0 || op->b >= smo) {
+				return -1;
+			}
+			/* no break */
+		case MTX_TRIM:
+			if (op->a < 0 || op->a >= smo) {
+				return -1;
+			}
+			break;
+		case MTX_SWAP:
+			if (op->a < 0 || op->a >= smi || op->b < 0 || op->b >= smi) {
+				return -1;
+			}
+			break;
+		default:
+			break;
+	}
+
+	MtxState ms;
+	mtx_state_init (ui, &ms);
+
+	for (unsigned int r = 0; r < smi; ++r) {
+		float* g = &ms.gain[r * smo];
+		switch (op->op) {
+			case MTX_CLEAR:
+				for (unsigned int c = 0; c < smo; ++c) {
+					g[c] = -128.f;
+				}
+				break;
+			case MTX_IDENTITY:
+				for (unsigned int c = 0; c < smo; ++c) {
+					g[c] = (r == c) ? 0.f : -128.f;
+				}
+				break;
+			case MTX_COPY:
+				g[op->b] = g[op->a];
+				break;
+			case MTX_TRIM:
+				if (g[op->a] > -128.f) {
+					g[op->a] = clamp_db (g[op->a] + op->dB);
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	if (op->op == MTX_SWAP) {
+		float* ga = &ms.gain[op->a * smo];
+		float* gb = &ms.gain[op->b * smo];
+		for (unsigned int c = 0; c < smo; ++c) {
+			float tmp = ga[c];
+			ga[c] = gb[c];
+			gb[c] = tmp;
+		}
+		int tmp = ms.sel[op->a];
+		ms.sel[op->a] = ms.sel[op->b];
+		ms.sel[op->b] = tmp;
+	}
+
+	/* one undo step */
+	hist_begin (ui, -1);
+	mtx_state_apply (ui, &ms);
+	ui->hist_key = -1;
+	mtx_state_free (&ms);
+	return 0;
+}
+
+/* "clear", "identity", "copy:A:C", "trim:B:-3", "swap:1:2" */
+static int mtx_op_parse (MtxOp* op, const char* spec)
+{
+	char a, b;
+	memset (op, 0, sizeof (MtxOp));
+	if (!strcmp (spec, "clear")) {
+		op->op = MTX_CLEAR;
+	} else if (!strcmp (spec, "identity")) {
+		op->op = MTX_IDENTITY;
+	} else if (2 == sscanf (spec, "copy:%c:%c", &a, &b)) {
+		op->op = MTX_COPY;
+		op->a  = a - 'A';
+		op->b  = b - 'A';
+	} else if (2 == sscanf (spec, "trim:%c:%f", &a, &op->dB)) {
+		op->op = MTX_TRIM;
+		op->a  = a - 'A';
+	} else if (2 == sscanf (spec, "swap:%d:%d", &op->a, &op->b)) {
+		op->op = MTX_SWAP;
+		op->a -= 1;
+		op->b -= 1;
+	} else {
+		fprintf (stderr, "Invalid matrix operation '%s'\n", spec);
+		return -1;
+	}
+	return 0;
+}
+
+/* *****************************************************************************
+ * Routing compiler
+ *
+ * A routing description assigns sources to outputs, one route per line:
+ *
+ *   [<name>:] <output> = <source> [<gain>dB] [L|R], ...
+ *   vocalist: Headphone 1 = Analog 1-4 -6dB, PCM 3 0dB
+ *
+ * Outputs are given by their label, sources by the name of a matrix input
+ * item, optionally as a range. Every route gets a mix-bus per side, or a
+ * single one if all its sources are centered, preferring busses the output
+ * already listens to. Every source gets a matrix input, preferring inputs
+ * that already select it, then inputs that feed no other mix-bus.
+ * The result is diffed against the current state: only the differences
+ * are written, as one batch.
+ */
+
+#define ROUTE_MAX     16
+#define ROUTE_MAX_SRC 32
+
+typedef struct {
+	int     item; //< matrix input enum item
+	float   dB;
+	uint8_t side; //< 1: left, 2: right, 3: both
+} RouteSrc;
+
+typedef struct {
+	char         name[32];
+	unsigned int out;    //< output pair
+	RouteSrc     src[ROUTE_MAX_SRC];
+	unsigned int n_src;
+	unsigned int n_bus;  //< 1: mono, 2: stereo
+	int          bus[2]; //< mix-bus per side
+} Route;
+
+static int enum_item_find (Mctrl* c, const char* name)
+{
+	char buf[64];
+	const int n = get_enum_items (c);
+	for (int i = 0; i < n; ++i) {
+		if (!get_enum_item_name (c, i, sizeof (buf), buf) && !strcasecmp (buf, name)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static char* route_trim (char* s)
+{
+	while (isspace (*s)) {
+		++s;
+	}
+	char* e = s + strlen (s);
+	while (e > s && isspace (e[-1])) {
+		*--e = '\0';
+	}
+	return s;
+}
+
+/* "Analog 1-4 -6dB L" */
+static int route_parse_src (RobTkApp* ui, Route* rt, char* spec)
+{
+	char*   s    = route_trim (spec);
+	float   dB   = 0.f;
+	uint8_t side = 3;
+	char*   w;
+
+	/* trailing side and gain */
+	while ((w = strrchr (s, ' '))) {
+		const char* t = w + 1;
+		char*       e;
+		if (!strcasecmp (t, "L") || !strcasecmp (t, "R")) {
+			side = toupper (*t) == 'L' ? 1 : 2;
+		} else {
+			const float v = strtof (t, &e);
+			if (e == t || strcasecmp (e, "dB")) {
+				break;
+			}
+			dB = clamp_db (v);
+		}
+		*w = '\0';
+		s = route_trim (s);
+	}
+
+	/* "<name> <n>" or "<name> <first>-<last>" */
+	int first = 0, last = -1, len = 0;
+	w = strrchr (s, ' ');
+	if (w && sscanf (w + 1, "%d-%d%n", &first, &last, &len) == 2 && w[1 + len] == '\0') {
+		*w = '\0';
+	} else {
+		first = last = -1;
+	}
+
+	for (int i = first; i <= last; ++i) {
+		char name[64];
+		if (i < 0) {
+			snprintf (name, sizeof (name), "%s", s);
+		} else {
+			snprintf (name, sizeof (name), "%s %d", s, i);
+		}
+		const int item = enum_item_find (matrix_sel (ui, 0), name);
+		if (item < 0) {
+			fprintf (stderr, "Route '%s': unknown source '%s'\n", rt->name, name);
+			return -1;
+		}
+		if (rt->n_src >= ROUTE_MAX_SRC) {
+			fprintf (stderr, "Route '%s': too many sources\n", rt->name);
+			return -1;
+		}
+		RouteSrc* src = &rt->src[rt->n_src++];
+		src->item = item;
+		src->dB   = dB;
+		src->side = side;
+		if (side != 3) {
+			rt->n_bus = 2;
+		}
+	}
+	return 0;
+}
+
+static int route_parse (RobTkApp* ui, Route* rt, char* line)
+{
+	memset (rt, 0, sizeof (Route));
+	rt->n_bus = 1;
+
+	char* eq = strchr (line, '=');
+	if (!eq) {
+		fprintf (stderr, "Invalid route '%s'\n", route_trim (line));
+		return -1;
+	}
+	*eq = '\0';
+
+	char* out = line;
+	char* colon = strchr (line, ':');
+	if (colon) {
+		*colon = '\0';
+		snprintf (rt->name, sizeof (rt->name), "%s", route_trim (line));
+		out = colon + 1;
+	}
+	out = route_trim (out);
+	if (!colon) {
+		snprintf (rt->name, sizeof (rt->name), "%s", out);
+	}
+
+	unsigned int o;
+	for (o = 0; o < ui->sm.device->smst; ++o) {
+		if (!strcasecmp (out_gain_label (ui, o), out)) {
+			break;
+		}
+	}
+	if (o == ui->sm.device->smst || 2 * o + 1 >= ui->sm.device->sout) {
+		fprintf (stderr, "Route '%s': unknown output '%s'\n", rt->name, out);
+		return -1;
+	}
+	rt->out = o;
+
+	for (char* s = strtok (eq + 1, ","); s; s = strtok (NULL, ",")) {
+		if (route_parse_src (ui, rt, s)) {
+			return -1;
+		}
+	}
+	if (rt->n_src == 0) {
+		fprintf (stderr, "Route '%s': no sources\n", rt->name);
+		return -1;
+	}
+	return 0;
+}
+
+static int route_load (RobTkApp* ui, const char* path, Route* rt, unsigned int* n_rt)
+{
+	FILE* f = fopen (path, "r");
+	if (!f) {
+		fprintf (stderr, "Cannot open routing '%s': %s\n", path, strerror (errno));
+		return -1;
+	}
+
+	char line[1024];
+	int  rv = 0;
+	*n_rt = 0;
+	while (rv == 0 && fgets (line, sizeof (line), f)) {
+		char* c = strchr (line, '#');
+		if (c) {
+			*c = '\0';
+		}
+		if (*route_trim (line) == '\0') {
+			continue;
+		}
+		if (*n_rt >= ROUTE_MAX) {
+			fprintf (stderr, "Routing '%s': too many routes\n", path);
+			rv = -1;
+			break;
+		}
+		rv = route_parse (ui, &rt[*n_rt], line);
+		for (unsigned int i = 0; rv == 0 && i < *n_rt; ++i) {
+			if (rt[i].out == rt[*n_rt].out) {
+				fprintf (stderr, "Route '%s': output is already used by '%s'\n", rt[*n_rt].name, rt[i].name);
+				rv = -1;
+			}
+		}
+		++*n_rt;
+	}
+	fclose (f);
+	return rv;
+}
+
+static int route_bus_of (int item, int const* bus_item, unsigned int smo)
+{
+	for (unsigned int b = 0; b < smo; ++b) {
+		if (bus_item[b] == item) {
+			return b;
+		}
+	}
+	return -1;
+}
+
+/* compute target matrix and output assigns, out_tgt[sout] is -1
+ * for outputs that are not routed */
+static int route_compile (RobTkApp* ui, Route* rt, unsigned int n_rt, MtxState* ms, int* out_tgt)
+{
+	const unsigned int smi  = ui->sm.device->smi;
+	const unsigned int smo  = ui->sm.device->smo;
+	const unsigned int sout = ui->sm.device->sout;
+	const int n_items = get_enum_items (matrix_sel (ui, 0));
+
+	int*  bus_item = (int*)malloc (smo * sizeof (int));   //< out_sel item of each mix-bus
+	bool* bus_own  = (bool*)calloc (smo, sizeof (bool)); //< assigned to a route
+	bool* bus_ext  = (bool*)calloc (smo, sizeof (bool)); //< captured, or used by an output that is not routed
+	int*  row_item = (int*)malloc (smi * sizeof (int));   //< assigned source, or -1
+	int*  item_row = (int*)malloc (n_items * sizeof (int));
+	int   rv = -1;
+
+	for (unsigned int b = 0; b < smo; ++b) {
+		char name[8];
+		snprintf (name, sizeof (name), "Mix %c", 'A' + b);
+		if ((bus_item[b] = enum_item_find (out_sel (ui, 0), name)) < 0) {
+			fprintf (stderr, "Routing: output assign has no item '%s'\n", name);
+			goto out;
+		}
+	}
+
+	for (unsigned int o = 0; o < sout; ++o) {
+		out_tgt[o] = -1;
+		bool routed = false;
+		for (unsigned int i = 0; i < n_rt; ++i) {
+			routed |= rt[i].out == o / 2;
+		}
+		const int b = route_bus_of (wq_get (ui, ctrl_id (ui, out_sel (ui, o)), CV_ENUM), bus_item, smo);
+		if (!routed && b >= 0) {
+			bus_ext[b] = true;
+		}
+	}
+
+	/* a mix-bus may also feed a capture channel (recording a mix) */
+	for (unsigned int i = 0; i < ui->sm.device->sin; ++i) {
+		Mctrl* c = src_sel (ui, i);
+		char name[64];
+		char x;
+		if (!get_enum_item_name (c, wq_get (ui, ctrl_id (ui, c), CV_ENUM), sizeof (name), name)
+		    && sscanf (name, "Mix %c", &x) == 1 && x >= 'A' && x - 'A' < (int)smo) {
+			bus_ext[x - 'A'] = true;
+		}
+	}
+
+	/* mix-busses: keep what the output listens to, then take unused ones */
+	for (unsigned int i = 0; i < n_rt; ++i) {
+		for (unsigned int s = 0; s < rt[i].n_bus; ++s) {
+			const int b = route_bus_of (wq_get (ui, ctrl_id (ui, out_sel (ui, 2 * rt[i].out + s)), CV_ENUM), bus_item, smo);
+			if (b >= 0 && !bus_own[b] && !bus_ext[b]) {
+				bus_own[b] = true;
+				rt[i].bus[s] = b;
+			} else {
+				rt[i].bus[s] = -1;
+			}
+		}
+	}
+	for (unsigned int i = 0; i < n_rt; ++i) {
+		for (unsigned int s = 0; s < rt[i].n_bus; ++s) {
+			for (unsigned int b = 0; b < smo && rt[i].bus[s] < 0; ++b) {
+				if (!bus_own[b] && !bus_ext[b]) {
+					bus_own[b] = true;
+					rt[i].bus[s] = b;
+				}
+			}
+			if (rt[i].bus[s] < 0) {
+				fprintf (stderr, "Route '%s': no free mix-bus\n", rt[i].name);
+				goto out;
+			}
+		}
+	}
+
+	/* matrix inputs: keep those that already select the source,
+	 * then take inputs that feed none of the other mix-busses */
+	for (unsigned int r = 0; r < smi; ++r) {
+		row_item[r] = -1;
+	}
+	for (int it = 0; it < n_items; ++it) {
+		item_row[it] = -1;
+	}
+	for (unsigned int i = 0; i < n_rt; ++i) {
+		for (unsigned int k = 0; k < rt[i].n_src; ++k) {
+			const int it = rt[i].src[k].item;
+			for (unsigned int r = 0; r < smi && item_row[it] < 0; ++r) {
+				if (row_item[r] < 0 && ms->sel[r] == it) {
+					row_item[r] = it;
+					item_row[it] = r;
+				}
+			}
+		}
+	}
+	for (unsigned int i = 0; i < n_rt; ++i) {
+		for (unsigned int k = 0; k < rt[i].n_src; ++k) {
+			const int it = rt[i].src[k].item;
+			for (unsigned int r = 0; r < smi && item_row[it] < 0; ++r) {
+				bool used = row_item[r] >= 0;
+				for (unsigned int b = 0; b < smo && !used; ++b) {
+					used = !bus_own[b] && ms->gain[r * smo + b] > -128.f;
+				}
+				if (!used) {
+					row_item[r] = it;
+					item_row[it] = r;
+				}
+			}
+			if (item_row[it] < 0) {
+				fprintf (stderr, "Route '%s': no free matrix input\n", rt[i].name);
+				goto out;
+			}
+		}
+	}
+
+	/* target state */
+	for (unsigned int r = 0; r < smi; ++r) {
+		if (row_item[r] >= 0) {
+			ms->sel[r] = row_item[r];
+		}
+		for (unsigned int b = 0; b < smo; ++b) {
+			if (bus_own[b]) {
+				ms->gain[r * smo + b] = -128.f;
+			}
+		}
+	}
+	for (unsigned int i = 0; i < n_rt; ++i) {
+		Route const* t = &rt[i];
+		for (unsigned int k = 0; k < t->n_src; ++k) {
+			const unsigned int r = item_row[t->src[k].item];
+			for (unsigned int s = 0; s < 2; ++s) {
+				if (t->src[k].side & (1 << s)) {
+					ms->gain[r * smo + t->bus[t->n_bus == 2 ? s : 0]] = t->src[k].dB;
+				}
+			}
+		}
+		out_tgt[2 * t->out]     = bus_item[t->bus[0]];
+		out_tgt[2 * t->out + 1] = bus_item[t->bus[t->n_bus - 1]];
+		if (verbose) {
+			printf ("Route '%s': %s <- Mix %c", t->name, out_gain_label (ui, t->out), 'A' + t->bus[0]);
+			if (t->n_bus == 2) {
+				printf (", Mix %c", 'A' + t->bus[1]);
+			}
+			printf ("\n");
+		}
+	}
+	rv = 0;
+
+out:
+	free (bus_item);
+	free (bus_own);
+	free (bus_ext);
+	free (row_item);
+	free (item_row);
+	return rv;
+}
+
+/* queue the writes for the given routing, returns their number or -1 */
+static int route_apply (RobTkApp* ui, const char* path)
+{
+	Route* rt = (Route*)malloc (ROUTE_MAX * sizeof (Route));
+	unsigned int n_rt = 0;
+
+	if (route_load (ui, path, rt, &n_rt)) {
+		free (rt);
+		return -1;
+	}
+
+	const unsigned int sout = ui->sm.device->sout;
+	int* out_tgt = (int*)malloc (sout * sizeof (int));
+	MtxState ms;
+	mtx_state_init (ui, &ms);
+
+	int n_writes = -1;
+	if (route_compile (ui, rt, n_rt, &ms, out_tgt) == 0) {
+		hist_begin (ui, -1);
+		n_writes = mtx_state_apply (ui, &ms);
+		for (unsigned int o = 0; o < sout; ++o) {
+			Mctrl* c = out_sel (ui, o);
+			if (out_tgt[o] >= 0 && wq_get (ui, ctrl_id (ui, c), CV_ENUM) != out_tgt[o]) {
+				wq_push (ui, c, CV_ENUM, out_tgt[o]);
+				++n_writes;
+			}
+		}
+		ui->hist_key = -1;
+		if (verbose) {
+			printf ("Routing '%s': %u routes, %d writes\n", path, n_rt, n_writes);
+		}
+	}
+
+	mtx_state_free (&ms);
+	free (out_tgt);
+	free (rt);
+	return n_writes;
+}
+
+/* *****************************************************************************
+ * Solo / cue
+ *
+ * A solo temporarily changes what the cue output (by default the first
+ * headphone pair) plays. The values it overwrites are saved on a stack
+ * and restored by diffing when the solo is released, so the prior mix
+ * comes back exactly. Solos nest: releasing returns to the previous one.
+ *
+ * Soloing a matrix input mutes all other inputs on the mix-busses of
+ * the cue output, soloing a mix-bus assigns it to the cue output.
+ */
+
+/* mix-bus of an output assign item, or -1 */
+static int out_sel_bus (RobTkApp* ui, Mctrl* c, int item)
+{
+	char name[64];
+	char x;
+	if (get_enum_item_name (c, item, sizeof (name), name) || sscanf (name, "Mix %c", &x) != 1) {
+		return -1;
+	}
+	if (x < 'A' || x - 'A' >= (int)ui->sm.device->smo) {
+		return -1;
+	}
+	return x - 'A';
+}
+
+/* distinct mix-busses feeding the cue output */
+static unsigned int cue_busses (RobTkApp* ui, int* bus)
+{
+	unsigned int n = 0;
+	for (unsigned int s = 0; s < 2; ++s) {
+		Mctrl* c = out_sel (ui, 2 * ui->cue_out + s);
+		const int b = out_sel_bus (ui, c, wq_get (ui, ctrl_id (ui, c), CV_ENUM));
+		if (b >= 0 && (n == 0 || bus[0] != b)) {
+			bus[n++] = b;
+		}
+	}
+	return n;
+}
+
+/* mix-bus b also feeds another output or a capture channel */
+static bool cue_bus_shared (RobTkApp* ui, int b)
+{
+	for (unsigned int o = 0; o < ui->sm.device->sout; ++o) {
+		Mctrl* c = out_sel (ui, o);
+		if (o / 2 != ui->cue_out && out_sel_bus (ui, c, wq_get (ui, ctrl_id (ui, c), CV_ENUM)) == b) {
+			return true;
+		}
+	}
+	for (unsigned int i = 0; i < ui->sm.device->sin; ++i) {
+		Mctrl* c = src_sel (ui, i);
+		if (out_sel_bus (ui, c, wq_get (ui, ctrl_id (ui, c), CV_ENUM)) == b) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void solo_update_buttons (RobTkApp* ui)
+{
+	if (!ui->btn_unsolo) {
+		return;
+	}
+	robtk_pbtn_set_sensitive (ui->btn_unsolo, ui->n_solo > 0);
+}
+
+/* save the current value and queue the new one */
+static void solo_set (RobTkApp* ui, SoloState* s, Mctrl* c, int type, int32_t val)
+{
+	const unsigned int id  = ctrl_id (ui, c);
+	const int32_t      cur = wq_get (ui, id, type);
+	CtrlVal* v = &s->saved[s->n_saved++];
+	v->id   = id;
+	v->type = type;
+	v->val  = cur;
+	if (cur != val) {
+		wq_push (ui, c, type, val);
+	}
+}
+
+static void solo_pop (RobTkApp* ui)
+{
+	if (ui->n_solo == 0) {
+		return;
+	}
+	SoloState* s = &ui->solo[--ui->n_solo];
+	hist_begin (ui, -1);
+	for (unsigned int i = 0; i < s->n_saved; ++i) {
+		CtrlVal const* v = &s->saved[i];
+		if (wq_get (ui, v->id, v->type) != v->val) {
+			wq_push (ui, &ui->sm.ctrl[v->id], v->type, v->val);
+		}
+	}
+	ui->hist_key = -1;
+	free (s->saved);
+	s->saved = NULL;
+	ui->need_refresh = true;
+	solo_update_buttons (ui);
+}
+
+/* solo matrix input or mix-bus n, soloing the current solo again releases it */
+static void solo_push (RobTkApp* ui, int kind, unsigned int n)
+{
+	if (ui->n_solo > 0) {
+		SoloState const* top = &ui->solo[ui->n_solo - 1];
+		if (top->kind == kind && top->n == n) {
+			solo_pop (ui);
+			return;
+		}
+	}
+	if (ui->n_solo == SOLO_DEPTH) {
+		fprintf (stderr, "Solo: too many nested solos\n");
+		return;
+	}
+
+	const unsigned int smi = ui->sm.device->smi;
+	SoloState* s = &ui->solo[ui->n_solo++];
+	s->kind    = kind;
+	s->n       = n;
+	s->n_saved = 0;
+	s->saved   = (CtrlVal*)malloc ((2 * smi + 2) * sizeof (CtrlVal));
+
+	int bus[2];
+	unsigned int n_bus = kind == SOLO_ROW ? cue_busses (ui, bus) : 0;
+	for (unsigned int i = 0; i < n_bus; ++i) {
+		if (cue_bus_shared (ui, bus[i])) {
+			/* muting the other inputs would change the main mix as well */
+			fprintf (stderr, "Solo: Mix %c is not only used by '%s', assigning the input directly\n",
+					'A' + bus[i], out_gain_label (ui, ui->cue_out));
+			n_bus = 0;
+			break;
+		}
+	}
+
+	hist_begin (ui, -1);
+	if (n_bus > 0) {
+		/* keep the input's gain, unless it is not part of the mix */
+		for (unsigned int i = 0; i < n_bus; ++i) {
+			for (unsigned int r = 0; r < smi; ++r) {
+				Mctrl* c = matrix_ctrl_cr (ui, bus[i], r);
+				const int32_t cur = wq_get (ui, ctrl_id (ui, c), CV_DB);
+				solo_set (ui, s, c, CV_DB, r != n ? -12800 : cur > -12800 ? cur : 0);
+			}
+		}
+	} else {
+		/* the cue output is not fed by the matrix, or a mix-bus is soloed */
+		Mctrl* l = out_sel (ui, 2 * ui->cue_out);
+		Mctrl* r = out_sel (ui, 2 * ui->cue_out + 1);
+		char name[64];
+		int item = -1;
+		if (kind == SOLO_ROW) {
+			/* the selectors do not necessarily list items in the same order */
+			Mctrl* msel = matrix_sel (ui, n);
+			if (!get_enum_item_name (msel, wq_get (ui, ctrl_id (ui, msel), CV_ENUM), sizeof (name), name)) {
+				item = enum_item_find (l, name);
+			}
+		} else {
+			snprintf (name, sizeof (name), "Mix %c", 'A' + n);
+			item = enum_item_find (l, name);
+		}
+		if (item >= 0) {
+			solo_set (ui, s, l, CV_ENUM, item);
+			solo_set (ui, s, r, CV_ENUM, item);
+		}
+	}
+	ui->hist_key = -1;
+	ui->need_refresh = true;
+	solo_update_buttons (ui);
+}
+
+static void solo_clear (RobTkApp* ui)
+{
+	while (ui->n_solo > 0) {
+		solo_pop (ui);
+	}
+}
+
+/* output pair by label, default: first headphone output */
+static void cue_init (RobTkApp* ui, const char* label)
+{
+	ui->cue_out = 0;
+	for (unsigned int o = 0; o < ui->sm.device->smst && 2 * o + 1 < ui->sm.device->sout; ++o) {
+		if (label ? !strcasecmp (out_gain_label (ui, o), label) : strstr (out_gain_label (ui, o), "Headphone") != NULL) {
+			ui->cue_out = o;
+			return;
+		}
+	}
+	if (label) {
+		fprintf (stderr, "Unknown cue output '%s', using '%s'\n", label, out_gain_label (ui, 0));
+	}
+}
+
+/* *****************************************************************************
+ * Latency measurement
+ *
+ * A maximum length sequence is played on the last PCM channel, routed
+ * through a free mix-bus of the matrix to the last capture channel and
+ * located in the capture by cross-correlation. Outputs that play the
+ * PCM channel directly are switched off during the measurement, the
+ * previous routing is restored afterwards.
+ *
+ * With capture and playback linked, the offset between the capture and
+ * playback frame of the sequence is the latency of the device (USB and
+ * DSP, without converters). The round-trip of an application adds the
+ * playback buffer and one capture period.
+ */
+
+#define LAT_ORDER    13   //< MLS length 2^13 - 1
+#define LAT_LEVEL    .25f //< -12 dBFS
+#define LAT_NPERIODS 2    //< playback buffer, periods
+#define LAT_RETRY    3    //< attempts per setting on xrun
+#define LAT_MAX_SET  16   //< rates and periods per run
+
+typedef struct {
+	unsigned int pcm;     //< playback channel, zero based
+	unsigned int capture; //< capture channel
+	CtrlVal*     saved;
+	unsigned int n_saved;
+} LatRoute;
+
+static volatile sig_atomic_t lat_quit = 0;
+
+static void sig_lat_quit (int sig)
+{
+	lat_quit = 1;
+}
+
+/* x^13 + x^4 + x^3 + x + 1, s[n+13] = s[n+4] ^ s[n+3] ^ s[n+1] ^ s[n]
+ * (primitive, period 2^13 - 1) */
+static void lat_mls (float* buf, unsigned int n)
+{
+	uint32_t s = 1;
+	for (unsigned int i = 0; i < n; ++i) {
+		const uint32_t b = (s ^ (s >> 1) ^ (s >> 3) ^ (s >> 4)) & 1;
+		buf[i] = (s & 1) ? LAT_LEVEL : -LAT_LEVEL;
+		s = (s >> 1) | (b << 12);
+	}
+}
+
+static void lat_set (RobTkApp* ui, LatRoute* lr, Mctrl* c, int type, int32_t val)
+{
+	const unsigned int id = ctrl_id (ui, c);
+	CtrlVal* v = &lr->saved[lr->n_saved++];
+	v->id   = id;
+	v->type = type;
+	v->val  = wq_get (ui, id, type);
+	if (v->val != val) {
+		wq_push (ui, c, type, val);
+	}
+}
+
+static void lat_restore (RobTkApp* ui, LatRoute* lr)
+{
+	++ui->hist_suspend;
+	for (unsigned int i = 0; i < lr->n_saved; ++i) {
+		CtrlVal const* v = &lr->saved[i];
+		if (wq_get (ui, v->id, v->type) != v->val) {
+			wq_push (ui, &ui->sm.ctrl[v->id], v->type, v->val);
+		}
+	}
+	--ui->hist_suspend;
+	wq_flush (ui);
+	free (lr->saved);
+	lr->saved = NULL;
+}
+
+/* last PCM -> matrix input -> free mix-bus -> last capture channel */
+static int lat_route (RobTkApp* ui, LatRoute* lr)
+{
+	Device const* d = ui->sm.device;
+	char name[64];
+
+	/* mix-busses that are not assigned to an output or recorded */
+	uint64_t used = 0;
+	for (unsigned int o = 0; o < d->sout; ++o) {
+		Mctrl* c = out_sel (ui, o);
+		const int b = out_sel_bus (ui, c, wq_get (ui, ctrl_id (ui, c), CV_ENUM));
+		if (b >= 0) {
+			used |= 1ULL << b;
+		}
+	}
+	for (unsigned int i = 0; i < d->sin; ++i) {
+		Mctrl* c = src_sel (ui, i);
+		const int b = out_sel_bus (ui, c, wq_get (ui, ctrl_id (ui, c), CV_ENUM));
+		if (b >= 0) {
+			used |= 1ULL << b;
+		}
+	}
+	int bus = -1;
+	for (unsigned int b = d->smo; b > 0; --b) {
+		if (!(used & (1ULL << (b - 1)))) {
+			bus = b - 1;
+			break;
+		}
+	}
+	if (bus < 0) {
+		fprintf (stderr, "Latency: all mix-busses are assigned to outputs or captured\n");
+		return -1;
+	}
+
+	Mctrl* msel = matrix_sel (ui, d->smi - 1);
+	char pcm_name[64] = "";
+	int pcm_item = -1;
+	for (int i = 0; i < get_enum_items (msel); ++i) {
+		unsigned int n;
+		if (!get_enum_item_name (msel, i, sizeof (name), name) && sscanf (name, "PCM %u", &n) == 1 && n > 0) {
+			lr->pcm  = n - 1;
+			pcm_item = i;
+			strcpy (pcm_name, name);
+		}
+	}
+	snprintf (name, sizeof (name), "Mix %c", 'A' + bus);
+	Mctrl* ssel = src_sel (ui, d->sin - 1);
+	const int mix_item = enum_item_find (ssel, name);
+	if (pcm_item < 0 || mix_item < 0) {
+		fprintf (stderr, "Latency: the device can not route PCM to capture\n");
+		return -1;
+	}
+	lr->capture = d->sin - 1;
+
+	lr->n_saved = 0;
+	lr->saved   = (CtrlVal*)malloc ((d->sout + d->smi + d->smo + 2) * sizeof (CtrlVal));
+
+	++ui->hist_suspend;
+	for (unsigned int o = 0; o < d->sout; ++o) {
+		Mctrl* c = out_sel (ui, o);
+		const int item = enum_item_find (c, pcm_name);
+		if (item >= 0 && wq_get (ui, ctrl_id (ui, c), CV_ENUM) == item) {
+			lat_set (ui, lr, c, CV_ENUM, 0);
+		}
+	}
+	lat_set (ui, lr, msel, CV_ENUM, pcm_item);
+	for (unsigned int c = 0; c < d->smo; ++c) {
+		lat_set (ui, lr, matrix_ctrl_cr (ui, c, d->smi - 1), CV_DB, c == (unsigned int)bus ? 0 : -12800);
+	}
+	for (unsigned int r = 0; r + 1 < d->smi; ++r) {
+		lat_set (ui, lr, matrix_ctrl_cr (ui, bus, r), CV_DB, -12800);
+	}
+	lat_set (ui, lr, ssel, CV_ENUM, mix_item);
+	--ui->hist_suspend;
+	wq_flush (ui);
+
+	if (verbose) {
+		printf ("Latency: PCM %u -> Matrix %u -> Mix %c -> Capture %u\n", lr->pcm + 1, d->smi, 'A' + bus, lr->capture + 1);
+	}
+	return 0;
+}
+
+static int lat_open (snd_pcm_t** pcm, const char* dev, snd_pcm_stream_t dir, unsigned int n_chn, unsigned int rate, snd_pcm_uframes_t* period, snd_pcm_uframes_t bufsiz)
+{
+	snd_pcm_hw_params_t* hwp;
+	snd_pcm_hw_params_alloca (&hwp);
+	int err;
+
+	if ((err = snd_pcm_open (pcm, dev, dir, 0)) < 0) {
+		fprintf (stderr, "Latency: cannot open %s: %s\n", dev, snd_strerror (err));
+		*pcm = NULL;
+		return -1;
+	}
+	snd_pcm_hw_params_any (*pcm, hwp);
+	if (snd_pcm_hw_params_set_access (*pcm, hwp, SND_PCM_ACCESS_RW_INTERLEAVED) < 0
+	    || snd_pcm_hw_params_set_format (*pcm, hwp, SND_PCM_FORMAT_FLOAT_LE) < 0
+	    || snd_pcm_hw_params_set_channels (*pcm, hwp, n_chn) < 0
+	    || snd_pcm_hw_params_set_rate_resample (*pcm, hwp, 0) < 0
+	    || snd_pcm_hw_params_set_rate (*pcm, hwp, rate, 0) < 0
+	    || snd_pcm_hw_params_set_period_size_near (*pcm, hwp, period, NULL) < 0
+	    || snd_pcm_hw_params_set_buffer_size_near (*pcm, hwp, &bufsiz) < 0
+	    || snd_pcm_hw_params (*pcm, hwp) < 0) {
+		snd_pcm_close (*pcm);
+		*pcm = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+/* measure the device latency in frames at the given setting,
+ * returns 0 on success, -1 if the setting is not supported */
+static int lat_measure (LatRoute const* lr, const char* dev, unsigned int rate, snd_pcm_uframes_t* period, long* latency)
+{
+	snd_pcm_t* play;
+	snd_pcm_t* cap;
+	const unsigned int n_play = lr->pcm + 1;
+	const unsigned int n_cap  = lr->capture + 1;
+	const unsigned int n_mls  = (1 << LAT_ORDER) - 1;
+	const unsigned int maxlag = rate / 10;
+
+	if (lat_open (&play, dev, SND_PCM_STREAM_PLAYBACK, n_play, rate, period, LAT_NPERIODS * *period)) {
+		return -1;
+	}
+	snd_pcm_uframes_t cperiod = *period;
+	if (lat_open (&cap, dev, SND_PCM_STREAM_CAPTURE, n_cap, rate, &cperiod, 4 * *period) || cperiod != *period) {
+		if (cap) {
+			snd_pcm_close (cap);
+		}
+		snd_pcm_close (play);
+		return -1;
+	}
+
+	const snd_pcm_uframes_t p = *period;
+	const unsigned int prefill = LAT_NPERIODS * p;
+	const unsigned int n_rec = prefill + maxlag + n_mls + p;
+
+	float* mls  = (float*)malloc (n_mls * sizeof (float));
+	float* rec  = (float*)calloc (n_rec + p, sizeof (float));
+	float* pbuf = (float*)malloc (p * n_play * sizeof (float));
+	float* cbuf = (float*)malloc (p * n_cap * sizeof (float));
+	lat_mls (mls, n_mls);
+
+	int rv = -1;
+	bool linked = snd_pcm_link (cap, play) == 0;
+
+	for (int attempt = 0; attempt < LAT_RETRY && rv < 0 && !lat_quit; ++attempt) {
+		snd_pcm_drop (play);
+		snd_pcm_drop (cap);
+		snd_pcm_prepare (play);
+		if (!linked) {
+			snd_pcm_prepare (cap);
+		}
+
+		memset (pbuf, 0, p * n_play * sizeof (float));
+		for (unsigned int k = 0; k < LAT_NPERIODS; ++k) {
+			snd_pcm_writei (play, pbuf, p);
+		}
+		if (!linked) {
+			snd_pcm_start (play);
+		}
+		snd_pcm_start (cap);
+
+		bool xrun = false;
+		unsigned int played = prefill;
+		for (unsigned int pos = 0; pos < n_rec; pos += p) {
+			if (lat_quit || snd_pcm_readi (cap, cbuf, p) != (snd_pcm_sframes_t)p) {
+				xrun = true;
+				break;
+			}
+			for (unsigned int i = 0; i < p; ++i) {
+				rec[pos + i] = cbuf[i * n_cap + lr->capture];
+			}
+			for (unsigned int i = 0; i < p; ++i, ++played) {
+				const unsigned int k = played - prefill;
+				pbuf[i * n_play + lr->pcm] = k < n_mls ? mls[k] : 0.f;
+			}
+			if (snd_pcm_writei (play, pbuf, p) != (snd_pcm_sframes_t)p) {
+				xrun = true;
+				break;
+			}
+		}
+		if (xrun) {
+			continue;
+		}
+
+		/* cross-correlation, the sequence was played from frame `prefill` */
+		double e = 0;
+		for (unsigned int i = 0; i < n_mls; ++i) {
+			e += mls[i] * mls[i];
+		}
+		double peak = 0;
+		long lag = -1;
+		for (unsigned int k = 0; k <= maxlag; ++k) {
+			float const* r = &rec[prefill + k];
+			double c = 0;
+			for (unsigned int i = 0; i < n_mls; ++i) {
+				c += mls[i] * r[i];
+			}
+			if (c > peak) {
+				peak = c;
+				lag = k;
+			}
+		}
+		if (peak < .1 * e) {
+			fprintf (stderr, "Latency: no signal at %u Hz, %lu frames/period\n", rate, p);
+			break;
+		}
+		*latency = lag;
+		rv = 0;
+	}
+
+	if (linked) {
+		snd_pcm_unlink (cap);
+	}
+	snd_pcm_drop (play);
+	snd_pcm_drop (cap);
+	snd_pcm_close (play);
+	snd_pcm_close (cap);
+	free (mls);
+	free (rec);
+	free (pbuf);
+	free (cbuf);
+	return rv;
+}
+
+static unsigned int lat_parse_list (char* s, unsigned int* v)
+{
+	unsigned int n = 0;
+	char* save = NULL;
+	for (char* tok = strtok_r (s, ",", &save); tok && n < LAT_MAX_SET; tok = strtok_r (NULL, ",", &save)) {
+		const int x = atoi (tok);
+		if (x <= 0) {
+			return 0;
+		}
+		v[n++] = x;
+	}
+	return n;
+}
+
+/* <rate>[,<rate>..]:<period>[,<period>..] */
+static int lat_run (RobTkApp* ui, const char* spec)
+{
+	unsigned int rates[LAT_MAX_SET];
+	unsigned int periods[LAT_MAX_SET];
+	char* tmp = strdup (spec);
+	char* p = strchr (tmp, ':');
+	unsigned int n_rates = 0, n_periods = 0;
+	if (p) {
+		*p = '\0';
+		n_rates   = lat_parse_list (tmp, rates);
+		n_periods = lat_parse_list (p + 1, periods);
+	}
+	free (tmp);
+	if (n_rates == 0 || n_periods == 0) {
+		fprintf (stderr, "Invalid latency specification '%s'\n", spec);
+		return -1;
+	}
+
+	char dev[64];
+	if (!strncmp (ui->sm.card, "hw:", 3)) {
+		snprintf (dev, sizeof (dev), "plug%s", ui->sm.card);
+	} else {
+		snprintf (dev, sizeof (dev), "%s", ui->sm.card);
+	}
+
+	LatRoute lr;
+	if (lat_route (ui, &lr)) {
+		return -1;
+	}
+
+	/* restore the routing when interrupted */
+	lat_quit = 0;
+	signal (SIGINT, sig_lat_quit);
+	signal (SIGTERM, sig_lat_quit);
+
+	struct sched_param param;
+	param.sched_priority = METER_RT_PRIO;
+	pthread_setschedparam (pthread_self (), SCHED_FIFO, &param);
+
+	int rv = 0;
+	for (unsigned int r = 0; r < n_rates && !lat_quit; ++r) {
+		for (unsigned int i = 0; i < n_periods && !lat_quit; ++i) {
+			snd_pcm_uframes_t period = periods[i];
+			long lat;
+			if (lat_measure (&lr, dev, rates[r], &period, &lat)) {
+				if (lat_quit) {
+					break;
+				}
+				printf ("%6u Hz, %4u frames/period: not measured\n", rates[r], periods[i]);
+				rv = -1;
+				continue;
+			}
+			const long rt = lat + (LAT_NPERIODS + 1) * period;
+			printf ("%6u Hz, %4lu frames/period: device %ld frames (%.3f ms), round-trip with %d periods %ld frames (%.3f ms)\n",
+					rates[r], period, lat, 1e3 * lat / rates[r], LAT_NPERIODS, rt, 1e3 * rt / rates[r]);
+			fflush (stdout);
+		}
+	}
+
+	if (lat_quit) {
+		fprintf (stderr, "Latency: interrupted, restoring the routing\n");
+		rv = -1;
+	}
+	lat_restore (ui, &lr);
+	signal (SIGINT, SIG_DFL);
+	signal (SIGTERM, SIG_DFL);
+	return rv;
+}
+
+/* *****************************************************************************
+ * Panic mute and dim
+ *
+ * These bypass the write-queue: they are written immediately, with one
+ * transfer per element (all channels at once), and neutralize any pending
+ * writes that would undo them.
+ */
+
+#define DIM_DB -20
+
+static volatile sig_atomic_t panic_request = 0;
+
+static void sig_panic (int sig)
+{
+	panic_request = 1;
+}
+
+static bool panic_mute_ctrl (RobTkApp* ui, Mctrl* c)
+{
+	const unsigned int id = ctrl_id (ui, c);
+	const int slot = ui->wq_slot[id * CV_TYPES + CV_MUTE];
+	if (slot >= 0) {
+		/* pending un-mute, if any, will be skipped by wq_flush () */
+		ui->wq[slot].val = 1;
+	}
+	if (get_mute (c)) {
+		return false;
+	}
+	if (!c->elem) {
+		set_mute (c, true);
+	} else {
+		TRACE_BEGIN ("set_mute");
+		snd_mixer_selem_set_playback_switch_all (c->elem, 0);
+		TRACE_END ("set_mute");
+	}
+	hist_record (ui, id, CV_MUTE, 0, 1);
+	jrn_append (ui, id, CV_MUTE, JRN_GUI, 1);
+	return true;
+}
+
+static void panic_mute (RobTkApp* ui)
+{
+	const uint64_t t0 = monotonic_ns ();
+	unsigned int n_written = 0;
+
+	/* a running crossfade would un-mute the outputs with its next step */
+	if (ui->cues) {
+		ui->cues->abort = true;
+	}
+
+	hist_begin (ui, -1);
+
+	if (panic_mute_ctrl (ui, mst_gain (ui))) {
+		++n_written;
+	}
+	for (unsigned int o = 0; o < ui->sm.device->smst; ++o) {
+		if (panic_mute_ctrl (ui, out_gain (ui, o))) {
+			++n_written;
+		}
+	}
+
+	ui->panic_usec = (monotonic_ns () - t0) / 1000;
+	printf ("Panic: muted %u outputs in %" PRIu64 " us\n", n_written, ui->panic_usec);
+
+	ui->disable_signals = true;
+	robtk_dial_set_state (ui->mst_gain, 1);
+	for (unsigned int o = 0; o < ui->sm.device->smst; ++o) {
+		robtk_dial_set_state (ui->out_gain[o], 1);
+	}
+	ui->disable_signals = false;
+}
+
+static void dim_master (RobTkApp* ui, bool dim)
+{
+	Mctrl* c = mst_gain (ui);
+	const unsigned int id = ctrl_id (ui, c);
+	const int32_t cur = wq_get (ui, id, CV_DB);
+	int32_t val;
+
+	if (dim) {
+		ui->dim_restore = cur;
+		val = lrintf (100.f * clamp_db (cur / 100.f + DIM_DB));
+	} else {
+		val = ui->dim_restore;
+	}
+
+	const int slot = ui->wq_slot[id * CV_TYPES + CV_DB];
+	if (slot >= 0) {
+		ui->wq[slot].val = val;
+	}
+
+	const uint64_t t0 = monotonic_ns ();
+	hist_begin (ui, -1);
+	hist_record (ui, id, CV_DB, cur, val);
+	set_cdB (c, val);
+	jrn_append (ui, id, CV_DB, JRN_GUI, val);
+	ui->panic_usec = (monotonic_ns () - t0) / 1000;
+	printf ("Dim: master %s in %" PRIu64 " us\n", dim ? "dimmed" : "restored", ui->panic_usec);
+
+	ui->disable_signals = true;
+	robtk_dial_set_value (ui->mst_gain, db_to_knob (val / 100.f));
+	ui->disable_signals = false;
+}
+
+/* *****************************************************************************
+ * Panic hotkey
+ *
+ * robtk widgets do not receive key events. The key is grabbed on the
+ * X11 root window with a separate display connection, so it also works
+ * when the mixer does not have the focus. Key presses set panic_request,
+ * like SIGUSR1.
+ */
+
+#define HOTKEY_DEFAULT "Pause"
+
+#ifdef WITH_HOTKEY
+
+static int hotkey_err = 0;
+
+static int hotkey_x_error (Display* dpy, XErrorEvent* ev)
+{
+	hotkey_err = ev->error_code;
+	return 0;
+}
+
+static void* hotkey_thread (void* arg)
+{
+	Hotkey* hk = (Hotkey*)arg;
+	Display* dpy = (Display*)hk->dpy;
+	struct pollfd pfd;
+	pfd.fd     = ConnectionNumber (dpy);
+	pfd.events = POLLIN;
+
+	while (hk->run) {
+		poll (&pfd, 1, 100);
+		while (XPending (dpy)) {
+			XEvent ev;
+			XNextEvent (dpy, &ev);
+			if (ev.type == KeyPress) {
+				panic_request = 1;
+			}
+		}
+	}
+	return NULL;
+}
+
+static int hotkey_start (RobTkApp* ui, const char* key)
+{
+	const KeySym sym = XStringToKeysym (key);
+	if (sym == NoSymbol) {
+		fprintf (stderr, "Panic key: unknown key '%s'\n", key);
+		return -1;
+	}
+	Display* dpy = XOpenDisplay (NULL);
+	if (!dpy) {
+		fprintf (stderr, "Panic key: cannot open display\n");
+		return -1;
+	}
+	const KeyCode code = XKeysymToKeycode (dpy, sym);
+	if (code == 0) {
+		fprintf (stderr, "Panic key: '%s' is not on the keyboard\n", key);
+		XCloseDisplay (dpy);
+		return -1;
+	}
+
+	/* a grab fails asynchronously, e.g. if another client has it */
+	hotkey_err = 0;
+	XErrorHandler prev = XSetErrorHandler (hotkey_x_error);
+	XGrabKey (dpy, code, AnyModifier, DefaultRootWindow (dpy), False, GrabModeAsync, GrabModeAsync);
+	XSync (dpy, False);
+	XSetErrorHandler (prev);
+	if (hotkey_err) {
+		fprintf (stderr, "Panic key: '%s' is used by another application\n", key);
+		XCloseDisplay (dpy);
+		return -1;
+	}
+
+	Hotkey* hk = (Hotkey*)calloc (1, sizeof (Hotkey));
+	hk->dpy = dpy;
+	hk->run = true;
+	if (pthread_create (&hk->thread, NULL, hotkey_thread, hk)) {
+		fprintf (stderr, "Panic key: cannot start thread\n");
+		XCloseDisplay (dpy);
+		free (hk);
+		return -1;
+	}
+	ui->hotkey = hk;
+	if (verbose) {
+		printf ("Panic key: %s\n", key);
+	}
+	return 0;
+}
+
+static void hotkey_stop (RobTkApp* ui)
+{
+	Hotkey* hk = ui->hotkey;
+	if (!hk) {
+		return;
+	}
+	hk->run = false;
+	pthread_join (hk->thread, NULL);
+	XCloseDisplay ((Display*)hk->dpy);
+	free (hk);
+	ui->hotkey = NULL;
+}
+
+#else
+
+static int hotkey_start (RobTkApp* ui, const char* key)
+{
+	if (strcmp (key, HOTKEY_DEFAULT)) {
+		fprintf (stderr, "Panic key: not available in this build\n");
+	}
+	return -1;
+}
+
+static void hotkey_stop (RobTkApp* ui) { }
+
+#endif
+
+/* commandline: mute all masters, without loading the mixer */
+static int panic_ctl (const char* card)
+{
+	int err;
+	snd_ctl_t* ctl;
+	snd_ctl_elem_list_t* list;
+	snd_ctl_elem_value_t* value;
+	snd_ctl_elem_list_alloca (&list);
+	snd_ctl_elem_value_alloca (&value);
+
+	const uint64_t t0 = monotonic_ns ();
+
+	if ((err = snd_ctl_open (&ctl, card, 0)) < 0) {
+		fprintf (stderr, "Control device %s open error: %s\n", card, snd_strerror (err));
+		return err;
+	}
+	if ((err = snd_ctl_elem_list (ctl, list)) < 0 ||
+	    (err = snd_ctl_elem_list_alloc_space (list, snd_ctl_elem_list_get_count (list))) < 0 ||
+	    (err = snd_ctl_elem_list (ctl, list)) < 0) {
+		fprintf (stderr, "Control device %s list error: %s\n", card, snd_strerror (err));
+		snd_ctl_close (ctl);
+		return err;
+	}
+
+	unsigned int n_written = 0;
+	for (unsigned int i = 0; i < snd_ctl_elem_list_get_used (list); ++i) {
+		const char* name = snd_ctl_elem_list_get_name (list, i);
+		if (strncmp (name, "Master", 6) || !strstr (name, " Playback Switch")) {
+			continue;
+		}
+		snd_ctl_elem_value_clear (value);
+		snd_ctl_elem_value_set_numid (value, snd_ctl_elem_list_get_numid (list, i));
+		/* stereo masters have 2 channels, the kernel ignores extra values */
+		snd_ctl_elem_value_set_boolean (value, 0, 0);
+		snd_ctl_elem_value_set_boolean (value, 1, 0);
+		if ((err = snd_ctl_elem_write (ctl, value)) < 0) {
+			fprintf (stderr, "Cannot mute '%s': %s\n", name, snd_strerror (err));
+			continue;
+		}
+		++n_written;
+	}
+
+	snd_ctl_elem_list_free_space (list);
+	snd_ctl_close (ctl);
+
+	printf ("Panic: muted %u outputs in %" PRIu64 " us\n", n_written, (monotonic_ns () - t0) / 1000);
+	return 0;
+}
+
+/* *****************************************************************************
+ * Spectrum analyzer
+ *
+ * The capture thread only copies the analyzed channel into a ring-buffer.
+ * A separate, non-realtime thread runs a windowed real FFT with 50%
+ * overlap and publishes per-band levels using a sequence-lock, in the
+ * same way as the meters.
+ */
+
+static void spec_feed (Spectrum* s, float const* buf, unsigned int n_frames, unsigned int stride)
+{
+	const int chn = s->chn;
+	uint32_t wr = s->wr;
+	for (unsigned int f = 0; f < n_frames; ++f, ++wr) {
+		s->ring[wr & (SPEC_RING - 1)] = buf[f * stride + chn];
+	}
+	__sync_synchronize ();
+	s->wr = wr;
+}
+
+/* in-place complex FFT of size SPEC_N / 2, split real/imaginary */
+static void spec_fft (Spectrum* s, float* re, float* im)
+{
+	const unsigned int m = SPEC_N / 2;
+	for (unsigned int i = 0; i < m; ++i) {
+		const unsigned int j = s->rev[i];
+		if (j > i) {
+			float t = re[i]; re[i] = re[j]; re[j] = t;
+			t = im[i]; im[i] = im[j]; im[j] = t;
+		}
+	}
+	for (unsigned int half = 1; half < m; half <<= 1) {
+		/* twiddles of this stage are at [half - 1 .. 2 * half - 1) */
+		float const* wr = &s->tw_re[half - 1];
+		float const* wi = &s->tw_im[half - 1];
+		for (unsigned int k = 0; k < m; k += 2 * half) {
+			float* ar = &re[k];
+			float* ai = &im[k];
+			float* br = &re[k + half];
+			float* bi = &im[k + half];
+			unsigned int j = 0;
+#ifdef __SSE__
+			for (; j + 4 <= half; j += 4) {
+				const __m128 xr = _mm_loadu_ps (&br[j]);
+				const __m128 xi = _mm_loadu_ps (&bi[j]);
+				const __m128 cr = _mm_loadu_ps (&wr[j]);
+				const __m128 ci = _mm_loadu_ps (&wi[j]);
+				const __m128 tr = _mm_sub_ps (_mm_mul_ps (xr, cr), _mm_mul_ps (xi, ci));
+				const __m128 ti = _mm_add_ps (_mm_mul_ps (xr, ci), _mm_mul_ps (xi, cr));
+				const __m128 yr = _mm_loadu_ps (&ar[j]);
+				const __m128 yi = _mm_loadu_ps (&ai[j]);
+				_mm_storeu_ps (&br[j], _mm_sub_ps (yr, tr));
+				_mm_storeu_ps (&bi[j], _mm_sub_ps (yi, ti));
+				_mm_storeu_ps (&ar[j], _mm_add_ps (yr, tr));
+				_mm_storeu_ps (&ai[j], _mm_add_ps (yi, ti));
+			}
+#endif
+			for (; j < half; ++j) {
+				const float tr = br[j] * wr[j] - bi[j] * wi[j];
+				const float ti = br[j] * wi[j] + bi[j] * wr[j];
+				br[j] = ar[j] - tr;
+				bi[j] = ai[j] - ti;
+				ar[j] += tr;
+				ai[j] += ti;
+			}
+		}
+	}
+}
+
+/* power spectrum of SPEC_N real samples starting at ring position rd */
+static void spec_analyze (Spectrum* s, uint32_t rd)
+{
+	const unsigned int m = SPEC_N / 2;
+	float* re = s->re;
+	float* im = s->im;
+
+	/* pack even/odd samples as real/imaginary */
+	for (unsigned int i = 0; i < m; ++i) {
+		re[i] = s->ring[(rd + 2 * i) & (SPEC_RING - 1)] * s->win[2 * i];
+		im[i] = s->ring[(rd + 2 * i + 1) & (SPEC_RING - 1)] * s->win[2 * i + 1];
+	}
+
+	spec_fft (s, re, im);
+
+	/* split into the spectrum of the real sequence, bins 0 .. m */
+	for (unsigned int k = 0; k <= m; ++k) {
+		const unsigned int k0 = k % m;
+		const unsigned int k1 = (m - k) % m;
+		const float evr = .5f * (re[k0] + re[k1]);
+		const float evi = .5f * (im[k0] - im[k1]);
+		const float odr = .5f * (im[k0] + im[k1]);
+		const float odi = -.5f * (re[k0] - re[k1]);
+		const float cr = s->pc[k];
+		const float ci = s->ps[k];
+		const float xr = evr + odr * cr - odi * ci;
+		const float xi = evi + odr * ci + odi * cr;
+		s->pwr[k] = (xr * xr + xi * xi) * s->norm;
+	}
+}
+
+static float spec_db (float p)
+{
+	return p > 1e-12f ? 10.f * log10f (p) : -120.f;
+}
+
+static void spec_publish (Spectrum* s)
+{
+	SpecShared* sh = &s->sh;
+	const float df = s->rate / (float)SPEC_N;
+
+	/* strongest bin, parabolic interpolation */
+	unsigned int pk = s->lo[0] > 1 ? s->lo[0] : 1;
+	for (unsigned int k = pk + 1; k < SPEC_N / 2; ++k) {
+		if (s->pwr[k] > s->pwr[pk]) {
+			pk = k;
+		}
+	}
+	const float a = spec_db (s->pwr[pk - 1]);
+	const float b = spec_db (s->pwr[pk]);
+	const float c = spec_db (s->pwr[pk + 1]);
+	const float d = a - 2.f * b + c;
+	const float delta = d < 0.f ? .5f * (a - c) / d : 0.f;
+
+	++sh->seq;
+	__sync_synchronize ();
+	for (unsigned int i = 0; i < SPEC_BANDS; ++i) {
+		float p = 0;
+		for (unsigned int k = s->lo[i]; k <= s->hi[i]; ++k) {
+			p = s->pwr[k] > p ? s->pwr[k] : p;
+		}
+		sh->band[i] = spec_db (p);
+	}
+	sh->peak_hz = (pk + delta) * df;
+	sh->peak_db = b - .25f * (a - c) * delta;
+	++sh->gen;
+	__sync_synchronize ();
+	++sh->seq;
+}
+
+static void* spec_thread (void* arg)
+{
+	Spectrum* s = (Spectrum*)arg;
+	int chn = -1;
+	uint32_t rd = 0;
+
+	/* half a hop */
+	struct timespec ts;
+	ts.tv_sec  = 0;
+	ts.tv_nsec = 500000000L * SPEC_HOP / s->rate;
+
+	while (s->run) {
+		if (chn != s->chn) {
+			chn = s->chn;
+			rd  = s->wr;
+		}
+		const uint32_t wr = s->wr;
+		__sync_synchronize ();
+		if (chn < 0 || wr - rd < SPEC_N) {
+			nanosleep (&ts, NULL);
+			continue;
+		}
+		if (wr - rd > SPEC_RING - SPEC_N) {
+			/* fell behind, skip to the most recent window */
+			rd = wr - SPEC_N;
+		}
+		TRACE_BEGIN ("spectrum");
+		spec_analyze (s, rd);
+		spec_publish (s);
+		TRACE_END ("spectrum");
+		rd += SPEC_HOP;
+	}
+	return NULL;
+}
+
+static void spec_free (Spectrum* s)
+{
+	if (s->run) {
+		s->run = false;
+		pthread_join (s->thread, NULL);
+	}
+	if (s->grid) {
+		cairo_surface_destroy (s->grid);
+	}
+	free (s->win);
+	free (s->re);
+	free (s->im);
+	free (s->pwr);
+	free (s->pc);
+	free (s->ps);
+	free (s->tw_re);
+	free (s->tw_im);
+	free (s->rev);
+	free (s);
+}
+
+static int spec_start (Meter* m)
+{
+	Spectrum* s = (Spectrum*)calloc (1, sizeof (Spectrum));
+	const unsigned int n = SPEC_N;
+	const unsigned int h = SPEC_N / 2;
+
+	s->chn  = -1;
+	s->rate = m->rate;
+	s->win  = (float*)malloc (n * sizeof (float));
+	s->re   = (float*)malloc (h * sizeof (float));
+	s->im   = (float*)malloc (h * sizeof (float));
+	s->pwr  = (float*)malloc ((h + 1) * sizeof (float));
+	s->pc   = (float*)malloc ((h + 1) * sizeof (float));
+	s->ps   = (float*)malloc ((h + 1) * sizeof (float));
+	s->tw_re = (float*)malloc (h * sizeof (float));
+	s->tw_im = (float*)malloc (h * sizeof (float));
+	s->rev  = (uint32_t*)malloc (h * sizeof (uint32_t));
+
+	double wsum = 0;
+	for (unsigned int i = 0; i < n; ++i) {
+		s->win[i] = .5f - .5f * cosf (2.f * M_PI * i / n);
+		wsum += s->win[i];
+	}
+	/* full-scale sine at 0 dBFS */
+	s->norm = 4.f / (wsum * wsum);
+
+	unsigned int bits = 0;
+	while ((1U << bits) < h) {
+		++bits;
+	}
+	for (unsigned int i = 0; i < h; ++i) {
+		uint32_t r = 0;
+		for (unsigned int b = 0; b < bits; ++b) {
+			r |= ((i >> b) & 1) << (bits - 1 - b);
+		}
+		s->rev[i] = r;
+	}
+	for (unsigned int half = 1; half < h; half <<= 1) {
+		for (unsigned int j = 0; j < half; ++j) {
+			s->tw_re[half - 1 + j] = cos (-M_PI * j / half);
+			s->tw_im[half - 1 + j] = sin (-M_PI * j / half);
+		}
+	}
+	for (unsigned int k = 0; k <= h; ++k) {
+		s->pc[k] = cos (-2. * M_PI * k / n);
+		s->ps[k] = sin (-2. * M_PI * k / n);
+	}
+
+	/* logarithmic bands from SPEC_FMIN to nyquist */
+	const float df = s->rate / (float)n;
+	const float fmax = .5f * s->rate;
+	for (unsigned int i = 0; i < SPEC_BANDS; ++i) {
+		const float f0 = SPEC_FMIN * powf (fmax / SPEC_FMIN, i / (float)SPEC_BANDS);
+		const float f1 = SPEC_FMIN * powf (fmax / SPEC_FMIN, (i + 1) / (float)SPEC_BANDS);
+		unsigned int lo = rintf (f0 / df);
+		unsigned int hi = ceilf (f1 / df) - 1;
+		if (lo < 1) lo = 1;
+		if (lo > h) lo = h;
+		if (hi < lo) hi = lo;
+		if (hi > h) hi = h;
+		s->lo[i] = lo;
+		s->hi[i] = hi;
+	}
+	for (unsigned int i = 0; i < SPEC_BANDS; ++i) {
+		s->disp[i] = SPEC_FLOOR;
+	}
+
+	s->run = true;
+	if (pthread_create (&s->thread, NULL, spec_thread, s)) {
+		fprintf (stderr, "Spectrum: cannot start analysis thread\n");
+		s->run = false;
+		spec_free (s);
+		return -1;
+	}
+	__sync_synchronize ();
+	m->spec = s;
+	return 0;
+}
+
+/* *****************************************************************************
+ * Capture meters
+ *
+ * The capture PCM is read by a realtime thread, which computes peak and
+ * RMS per channel and publishes them using a sequence-lock. The thread
+ * never waits for the GUI: if the GUI is busy, it simply misses updates.
+ * Peaks are accumulated until the GUI acknowledges having read them.
+ *
+ * Levels of the matrix mix-busses are estimated from the captured
+ * inputs, using the current matrix routing and gains.
+ */
+
+/* samples are squared: peak = max (x^2), rms = sum (x^2) */
+static void meter_kernel (float const* buf, unsigned int n_frames, unsigned int stride, float* peak, float* sum)
+{
+#ifdef __SSE__
+	for (unsigned int c = 0; c < stride; c += 4) {
+		__m128 pk = _mm_loadu_ps (&peak[c]);
+		__m128 sq = _mm_loadu_ps (&sum[c]);
+		float const* b = &buf[c];
+		for (unsigned int f = 0; f < n_frames; ++f, b += stride) {
+			const __m128 x  = _mm_loadu_ps (b);
+			const __m128 x2 = _mm_mul_ps (x, x);
+			pk = _mm_max_ps (pk, x2);
+			sq = _mm_add_ps (sq, x2);
+		}
+		_mm_storeu_ps (&peak[c], pk);
+		_mm_storeu_ps (&sum[c], sq);
+	}
+#else
+	for (unsigned int f = 0; f < n_frames; ++f, buf += stride) {
+		for (unsigned int c = 0; c < stride; ++c) {
+			const float x2 = buf[c] * buf[c];
+			peak[c] = x2 > peak[c] ? x2 : peak[c];
+			sum[c] += x2;
+		}
+	}
+#endif
+}
+
+/* out[f][b] = sum_i (in[f][mx->in[i]] * mx->gain[i][b]) */
+static void meter_mix_kernel (float const* in, unsigned int n_frames, unsigned int stride, MeterMix const* mx, unsigned int bstride, float* out)
+{
+	memset (out, 0, n_frames * bstride * sizeof (float));
+	for (unsigned int i = 0; i < mx->n_in; ++i) {
+		float const* x = &in[mx->in[i]];
+		float const* g = &mx->gain[i * bstride];
+		float* o = out;
+#ifdef __SSE__
+		for (unsigned int f = 0; f < n_frames; ++f, x += stride, o += bstride) {
+			const __m128 xx = _mm_set1_ps (*x);
+			for (unsigned int b = 0; b < bstride; b += 4) {
+				_mm_storeu_ps (&o[b], _mm_add_ps (_mm_loadu_ps (&o[b]), _mm_mul_ps (xx, _mm_loadu_ps (&g[b]))));
+			}
+		}
+#else
+		for (unsigned int f = 0; f < n_frames; ++f, x += stride, o += bstride) {
+			for (unsigned int b = 0; b < bstride; ++b) {
+				o[b] += *x * g[b];
+			}
+		}
+#endif
+	}
+}
+
+/* interleaved PCM to padded interleaved float */
+static void meter_convert (Meter* m, unsigned int n_frames)
+{
+	const unsigned int n_chn = m->n_chn;
+	const unsigned int n_met = m->n_met;
+	float* out = m->buf;
+
+	switch (m->format) {
+		case SND_PCM_FORMAT_S32_LE:
+			{
+				int32_t const* in = (int32_t const*)m->raw;
+				for (unsigned int f = 0; f < n_frames; ++f, in += n_chn, out += m->stride) {
+					for (unsigned int c = 0; c < n_met; ++c) {
+						out[c] = in[c] / 2147483648.f;
+					}
+				}
+			}
+			break;
+		case SND_PCM_FORMAT_S24_3LE:
+			{
+				uint8_t const* in = (uint8_t const*)m->raw;
+				for (unsigned int f = 0; f < n_frames; ++f, in += 3 * n_chn, out += m->stride) {
+					for (unsigned int c = 0; c < n_met; ++c) {
+						int32_t s = (in[3 * c] << 8) | (in[3 * c + 1] << 16) | ((uint32_t)in[3 * c + 2] << 24);
+						out[c] = s / 2147483648.f;
+					}
+				}
+			}
+			break;
+		default:
+			{
+				int16_t const* in = (int16_t const*)m->raw;
+				for (unsigned int f = 0; f < n_frames; ++f, in += n_chn, out += m->stride) {
+					for (unsigned int c = 0; c < n_met; ++c) {
+						out[c] = in[c] / 32768.f;
+					}
+				}
+			}
+			break;
+	}
+}
+
+static void meter_publish (Meter* m)
+{
+	MeterShared* sh = &m->sh;
+	const float norm = 1.f / m->win_n;
+
+	const unsigned int n_ch = m->stride + m->n_bus;
+
+	if (sh->ack == m->gen) {
+		/* GUI has seen the previous peaks */
+		memset (m->pend_peak, 0, sizeof (m->pend_peak));
+	}
+	for (unsigned int c = 0; c < n_ch; ++c) {
+		if (m->win_peak[c] > m->pend_peak[c]) {
+			m->pend_peak[c] = m->win_peak[c];
+		}
+	}
+
+	++sh->seq;
+	__sync_synchronize ();
+	for (unsigned int c = 0; c < n_ch; ++c) {
+		sh->peak[c] = m->pend_peak[c];
+		sh->rms[c]  = m->win_sum[c] * norm;
+	}
+	sh->gen = ++m->gen;
+	__sync_synchronize ();
+	++sh->seq;
+
+	memset (m->win_peak, 0, sizeof (m->win_peak));
+	memset (m->win_sum, 0, sizeof (m->win_sum));
+	m->win_n = 0;
+}
+
+static void* meter_thread (void* arg)
+{
+	Meter* m = (Meter*)arg;
+
+	struct sched_param param;
+	param.sched_priority = METER_RT_PRIO;
+	pthread_setschedparam (pthread_self (), SCHED_FIFO, &param);
+
+	while (m->run) {
+		snd_pcm_sframes_t n = snd_pcm_readi (m->pcm, m->raw, m->period);
+		if (n == -EAGAIN || n == 0) {
+			/* non-blocking, a stalled device must not keep meter_stop () waiting */
+			snd_pcm_wait (m->pcm, METER_WAIT_MS);
+			continue;
+		}
+		if (n < 0) {
+			++m->xruns;
+			if (snd_pcm_recover (m->pcm, n, 1) < 0) {
+				break;
+			}
+			continue;
+		}
+		TRACE_BEGIN ("meter");
+		meter_convert (m, n);
+		Spectrum* s = m->spec;
+		if (s && s->chn >= 0) {
+			spec_feed (s, m->buf, n, m->stride);
+		}
+		meter_kernel (m->buf, n, m->stride, m->win_peak, m->win_sum);
+		if (m->n_bus > 0) {
+			const uint32_t cur = m->mix_cur;
+			__sync_synchronize ();
+			m->mix_ack = cur;
+			meter_mix_kernel (m->buf, n, m->stride, &m->mix[cur], m->bstride, m->mixbuf);
+			meter_kernel (m->mixbuf, n, m->bstride, &m->win_peak[m->stride], &m->win_sum[m->stride]);
+		}
+		m->win_n += n;
+		if (m->win_n >= m->win_len) {
+			meter_publish (m);
+		}
+		TRACE_END ("meter");
+	}
+	return NULL;
+}
+
+static int meter_open (Meter* m, const char* card, unsigned int n_met, unsigned int n_bus)
+{
+	static const snd_pcm_format_t formats[] = {
+		SND_PCM_FORMAT_S32_LE, SND_PCM_FORMAT_S24_3LE, SND_PCM_FORMAT_S16_LE
+	};
+	snd_pcm_hw_params_t* hwp;
+	snd_pcm_hw_params_alloca (&hwp);
+	int err;
+
+	/* do not wait if the device is in use, reads do not block either,
+	 * see meter_thread () */
+	if ((err = snd_pcm_open (&m->pcm, card, SND_PCM_STREAM_CAPTURE, SND_PCM_NONBLOCK)) < 0) {
+		fprintf (stderr, "Meters: cannot open capture device %s: %s\n", card, snd_strerror (err));
+		m->pcm = NULL;
+		return -1;
+	}
+
+	snd_pcm_hw_params_any (m->pcm, hwp);
+	snd_pcm_hw_params_set_access (m->pcm, hwp, SND_PCM_ACCESS_RW_INTERLEAVED);
+
+	m->format = SND_PCM_FORMAT_UNKNOWN;
+	for (unsigned int i = 0; i < sizeof (formats) / sizeof (formats[0]); ++i) {
+		if (snd_pcm_hw_params_set_format (m->pcm, hwp, formats[i]) == 0) {
+			m->format = formats[i];
+			break;
+		}
+	}
+
+	unsigned int rate = 48000;
+	snd_pcm_uframes_t period = METER_PERIOD;
+	snd_pcm_uframes_t bufsiz = 4 * METER_PERIOD;
+
+	snd_pcm_hw_params_get_channels_max (hwp, &m->n_chn);
+	if (m->format == SND_PCM_FORMAT_UNKNOWN
+	    || snd_pcm_hw_params_set_channels (m->pcm, hwp, m->n_chn) < 0
+	    || snd_pcm_hw_params_set_rate_near (m->pcm, hwp, &rate, NULL) < 0
+	    || snd_pcm_hw_params_set_period_size_near (m->pcm, hwp, &period, NULL) < 0
+	    || snd_pcm_hw_params_set_buffer_size_near (m->pcm, hwp, &bufsiz) < 0
+	    || (err = snd_pcm_hw_params (m->pcm, hwp)) < 0) {
+		fprintf (stderr, "Meters: cannot configure capture device %s\n", card);
+		snd_pcm_close (m->pcm);
+		m->pcm = NULL;
+		return -1;
+	}
+
+	m->rate    = rate;
+	m->period  = period;
+	m->n_met   = n_met < m->n_chn ? n_met : m->n_chn;
+	if (m->n_met > METER_MAX) {
+		m->n_met = METER_MAX;
+	}
+	m->stride  = (m->n_met + 3) & ~3;
+	m->n_bus   = n_bus < METER_BUS ? n_bus : METER_BUS;
+	m->bstride = (m->n_bus + 3) & ~3;
+	m->win_len = rate / METER_WIN_RATE;
+
+	m->raw    = malloc (period * m->n_chn * snd_pcm_format_physical_width (m->format) / 8);
+	m->buf    = (float*)calloc (period * m->stride, sizeof (float));
+	m->mixbuf = (float*)calloc (period * m->bstride, sizeof (float));
+
+	if (verbose) {
+		printf ("Meters: %s, %u/%u channels, %s, %u Hz, %lu frames/period\n",
+				card, m->n_met, m->n_chn, snd_pcm_format_name (m->format), rate, period);
+	}
+	return 0;
+}
+
+static int meter_start (RobTkApp* ui, unsigned int n_met, unsigned int n_bus)
+{
+	Meter* m = (Meter*)calloc (1, sizeof (Meter));
+
+	for (unsigned int c = 0; c < METER_CH; ++c) {
+		m->peak[c] = m->rms[c] = m->hold[c] = METER_FLOOR;
+	}
+	m->mix_dirty = true;
+
+	if (meter_open (m, ui->sm.card, n_met, n_bus)) {
+		free (m);
+		return -1;
+	}
+
+	m->run = true;
+	if (pthread_create (&m->thread, NULL, meter_thread, m)) {
+		fprintf (stderr, "Meters: cannot start capture thread\n");
+		snd_pcm_close (m->pcm);
+		free (m->raw);
+		free (m->buf);
+		free (m->mixbuf);
+		free (m);
+		return -1;
+	}
+	ui->meter = m;
+	return 0;
+}
+
+static void meter_stop (RobTkApp* ui)
+{
+	Meter* m = ui->meter;
+	if (!m) {
+		return;
+	}
+	/* the thread wakes up at least every METER_WAIT_MS */
+	if (m->run) {
+		m->run = false;
+		pthread_join (m->thread, NULL);
+	}
+	if (m->spec) {
+		spec_free (m->spec);
+	}
+	if (m->pcm) {
+		snd_pcm_close (m->pcm);
+	}
+	free (m->raw);
+	free (m->buf);
+	free (m->mixbuf);
+	free (m);
+	ui->meter = NULL;
+}
+
+/* the capture device re-appeared, the old PCM is unusable. The channel
+ * layout must not change, the GUI depends on it. Returns 0 when running */
+static int meter_reopen (RobTkApp* ui)
+{
+	Meter*    m = ui->meter;
+	Spectrum* s = m->spec;
+
+	/* the capture thread exits by itself when the PCM fails */
+	if (m->run) {
+		m->run = false;
+		pthread_join (m->thread, NULL);
+	}
+	if (s && s->run) {
+		s->run = false;
+		pthread_join (s->thread, NULL);
+	}
+	if (m->pcm) {
+		snd_pcm_close (m->pcm);
+		m->pcm = NULL;
+	}
+	free (m->raw);
+	free (m->buf);
+	free (m->mixbuf);
+	m->raw    = NULL;
+	m->buf    = NULL;
+	m->mixbuf = NULL;
+
+	/* open into a copy, the GUI keeps using the old layout on failure */
+	Meter t;
+	memset (&t, 0, sizeof (t));
+	if (meter_open (&t, ui->sm.card, m->n_met, m->n_bus)) {
+		return -1;
+	}
+	if (t.n_met != m->n_met || t.n_bus != m->n_bus || t.rate != m->rate) {
+		fprintf (stderr, "Meters: capture device %s has changed\n", ui->sm.card);
+		snd_pcm_close (t.pcm);
+		free (t.raw);
+		free (t.buf);
+		free (t.mixbuf);
+		return -1;
+	}
+
+	m->pcm     = t.pcm;
+	m->format  = t.format;
+	m->n_chn   = t.n_chn;
+	m->stride  = t.stride;
+	m->bstride = t.bstride;
+	m->period  = t.period;
+	m->win_len = t.win_len;
+	m->raw     = t.raw;
+	m->buf     = t.buf;
+	m->mixbuf  = t.mixbuf;
+
+	memset (m->win_peak, 0, sizeof (m->win_peak));
+	memset (m->win_sum, 0, sizeof (m->win_sum));
+	m->win_n     = 0;
+	m->mix_ack   = m->mix_cur;
+	m->mix_dirty = true;
+
+	m->run = true;
+	if (pthread_create (&m->thread, NULL, meter_thread, m)) {
+		fprintf (stderr, "Meters: cannot start capture thread\n");
+		m->run = false;
+		return -1;
+	}
+	if (s) {
+		s->run = true;
+		if (pthread_create (&s->thread, NULL, spec_thread, s)) {
+			fprintf (stderr, "Spectrum: cannot start analysis thread\n");
+			s->run = false;
+		}
+	}
+	return 0;
+}
+
+#define METER_REOPEN_TRIES 10
+
+/* called with `reconnected` once the mixer is back, retries until the
+ * capture device can be opened again */
+static void meter_reconnect (RobTkApp* ui, bool reconnected)
+{
+	Meter* m = ui->meter;
+	if (!m) {
+		return;
+	}
+	if (reconnected) {
+		m->reopen   = true;
+		m->n_reopen = 0;
+		m->retry    = 0;
+	}
+	const uint64_t now = monotonic_ms ();
+	if (!m->reopen || now < m->retry) {
+		return;
+	}
+	if (meter_reopen (ui) == 0) {
+		m->reopen = false;
+	} else if (++m->n_reopen >= METER_REOPEN_TRIES) {
+		fprintf (stderr, "Meters: giving up on capture device %s\n", ui->sm.card);
+		m->reopen = false;
+	} else {
+		m->retry = now + STATE_RETRY_MS;
+	}
+}
+
+/* GUI side, returns true if peaks were published since the last call */
+static bool meter_read (Meter* m, float* peak, float* rms)
+{
+	MeterShared* sh = &m->sh;
+	uint32_t seq, gen;
+	do {
+		seq = sh->seq;
+		__sync_synchronize ();
+		memcpy (peak, sh->peak, (m->stride + m->n_bus) * sizeof (float));
+		memcpy (rms, sh->rms, (m->stride + m->n_bus) * sizeof (float));
+		gen = sh->gen;
+		__sync_synchronize ();
+	} while ((seq & 1) || seq != sh->seq);
+
+	if (gen == sh->ack) {
+		return false;
+	}
+	sh->ack = gen;
+	return true;
+}
+
+static bool meter_enum_name (Mctrl* ctrl, int item, char* name, size_t len)
+{
+	return item > 0 && get_enum_item_name (ctrl, item, len, name) == 0;
+}
+
+/* GUI side, hand the current routing and gains to the capture thread.
+ * Matrix inputs are mapped to capture channels with the same source,
+ * other sources (e.g. PCM playback) cannot be estimated. */
+static void meter_mix_update (RobTkApp* ui)
+{
+	Meter* m = ui->meter;
+	char cap[METER_MAX][64];
+	char src[64];
+
+	if (m->n_bus == 0 || !m->mix_dirty || m->mix_ack != m->mix_cur) {
+		/* capture thread has not yet picked up the previous update */
+		return;
+	}
+	m->mix_dirty = false;
+
+	MeterMix* mx = &m->mix[m->mix_cur ^ 1];
+	memset (mx, 0, sizeof (MeterMix));
+
+	for (unsigned int k = 0; k < m->n_met; ++k) {
+		Mctrl* ctrl = src_sel (ui, k);
+		if (!meter_enum_name (ctrl, wq_get (ui, ctrl_id (ui, ctrl), CV_ENUM), cap[k], sizeof (cap[k]))) {
+			cap[k][0] = '\0';
+		}
+	}
+
+	for (unsigned int r = 0; r < ui->sm.device->smi; ++r) {
+		Mctrl* ctrl = matrix_sel (ui, r);
+		if (!meter_enum_name (ctrl, wq_get (ui, ctrl_id (ui, ctrl), CV_ENUM), src, sizeof (src))) {
+			continue;
+		}
+		unsigned int k;
+		for (k = 0; k < m->n_met; ++k) {
+			if (!strcmp (src, cap[k])) {
+				break;
+			}
+		}
+		if (k == m->n_met) {
+			continue;
+		}
+
+		unsigned int i;
+		for (i = 0; i < mx->n_in; ++i) {
+			if (mx->in[i] == k) {
+				break;
+			}
+		}
+		if (i == mx->n_in) {
+			mx->in[mx->n_in++] = k;
+		}
+
+		float* g = &mx->gain[i * m->bstride];
+		for (unsigned int b = 0; b < m->n_bus; ++b) {
+			const int32_t cdb = wq_get (ui, ctrl_id (ui, matrix_ctrl_cr (ui, b, r)), CV_DB);
+			if (cdb > -12800) {
+				g[b] += powf (10.f, cdb / 2000.f);
+			}
+		}
+	}
+
+	__sync_synchronize ();
+	m->mix_cur ^= 1;
+}
+
+/* *****************************************************************************
+ * Callbacks
+ */
+
+static bool cb_btn_reset (RobWidget* w, void* handle) {
+	RobTkApp* ui = (RobTkApp*)handle;
+	/* toggle all values (force change) */
+	pthread_mutex_lock (&ui->lock);
+
+	for (int r = 0; r < ui->sm.device->sin; ++r) {
+		Mctrl* sctrl = src_sel (ui, r);
+		int mcnt = get_enum_items (sctrl);
+		const int val = robtk_select_get_value (ui->src_sel[r]);
+		set_enum (sctrl, (val + 1) % mcnt);
+		set_enum (sctrl, val);
+	}
+	for (int r = 0; r < ui->sm.device->smi; ++r) {
+		Mctrl* sctrl = matrix_sel (ui, r);
+		int mcnt = get_enum_items (sctrl);
+		const int val = robtk_select_get_value (ui->mtx_sel[r]);
+		set_enum (sctrl, (val + 1) % mcnt);
+		set_enum (sctrl, val);
+	}
+	for (unsigned int o = 0; o < ui->sm.device->sout; ++o) {
+		Mctrl* sctrl = out_sel (ui, o);
+		int mcnt = get_enum_items (sctrl);
+		const int val = robtk_select_get_value (ui->out_sel[o]);
+		set_enum (sctrl, (val + 1) % mcnt);
+		set_enum (sctrl, val);
+	}
+
+	for (int r = 0; r < ui->sm.device->smi; ++r) {
+		for (unsigned int c = 0; c < ui->sm.device->smo; ++c) {
+			unsigned int n = r * ui->sm.device->smo + c;
+			Mctrl* ctrl = matrix_ctrl_cr (ui, c, r);
+			const float val = knob_to_db (robtk_dial_get_value (ui->mtx_gain[n]));
+			if (val == -128) {
+				set_dB (ctrl, 127);
+			} else {
+				set_dB (ctrl, -128);
+			}
+			set_dB (ctrl, val);
+		}
+	}
+	for (unsigned int n = 0; n < ui->sm.device->smst; ++n) {
+		Mctrl* ctrl = out_gain (ui, n);
+		const bool mute = robtk_dial_get_state (ui->out_gain[n]) == 1;
+		const float val = knob_to_db (robtk_dial_get_value (ui->out_gain[n]));
+		set_mute (ctrl, !mute);
+		set_mute (ctrl, mute);
+		if (val == -128) {
+			set_dB (ctrl, 127);
+		} else {
+			set_dB (ctrl, -128);
+		}
+		set_dB (ctrl, val);
+	}
+	pthread_mutex_unlock (&ui->lock);
+	return TRUE;
+}
+
+static bool cb_set_hiz (RobWidget* w, void* handle) {
 	RobTkApp* ui = (RobTkApp*)handle;
 	if (ui->disable_signals) return TRUE;
 	unsigned int n;
 	memcpy (&n, w->name, sizeof (unsigned int));
-	const float val = robtk_select_get_value (ui->mtx_sel[n]);
-	set_enum (matrix_sel (ui, n), val);
+	hist_begin (ui, ctrl_id (ui, hiz (ui, n)));
+	int val = robtk_cbtn_get_active (ui->btn_hiz[n]) ? 1 : 0;
+	wq_push (ui, hiz (ui, n), CV_ENUM, val);
 	return TRUE;
 }
 
-static bool cb_mtx_gain (RobWidget* w, void* handle) {
+static bool cb_set_pad (RobWidget* w, void* handle) {
+	RobTkApp* ui = (RobTkApp*)handle;
+	if (ui->disable_signals) return TRUE;
+	unsigned int n;
+	memcpy (&n, w->name, sizeof (unsigned int));
+	hist_begin (ui, ctrl_id (ui, pad (ui, n)));
+	int val = robtk_cbtn_get_active (ui->btn_pad[n]) ? 1 : 0;
+	wq_push (ui, pad (ui, n), CV_ENUM, val);
+	return TRUE;
+}
+
+static bool cb_src_sel (RobWidget* w, void* handle) {
+	RobTkApp* ui = (RobTkApp*)handle;
+	if (ui->disable_signals) return TRUE;
+	unsigned int n;
+	memcpy (&n, w->name, sizeof (unsigned int));
+	hist_begin (ui, ctrl_id (ui, src_sel (ui, n)));
+	const int val = robtk_select_get_value (ui->src_sel[n]);
+	wq_push (ui, src_sel (ui, n), CV_ENUM, val);
+	return TRUE;
+}
+
+static bool cb_mtx_src (RobWidget* w, void* handle) {
 	RobTkApp* ui = (RobTkApp*)handle;
+	if (ui->disable_signals) return TRUE;
 	unsigned int n;
 	memcpy (&n, w->name, sizeof (unsigned int));
+	hist_begin (ui, ctrl_id (ui, matrix_sel (ui, n)));
+	const int val = robtk_select_get_value (ui->mtx_sel[n]);
+	wq_push (ui, matrix_sel (ui, n), CV_ENUM, val);
+	return TRUE;
+}
+
+static void mtx_gain_click_state (RobTkApp* ui, unsigned int n) {
 	const float val = knob_to_db (robtk_dial_get_value (ui->mtx_gain[n]));
 	if (val == -128) {
 		ui->mtx_gain[n]->click_state = 1;
@@ -735,40 +5510,172 @@ static bool cb_mtx_gain (RobWidget* w, void* handle) {
 	} else {
 		ui->mtx_gain[n]->click_state = 0;
 	}
+}
+
+static bool cb_mtx_gain (RobWidget* w, void* handle) {
+	RobTkApp* ui = (RobTkApp*)handle;
+	unsigned int n;
+	memcpy (&n, w->name, sizeof (unsigned int));
+	const float val = knob_to_db (robtk_dial_get_value (ui->mtx_gain[n]));
+	mtx_gain_click_state (ui, n);
+	if (ui->disable_signals) return TRUE;
+	Mctrl* ctrl = matrix_ctrl_n (ui, n);
+	hist_begin (ui, ctrl_id (ui, ctrl));
+	const float delta = val - wq_get (ui, ctrl_id (ui, ctrl), CV_DB) / 100.f;
+	wq_push_dB (ui, ctrl, val);
+	gang_mtx_gain (ui, n, val, delta);
+	return TRUE;
+}
+
+static bool cb_out_src (RobWidget* w, void* handle) {
+	RobTkApp* ui = (RobTkApp*)handle;
+	if (ui->disable_signals) return TRUE;
+	unsigned int n;
+	memcpy (&n, w->name, sizeof (unsigned int));
+	hist_begin (ui, ctrl_id (ui, out_sel (ui, n)));
+	const int val = robtk_select_get_value (ui->out_sel[n]);
+	wq_push (ui, out_sel (ui, n), CV_ENUM, val);
+	return TRUE;
+}
+
+static bool cb_out_gain (RobWidget* w, void* handle) {
+	RobTkApp* ui = (RobTkApp*)handle;
+	if (ui->disable_signals) return TRUE;
+	unsigned int n;
+	memcpy (&n, w->name, sizeof (unsigned int));
+	const bool mute = robtk_dial_get_state (ui->out_gain[n]) == 1;
+	const float val = knob_to_db (robtk_dial_get_value (ui->out_gain[n]));
+	Mctrl* ctrl = out_gain (ui, n);
+	hist_begin (ui, ctrl_id (ui, ctrl));
+	const float delta = val - wq_get (ui, ctrl_id (ui, ctrl), CV_DB) / 100.f;
+	wq_push (ui, ctrl, CV_MUTE, mute ? 1 : 0);
+	wq_push_dB (ui, ctrl, val);
+	gang_out_gain (ui, n, mute, val, delta);
+	return TRUE;
+}
+
+static bool cb_mst_gain (RobWidget* w, void* handle) {
+	RobTkApp* ui = (RobTkApp*)handle;
+	if (ui->disable_signals) return TRUE;
+	const bool mute = robtk_dial_get_state (ui->mst_gain) == 1;
+	const float val = robtk_dial_get_value (ui->mst_gain);
+	hist_begin (ui, ctrl_id (ui, mst_gain (ui)));
+	wq_push (ui, mst_gain (ui), CV_MUTE, mute ? 1 : 0);
+	wq_push_dB (ui, mst_gain (ui), knob_to_db (val));
+	return TRUE;
+}
+
+static bool cb_btn_panic (RobWidget* w, void* handle) {
+	RobTkApp* ui = (RobTkApp*)handle;
+	pthread_mutex_lock (&ui->lock);
+	panic_mute (ui);
+	pthread_mutex_unlock (&ui->lock);
+	return TRUE;
+}
+
+static bool cb_btn_dim (RobWidget* w, void* handle) {
+	RobTkApp* ui = (RobTkApp*)handle;
+	if (ui->disable_signals) return TRUE;
+	pthread_mutex_lock (&ui->lock);
+	dim_master (ui, robtk_cbtn_get_active (ui->btn_dim));
+	pthread_mutex_unlock (&ui->lock);
+	return TRUE;
+}
+
+static bool cb_btn_hud (RobWidget* w, void* handle) {
+	RobTkApp* ui = (RobTkApp*)handle;
+	cairo_rectangle_t a;
+	ui->perf.on = robtk_cbtn_get_active (ui->btn_hud);
+	hud_area (ui, &a);
+	queue_draw_area (ui->rw, a.x, a.y, a.width, a.height);
+	return TRUE;
+}
+
+static bool cb_btn_recall (RobWidget* w, void* handle) {
+	RobTkApp* ui = (RobTkApp*)handle;
+	bank_recall (ui, robtk_select_get_value (ui->preset_sel));
+	return TRUE;
+}
+
+static bool cb_btn_store (RobWidget* w, void* handle) {
+	RobTkApp* ui = (RobTkApp*)handle;
+	bank_store (ui, robtk_select_get_value (ui->preset_sel), NULL);
+	return TRUE;
+}
+
+static bool cb_cue_sel (RobWidget* w, void* handle) {
+	RobTkApp* ui = (RobTkApp*)handle;
 	if (ui->disable_signals) return TRUE;
-	set_dB (matrix_ctrl_n (ui, n), val);
+	solo_clear (ui);
+	ui->cue_out = robtk_select_get_value (ui->cue_sel);
+	return TRUE;
+}
+
+static bool cb_btn_unsolo (RobWidget* w, void* handle) {
+	RobTkApp* ui = (RobTkApp*)handle;
+	solo_pop (ui);
+	return TRUE;
+}
+
+static bool cb_btn_go (RobWidget* w, void* handle) {
+	RobTkApp* ui = (RobTkApp*)handle;
+	cue_go (ui);
 	return TRUE;
 }
 
-static bool cb_out_src (RobWidget* w, void* handle) {
+/* items of the matrix operation selector, see cb_btn_mtx_op() */
+static const struct {
+	const char* label;
+	int         op; //< MtxOpType
+	float       dB;
+} mtx_op_items[] = {
+	{ "Clear",     MTX_CLEAR,    0.f },
+	{ "Identity",  MTX_IDENTITY, 0.f },
+	{ "Copy",      MTX_COPY,     0.f },
+	{ "Trim -3dB", MTX_TRIM,    -3.f },
+	{ "Trim +3dB", MTX_TRIM,     3.f },
+	{ "Swap",      MTX_SWAP,     0.f },
+};
+
+/* the argument selectors list the mix-busses followed by the matrix inputs */
+static bool cb_btn_mtx_op (RobWidget* w, void* handle) {
 	RobTkApp* ui = (RobTkApp*)handle;
-	if (ui->disable_signals) return TRUE;
-	unsigned int n;
-	memcpy (&n, w->name, sizeof (unsigned int));
-	const float val = robtk_select_get_value (ui->out_sel[n]);
-	set_enum (out_sel (ui, n), val);
+	const int smo = ui->sm.device->smo;
+	const int a   = robtk_select_get_value (ui->mtx_a_sel);
+	const int b   = robtk_select_get_value (ui->mtx_b_sel);
+	MtxOp op;
+	memset (&op, 0, sizeof (MtxOp));
+	op.op = mtx_op_items[robtk_select_get_value (ui->mtx_op_sel)].op;
+	op.dB = mtx_op_items[robtk_select_get_value (ui->mtx_op_sel)].dB;
+	switch (op.op) {
+		case MTX_COPY:
+		case MTX_TRIM:
+			op.a = a;
+			op.b = b;
+			break;
+		case MTX_SWAP:
+			op.a = a - smo;
+			op.b = b - smo;
+			break;
+		default:
+			break;
+	}
+	if (mtx_op (ui, &op)) {
+		fprintf (stderr, "Matrix: %s needs %s\n", mtx_op_items[robtk_select_get_value (ui->mtx_op_sel)].label,
+				op.op == MTX_SWAP ? "two inputs" : "mix-busses");
+	}
 	return TRUE;
 }
 
-static bool cb_out_gain (RobWidget* w, void* handle) {
+static bool cb_btn_undo (RobWidget* w, void* handle) {
 	RobTkApp* ui = (RobTkApp*)handle;
-	if (ui->disable_signals) return TRUE;
-	unsigned int n;
-	memcpy (&n, w->name, sizeof (unsigned int));
-	const bool mute = robtk_dial_get_state (ui->out_gain[n]) == 1;
-	const float val = robtk_dial_get_value (ui->out_gain[n]);
-	set_mute (out_gain (ui, n), mute);
-	set_dB (out_gain (ui, n), knob_to_db (val));
+	hist_undo (ui);
 	return TRUE;
 }
 
-static bool cb_mst_gain (RobWidget* w, void* handle) {
+static bool cb_btn_redo (RobWidget* w, void* handle) {
 	RobTkApp* ui = (RobTkApp*)handle;
-	if (ui->disable_signals) return TRUE;
-	const bool mute = robtk_dial_get_state (ui->mst_gain) == 1;
-	const float val = robtk_dial_get_value (ui->mst_gain);
-	set_mute (mst_gain (ui), mute);
-	set_dB (mst_gain (ui), knob_to_db (val));
+	hist_redo (ui);
 	return TRUE;
 }
 
@@ -776,19 +5683,43 @@ static bool cb_mst_gain (RobWidget* w, void* handle) {
  * GUI Helpers
  */
 
-static void set_select_values (RobTkSelect* s,  Mctrl* ctrl)
+/* enum item names are queried from the device one-by-one.
+ * All selectors of a given kind share the same list, so
+ * only read it once per kind.
+ */
+typedef struct {
+	int   cnt;
+	char (*name)[64];
+} EnumNames;
+
+static void enum_names_free (EnumNames* en)
+{
+	free (en->name);
+	en->name = NULL;
+	en->cnt  = 0;
+}
+
+static void set_select_values (RobTkSelect* s, Mctrl* ctrl, EnumNames* en)
 {
 	if (!ctrl) return;
 	assert (ctrl);
-	int mcnt = snd_mixer_selem_get_enum_items (ctrl->elem);
+	int mcnt = get_enum_items (ctrl);
+	if (en->cnt != mcnt) {
+		enum_names_free (en);
+		en->name = (char (*)[64])calloc (mcnt, sizeof (char[64]));
+		en->cnt  = mcnt;
+		for (int i = 0; i < mcnt; ++i) {
+			if (get_enum_item_name (ctrl, i, 63, en->name[i]) < 0) {
+				en->name[i][0] = '\0';
+			}
+		}
+	}
 	for (int i = 0; i < mcnt; ++i) {
-		char name[64];
-		if (snd_mixer_selem_get_enum_item_name (ctrl->elem, i, sizeof (name) - 1, name) < 0) {
+		if (en->name[i][0] == '\0') {
 			continue;
 		}
-		robtk_select_add_item (s, i, name);
+		robtk_select_add_item (s, i, en->name[i]);
 	}
-	robtk_select_set_value (s, get_enum (ctrl));
 }
 
 static void dial_annotation_db (RobTkDial* d, cairo_t* cr, void* data)
@@ -796,6 +5727,7 @@ static void dial_annotation_db (RobTkDial* d, cairo_t* cr, void* data)
 	RobTkApp* ui = (RobTkApp*)data;
 	char txt[16];
 	snprintf (txt, 16, "%+3.0fdB", knob_to_db (d->cur));
+	TRACE_BEGIN ("dial_annotation_db");
 
 	int tw, th;
 	cairo_save (cr);
@@ -813,6 +5745,7 @@ static void dial_annotation_db (RobTkDial* d, cairo_t* cr, void* data)
 	g_object_unref (pl);
 	cairo_restore (cr);
 	cairo_new_path (cr);
+	TRACE_END ("dial_annotation_db");
 }
 
 static void create_faceplate (RobTkApp *ui) {
@@ -925,30 +5858,397 @@ static RobWidget* robtk_dial_mouse_intercept (RobWidget* handle, RobTkBtnEvent *
 	RobTkApp* ui = (RobTkApp*)d->handle;
 	if (!d->sensitive) { return NULL; }
 
+	if (ev->button == 2 && (ev->state & (ROBTK_MOD_CTRL | ROBTK_MOD_SHIFT))) {
+		/* ctrl + middle-click: solo matrix input, shift + middle-click: solo mix-bus */
+		unsigned int n;
+		memcpy (&n, d->rw->name, sizeof (unsigned int));
+		if (ev->state & ROBTK_MOD_CTRL) {
+			solo_push (ui, SOLO_ROW, n / ui->sm.device->smo);
+		} else {
+			solo_push (ui, SOLO_BUS, n % ui->sm.device->smo);
+		}
+		return handle;
+	}
+
 	if (ev->button == 2) {
 		/* middle-click exclusively assign output */
 		unsigned int n;
 		memcpy (&n, d->rw->name, sizeof (unsigned int));
 
-		unsigned c = n % ui->device->smo;
-		unsigned r = n / ui->device->smo;
-		for (uint32_t i = 0; i < ui->device->smo; ++i) {
-			unsigned int nn = r * ui->device->smo + i;
-			if (i == c) {
-				if (d->cur == 0) {
-					robtk_dial_set_value (ui->mtx_gain[nn], db_to_knob (0));
-				} else {
-					robtk_dial_set_value (ui->mtx_gain[nn], 0);
-				}
-			} else {
-				robtk_dial_set_value (ui->mtx_gain[nn], 0);
-			}
+		const unsigned int smo = ui->sm.device->smo;
+		unsigned c = n % smo;
+		unsigned r = n / smo;
+
+		MtxState ms;
+		hist_begin (ui, -1);
+		mtx_state_init (ui, &ms);
+		for (uint32_t i = 0; i < smo; ++i) {
+			ms.gain[r * smo + i] = (i == c && d->cur == 0) ? 0.f : -128.f;
 		}
+		mtx_state_apply (ui, &ms);
+		mtx_state_free (&ms);
 		return handle;
 	}
 	return robtk_dial_mousedown (handle, ev);
 }
 
+/* *****************************************************************************
+ * Spectrum display
+ */
+
+static float spec_x (float hz, float fmax, int w)
+{
+	return w * logf (hz / SPEC_FMIN) / logf (fmax / SPEC_FMIN);
+}
+
+static float spec_y (float db, int h)
+{
+	if (db < SPEC_FLOOR) db = SPEC_FLOOR;
+	if (db > 0.f) db = 0.f;
+	return h * db / SPEC_FLOOR;
+}
+
+/* GUI side, returns true if a new spectrum was published */
+static bool spec_read (Spectrum* s, float* band, float* hz, float* db)
+{
+	SpecShared* sh = &s->sh;
+	uint32_t seq, gen;
+	do {
+		seq = sh->seq;
+		__sync_synchronize ();
+		memcpy (band, sh->band, SPEC_BANDS * sizeof (float));
+		*hz = sh->peak_hz;
+		*db = sh->peak_db;
+		gen = sh->gen;
+		__sync_synchronize ();
+	} while ((seq & 1) || seq != sh->seq);
+
+	if (gen == s->gen) {
+		return false;
+	}
+	s->gen = gen;
+	return true;
+}
+
+/* called at METER_FPS from meter_update () */
+static void spec_update (RobTkApp* ui, float dt)
+{
+	Spectrum* s = ui->meter->spec;
+	float band[SPEC_BANDS];
+	float hz, db;
+	if (s->chn < 0) {
+		return;
+	}
+	const bool fresh = spec_read (s, band, &hz, &db);
+	const float fall = SPEC_FALLOFF * (dt < 1.f ? dt : 1.f);
+	bool changed = false;
+	for (unsigned int i = 0; i < SPEC_BANDS; ++i) {
+		const float v = fresh && band[i] > s->disp[i] - fall ? band[i] : s->disp[i] - fall;
+		const float d = v > SPEC_FLOOR ? v : SPEC_FLOOR;
+		if (d != s->disp[i]) {
+			s->disp[i] = d;
+			changed = true;
+		}
+	}
+	if (fresh) {
+		s->peak_hz = hz;
+		s->peak_db = db;
+	}
+	if (changed) {
+		queue_draw (ui->spec_rw);
+	}
+}
+
+static void spec_text (RobTkApp* ui, cairo_t* cr, float x, float y, const char* txt)
+{
+	int tw, th;
+	PangoLayout* pl = pango_cairo_create_layout (cr);
+	pango_layout_set_font_description (pl, ui->font);
+	pango_layout_set_text (pl, txt, -1);
+	pango_layout_get_pixel_size (pl, &tw, &th);
+	cairo_move_to (cr, x, y);
+	pango_cairo_show_layout (cr, pl);
+	g_object_unref (pl);
+}
+
+/* background and grid, re-created when the size changes */
+static void spec_grid (RobTkApp* ui, Spectrum* s, int w, int h)
+{
+	static const float grid_hz[] = { 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000 };
+	const float fmax = .5f * s->rate;
+	char txt[16];
+
+	if (s->grid) {
+		cairo_surface_destroy (s->grid);
+	}
+	s->grid = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, w, h);
+	s->w = w;
+	s->h = h;
+
+	cairo_t* cr = cairo_create (s->grid);
+	cairo_set_source_rgb (cr, .1, .1, .1);
+	rounded_rectangle (cr, 0, 0, w, h, 4);
+	cairo_fill (cr);
+
+	cairo_set_line_width (cr, 1.0);
+	cairo_set_source_rgba (cr, .5, .5, .5, .5);
+	for (int db = -20; db > SPEC_FLOOR; db -= 20) {
+		const float y = rintf (spec_y (db, h)) + .5f;
+		cairo_move_to (cr, 0, y);
+		cairo_line_to (cr, w, y);
+		snprintf (txt, sizeof (txt), "%d", db);
+		spec_text (ui, cr, 2, y, txt);
+	}
+	for (unsigned int i = 0; i < sizeof (grid_hz) / sizeof (float) && grid_hz[i] < fmax; ++i) {
+		const float x = rintf (spec_x (grid_hz[i], fmax, w)) + .5f;
+		cairo_move_to (cr, x, 0);
+		cairo_line_to (cr, x, h);
+		if (grid_hz[i] >= 1000) {
+			snprintf (txt, sizeof (txt), "%.0fk", grid_hz[i] / 1000);
+		} else {
+			snprintf (txt, sizeof (txt), "%.0f", grid_hz[i]);
+		}
+		spec_text (ui, cr, x + 2, h - 12, txt);
+	}
+	cairo_stroke (cr);
+	cairo_destroy (cr);
+}
+
+static bool spec_expose_event (RobWidget* rw, cairo_t* cr, cairo_rectangle_t* ev)
+{
+	RobTkApp* ui = (RobTkApp*)GET_HANDLE (rw);
+	Spectrum* s = ui->meter->spec;
+	const int w = rw->area.width;
+	const int h = rw->area.height;
+	char txt[64];
+
+	TRACE_BEGIN ("spec_expose_event");
+	if (!s->grid || s->w != w || s->h != h) {
+		spec_grid (ui, s, w, h);
+	}
+
+	cairo_rectangle (cr, ev->x, ev->y, ev->width, ev->height);
+	cairo_clip (cr);
+	cairo_set_source_surface (cr, s->grid, 0, 0);
+	cairo_paint (cr);
+
+	if (s->chn < 0) {
+		CairoSetSouerceRGBA (c_wht);
+		spec_text (ui, cr, w / 2 - 120, h / 2 - 6, "Click an input meter to analyze its spectrum");
+		TRACE_END ("spec_expose_event");
+		return TRUE;
+	}
+
+	/* one path: bands as steps, closed at the bottom */
+	const float bw = w / (float)SPEC_BANDS;
+	cairo_move_to (cr, 0, h);
+	for (unsigned int i = 0; i < SPEC_BANDS; ++i) {
+		const float y = spec_y (s->disp[i], h);
+		cairo_line_to (cr, i * bw, y);
+		cairo_line_to (cr, (i + 1) * bw, y);
+	}
+	cairo_line_to (cr, w, h);
+	cairo_close_path (cr);
+	cairo_set_source_rgba (cr, .2, .7, .2, .5);
+	cairo_fill_preserve (cr);
+	cairo_set_line_width (cr, 1.0);
+	cairo_set_source_rgb (cr, .2, .8, .2);
+	cairo_stroke (cr);
+
+	if (s->peak_db > SPEC_FLOOR) {
+		snprintf (txt, sizeof (txt), "Input %d  peak %.0f Hz  %.1f dBFS", s->chn + 1, s->peak_hz, s->peak_db);
+	} else {
+		snprintf (txt, sizeof (txt), "Input %d", s->chn + 1);
+	}
+	CairoSetSouerceRGBA (c_wht);
+	spec_text (ui, cr, w - 230, 2, txt);
+	TRACE_END ("spec_expose_event");
+	return TRUE;
+}
+
+static void spec_size_request (RobWidget* rw, int* w, int* h)
+{
+	*w = 2 * SPEC_BANDS;
+	*h = SPEC_H;
+}
+
+static void spec_size_allocate (RobWidget* rw, int w, int h)
+{
+	robwidget_set_size (rw, w, SPEC_H);
+}
+
+/* click on an input meter selects the analyzed channel, again disables */
+static RobWidget* spec_meter_mousedown (RobWidget* rw, RobTkBtnEvent* ev)
+{
+	RobTkApp* ui = (RobTkApp*)GET_HANDLE (rw);
+	Spectrum* s = ui->meter->spec;
+	unsigned int c;
+	memcpy (&c, rw->name, sizeof (unsigned int));
+	if (ev->button != 1) {
+		return NULL;
+	}
+	const int prev = s->chn;
+	s->chn = prev == (int)c ? -1 : (int)c;
+	for (unsigned int i = 0; i < SPEC_BANDS; ++i) {
+		s->disp[i] = SPEC_FLOOR;
+	}
+	s->peak_db = SPEC_FLOOR;
+	if (prev >= 0 && ui->meter_rw[prev]) {
+		queue_draw (ui->meter_rw[prev]);
+	}
+	queue_draw (rw);
+	queue_draw (ui->spec_rw);
+	return NULL;
+}
+
+static RobWidget* spec_widget_new (RobTkApp* ui)
+{
+	RobWidget* rw = robwidget_new (ui);
+	robwidget_set_expose_event (rw, spec_expose_event);
+	robwidget_set_size_request (rw, spec_size_request);
+	robwidget_set_size_allocate (rw, spec_size_allocate);
+	return rw;
+}
+
+/* *****************************************************************************
+ * Meter display
+ */
+
+static float meter_deflect (float db)
+{
+	if (db <= METER_FLOOR) return 0.f;
+	if (db >= 0.f) return 1.f;
+	return 1.f - db / METER_FLOOR;
+}
+
+static float meter_db (float sq)
+{
+	return sq > 1e-12f ? 10.f * log10f (sq) : -120.f;
+}
+
+static void meter_update (RobTkApp* ui)
+{
+	Meter* m = ui->meter;
+	const uint64_t now = monotonic_ms ();
+	const float dt = (now - m->last_draw) / 1000.f;
+	const float fall = METER_FALLOFF * (dt < 1.f ? dt : 1.f);
+	float peak[METER_CH];
+	float rms[METER_CH];
+
+	if (now - m->last_draw < 1000 / METER_FPS) {
+		return;
+	}
+	m->last_draw = now;
+
+	meter_mix_update (ui);
+
+	const bool fresh = meter_read (m, peak, rms);
+
+	for (unsigned int c = 0; c < m->stride + m->n_bus; ++c) {
+		RobWidget* rw = c < m->n_met ? ui->meter_rw[c] : c >= m->stride ? ui->bus_rw[c - m->stride] : NULL;
+		if (!rw) {
+			continue;
+		}
+
+		const float pk_prev = m->peak[c];
+		const float rms_prev = m->rms[c];
+		const float hold_prev = m->hold[c];
+
+		const float pk = fresh ? meter_db (peak[c]) : METER_FLOOR;
+		const float r  = fresh ? meter_db (rms[c]) : METER_FLOOR;
+		m->peak[c] = pk > pk_prev - fall ? pk : pk_prev - fall;
+		m->rms[c]  = r > rms_prev - fall ? r : rms_prev - fall;
+
+		if (pk >= m->hold[c]) {
+			m->hold[c] = pk;
+			m->hold_time[c] = now;
+		} else if (now - m->hold_time[c] > METER_HOLD_MS) {
+			m->hold[c] = m->peak[c];
+		}
+
+		if (rintf (METER_W * meter_deflect (pk_prev)) != rintf (METER_W * meter_deflect (m->peak[c]))
+		    || rintf (METER_W * meter_deflect (rms_prev)) != rintf (METER_W * meter_deflect (m->rms[c]))
+		    || rintf (METER_W * meter_deflect (hold_prev)) != rintf (METER_W * meter_deflect (m->hold[c]))) {
+			queue_draw (rw);
+		}
+	}
+
+	if (m->spec) {
+		spec_update (ui, dt);
+	}
+}
+
+static bool meter_expose_event (RobWidget* rw, cairo_t* cr, cairo_rectangle_t* ev)
+{
+	RobTkApp* ui = (RobTkApp*)GET_HANDLE (rw);
+	Meter* m = ui->meter;
+	unsigned int c;
+	memcpy (&c, rw->name, sizeof (unsigned int));
+
+	const float y0 = rintf ((rw->area.height - METER_H) * .5f);
+	TRACE_BEGIN ("meter_expose_event");
+
+	cairo_rectangle (cr, ev->x, ev->y, ev->width, ev->height);
+	cairo_clip (cr);
+
+	cairo_set_source_rgb (cr, .1, .1, .1);
+	rounded_rectangle (cr, 0, y0, METER_W, METER_H, 2);
+	cairo_fill (cr);
+
+	const float xr = rintf (METER_W * meter_deflect (m->rms[c]));
+	const float xp = rintf (METER_W * meter_deflect (m->peak[c]));
+	const float xh = rintf (METER_W * meter_deflect (m->hold[c]));
+
+	cairo_set_source_rgba (cr, .2, .7, .2, .5);
+	cairo_rectangle (cr, 0, y0, xp, METER_H);
+	cairo_fill (cr);
+
+	cairo_set_source_rgb (cr, .2, .8, .2);
+	cairo_rectangle (cr, 0, y0 + 2, xr, METER_H - 4);
+	cairo_fill (cr);
+
+	if (xh > 0) {
+		if (m->hold[c] >= -.1f) {
+			cairo_set_source_rgb (cr, .9, .1, .1);
+		} else {
+			cairo_set_source_rgb (cr, .8, .8, .8);
+		}
+		cairo_rectangle (cr, xh - 2, y0, 2, METER_H);
+		cairo_fill (cr);
+	}
+
+	if (m->spec && m->spec->chn == (int)c) {
+		/* analyzed channel */
+		cairo_set_line_width (cr, 1.0);
+		cairo_set_source_rgb (cr, .9, .9, .2);
+		rounded_rectangle (cr, .5, y0 + .5, METER_W - 1, METER_H - 1, 2);
+		cairo_stroke (cr);
+	}
+	TRACE_END ("meter_expose_event");
+	return TRUE;
+}
+
+static void meter_size_request (RobWidget* rw, int* w, int* h)
+{
+	*w = METER_W;
+	*h = METER_H;
+}
+
+static void meter_size_allocate (RobWidget* rw, int w, int h)
+{
+	robwidget_set_size (rw, METER_W, h);
+}
+
+static RobWidget* meter_widget_new (RobTkApp* ui, unsigned int c)
+{
+	RobWidget* rw = robwidget_new (ui);
+	memcpy (rw->name, &c, sizeof (unsigned int));
+	robwidget_set_expose_event (rw, meter_expose_event);
+	robwidget_set_size_request (rw, meter_size_request);
+	robwidget_set_size_allocate (rw, meter_size_allocate);
+	return rw;
+}
+
 /* *****************************************************************************
  * GUI
  */
@@ -957,39 +6257,58 @@ static RobWidget* toplevel (RobTkApp* ui, void* const top) {
 	ui->rw = rob_vbox_new (FALSE, 2);
 	robwidget_make_toplevel (ui->rw, top);
 
+	TRACE_BEGIN ("create_faceplate");
 	create_faceplate (ui);
+	TRACE_END ("create_faceplate");
 	ui->font = pango_font_description_from_string ("Mono 9px");
 
 	/* device dependent construction */
-	ui->mtx_sel = malloc (ui->device->sin * sizeof (RobTkSelect *));
-	ui->mtx_gain = malloc (ui->device->smi * ui->device->smo * sizeof (RobTkDial *));
-	ui->mtx_lbl = malloc (ui->device->smo * sizeof (RobTkLbl *));
+	ui->mtx_sel = malloc (ui->sm.device->sin * sizeof (RobTkSelect *));
+	ui->mtx_gain = malloc (ui->sm.device->smi * ui->sm.device->smo * sizeof (RobTkDial *));
+	ui->mtx_lbl = malloc (ui->sm.device->smo * sizeof (RobTkLbl *));
 
-	ui->src_lbl = malloc (ui->device->sin * sizeof (RobTkLbl *));
-	ui->src_sel = malloc (ui->device->sin * sizeof (RobTkSelect *));
+	ui->src_lbl = malloc (ui->sm.device->sin * sizeof (RobTkLbl *));
+	ui->src_sel = malloc (ui->sm.device->sin * sizeof (RobTkSelect *));
+	ui->meter_rw = calloc (ui->sm.device->sin, sizeof (RobWidget *));
+	ui->bus_rw = calloc (ui->sm.device->smo, sizeof (RobWidget *));
 
-	ui->out_lbl = malloc (ui->device->smst * sizeof (RobTkLbl *));
-	ui->out_sel = malloc (ui->device->sout * sizeof (RobTkSelect *));
-	ui->out_gain = malloc (ui->device->smst * sizeof (RobTkDial *));
+	ui->out_lbl = malloc (ui->sm.device->smst * sizeof (RobTkLbl *));
+	ui->out_sel = malloc (ui->sm.device->sout * sizeof (RobTkSelect *));
+	ui->out_gain = malloc (ui->sm.device->smst * sizeof (RobTkDial *));
 
 
-	if (ui->device->num_hiz > 0) {
-		ui->btn_hiz = malloc (ui->device->num_hiz * sizeof (RobTkCBtn *));
+	if (ui->sm.device->num_hiz > 0) {
+		ui->btn_hiz = malloc (ui->sm.device->num_hiz * sizeof (RobTkCBtn *));
 	} else {
 		ui->btn_hiz = NULL;
 	}
-	if  (ui->device->num_pad > 0) {
-		ui->btn_pad = malloc (ui->device->num_pad * sizeof (RobTkCBtn *));
+	if  (ui->sm.device->num_pad > 0) {
+		ui->btn_pad = malloc (ui->sm.device->num_pad * sizeof (RobTkCBtn *));
 	} else {
 		ui->btn_pad = NULL;
 	}
 
-	const int c0 = 4; // matrix column offset
-	const int rb = 2 + ui->device->smi; // matrix bottom
+	EnumNames en_src = { 0, NULL };
+	EnumNames en_mtx = { 0, NULL };
+	EnumNames en_out = { 0, NULL };
+
+	const int c0 = ui->meter ? 5 : 4; // matrix column offset
+	const int rb = 2 + ui->sm.device->smi; // matrix bottom
 
 	/* table layout. NB: these are min sizes, table grows if needed */
-	ui->matrix = rob_table_new (/*rows*/rb, /*cols*/ 5 + ui->device->smo, FALSE);
-	ui->output = rob_table_new (/*rows*/4,  /*cols*/ 2 + 3 * ui->device->smst, FALSE);
+	ui->matrix = rob_table_new (/*rows*/rb, /*cols*/ 5 + ui->sm.device->smo, FALSE);
+
+	/* outputs are laid out in blocks of four rows: label, gain, left and
+	 * right selector. Blocks are balanced, Hi-Z and Pads go below. */
+	unsigned int n_pairs = (ui->sm.device->sout + 1) / 2;
+	if (n_pairs < ui->sm.device->smst) {
+		n_pairs = ui->sm.device->smst;
+	}
+	const unsigned int n_blk  = n_pairs > 0 ? (n_pairs + OUT_COLS - 1) / OUT_COLS : 1;
+	const unsigned int o_cols = n_pairs > 0 ? (n_pairs + n_blk - 1) / n_blk : 1;
+	const unsigned int sw_row = 4 * n_blk - 1;
+
+	ui->output = rob_table_new (/*rows*/sw_row + 2,  /*cols*/ 2 + 3 * o_cols, FALSE);
 
 	/* headings */
 	ui->heading[0]  = robtk_lbl_new ("Capture");
@@ -997,10 +6316,10 @@ static RobWidget* toplevel (RobTkApp* ui, void* const top) {
 	ui->heading[1]  = robtk_lbl_new ("Source");
 	rob_table_attach (ui->matrix, robtk_lbl_widget (ui->heading[1]), c0, c0 + 1, 0, 1, 2, 6, RTK_SHRINK, RTK_SHRINK);
 	ui->heading[2]  = robtk_lbl_new ("Matrix Mixer");
-	rob_table_attach (ui->matrix, robtk_lbl_widget (ui->heading[2]), c0 + 1, c0 + 1 + ui->device->smo, 0, 1, 2, 6, RTK_SHRINK, RTK_SHRINK);
+	rob_table_attach (ui->matrix, robtk_lbl_widget (ui->heading[2]), c0 + 1, c0 + 1 + ui->sm.device->smo, 0, 1, 2, 6, RTK_SHRINK, RTK_SHRINK);
 
 	/* input selectors */
-	for (unsigned r = 0; r < ui->device->sin; ++r) {
+	for (unsigned r = 0; r < ui->sm.device->sin; ++r) {
 		char txt[8];
 		sprintf (txt, "%d", r + 1);
 		ui->src_lbl[r] = robtk_lbl_new (txt);
@@ -1008,14 +6327,23 @@ static RobWidget* toplevel (RobTkApp* ui, void* const top) {
 
 		ui->src_sel[r] = robtk_select_new ();
 		Mctrl* sctrl = src_sel (ui, r);
-		int mcnt = snd_mixer_selem_get_enum_items (sctrl->elem);
-		set_select_values (ui->src_sel[r], sctrl);
+		int mcnt = get_enum_items (sctrl);
+		set_select_values (ui->src_sel[r], sctrl, &en_src);
 		robtk_select_set_default_item (ui->src_sel[r], src_sel_default (r, mcnt));
 		robtk_select_set_callback (ui->src_sel[r], cb_src_sel, ui);
+		robtk_select_set_sensitive (ui->src_sel[r], false);
 
 		rob_table_attach (ui->matrix, robtk_select_widget (ui->src_sel[r]), 2, 3, r + 1, r + 2, 2, 2, RTK_SHRINK, RTK_SHRINK);
 		// hack alert, abusing the name filed -- should add a .data field to Robwidget
 		memcpy (ui->src_sel[r]->rw->name, &r, sizeof (unsigned int));
+
+		if (ui->meter && r < ui->meter->n_met) {
+			ui->meter_rw[r] = meter_widget_new (ui, r);
+			if (ui->meter->spec) {
+				robwidget_set_mousedown (ui->meter_rw[r], spec_meter_mousedown);
+			}
+			rob_table_attach (ui->matrix, ui->meter_rw[r], 3, 4, r + 1, r + 2, 2, 2, RTK_SHRINK, RTK_SHRINK);
+		}
 	}
 
 	/* hidden spacers left/right */
@@ -1024,54 +6352,48 @@ static RobWidget* toplevel (RobTkApp* ui, void* const top) {
 	rob_table_attach (ui->matrix, robtk_sep_widget (ui->spc_v[0]), 0, 1, 0, rb, 0, 0, RTK_EXANDF, RTK_FILL);
 	ui->spc_v[1] = robtk_sep_new (FALSE);
 	robtk_sep_set_linewidth (ui->spc_v[1], 0);
-	rob_table_attach (ui->matrix, robtk_sep_widget (ui->spc_v[1]), c0 + 1 + ui->device->smo, c0 + 2 + ui->device->smo, 0, rb, 0, 0, RTK_EXANDF, RTK_FILL);
+	rob_table_attach (ui->matrix, robtk_sep_widget (ui->spc_v[1]), c0 + 1 + ui->sm.device->smo, c0 + 2 + ui->sm.device->smo, 0, rb, 0, 0, RTK_EXANDF, RTK_FILL);
 
 	/* vertical separator line between inputs and matrix (c0-1 .. c0)*/
 	ui->sep_v = robtk_sep_new (FALSE);
-	rob_table_attach (ui->matrix, robtk_sep_widget (ui->sep_v), 3, 4, 0, rb, 10, 0, RTK_SHRINK, RTK_FILL);
+	rob_table_attach (ui->matrix, robtk_sep_widget (ui->sep_v), c0 - 1, c0, 0, rb, 10, 0, RTK_SHRINK, RTK_FILL);
 
 	/* matrix */
 	unsigned int r;
 
-	for (r = 0; r < ui->device->smi; ++r) {
+	for (r = 0; r < ui->sm.device->smi; ++r) {
 		ui->mtx_sel[r] = robtk_select_new ();
 
 		Mctrl* sctrl = matrix_sel (ui, r);
-		set_select_values (ui->mtx_sel[r], sctrl);
+		set_select_values (ui->mtx_sel[r], sctrl, &en_mtx);
 		robtk_select_set_default_item (ui->mtx_sel[r], 1 + r); // XXX defaults (0 == off)
 		robtk_select_set_callback (ui->mtx_sel[r], cb_mtx_src, ui);
+		robtk_select_set_sensitive (ui->mtx_sel[r], false);
 
 		rob_table_attach (ui->matrix, robtk_select_widget (ui->mtx_sel[r]), c0, c0 + 1, r + 1, r + 2, 2, 2, RTK_SHRINK, RTK_SHRINK);
 		memcpy (ui->mtx_sel[r]->rw->name, &r, sizeof (unsigned int));
 
-		for (unsigned int c = 0; c < ui->device->smo; ++c) {
-			unsigned int n = r * ui->device->smo + c;
+		for (unsigned int c = 0; c < ui->sm.device->smo; ++c) {
+			unsigned int n = r * ui->sm.device->smo + c;
 			Mctrl* ctrl = matrix_ctrl_cr (ui, c, r);
 			assert (ctrl);
 			ui->mtx_gain[n] = robtk_dial_new_with_size (
 					0, 1, 1.f / 80.f,
 					GD_WIDTH, GED_HEIGHT, GD_CX, GD_CY, GED_RADIUS);
 			robtk_dial_set_default (ui->mtx_gain[n], db_to_knob (0));
-			robtk_dial_set_value (ui->mtx_gain[n], db_to_knob (get_dB (ctrl)));
 			robtk_dial_set_callback (ui->mtx_gain[n], cb_mtx_gain, ui);
 			robtk_dial_annotation_callback (ui->mtx_gain[n], dial_annotation_db, ui);
+			robtk_dial_set_sensitive (ui->mtx_gain[n], false);
 			robwidget_set_mousedown (ui->mtx_gain[n]->rw, robtk_dial_mouse_intercept);
 			ui->mtx_gain[n]->displaymode = 3;
 
-			if (0 == robtk_dial_get_value (ui->mtx_gain[n])) {
-				ui->mtx_gain[n]->click_state = 1;
-			}
-			else if (0 == knob_to_db (robtk_dial_get_value (ui->mtx_gain[n]))) {
-				ui->mtx_gain[n]->click_state = 2;
-			}
-
-			if (c == (ui->device->smo - 1) && r == 0) {
+			if (c == (ui->sm.device->smo - 1) && r == 0) {
 				robtk_dial_set_surface (ui->mtx_gain[n], ui->mtx_sf[5]);
 			}
 			else if (c == 0 && r == 0) {
 				robtk_dial_set_surface (ui->mtx_gain[n], ui->mtx_sf[4]);
 			}
-			else if (c == (ui->device->smo - 1)) {
+			else if (c == (ui->sm.device->smo - 1)) {
 				robtk_dial_set_surface (ui->mtx_gain[n], ui->mtx_sf[3]);
 			}
 			else if (c == 0) {
@@ -1091,11 +6413,16 @@ static RobWidget* toplevel (RobTkApp* ui, void* const top) {
 	}
 
 	/* matrix out labels */
-	for (unsigned int c = 0; c < ui->device->smo; ++c) {
+	for (unsigned int c = 0; c < ui->sm.device->smo; ++c) {
 		char txt[8];
 		sprintf (txt, "Mix %c", 'A' + c);
 		ui->mtx_lbl[c]  = robtk_lbl_new (txt);
 		rob_table_attach (ui->matrix, robtk_lbl_widget (ui->mtx_lbl[c]), c0 + c + 1, c0 + c + 2, r + 1, r + 2, 2, 2, RTK_SHRINK, RTK_SHRINK);
+
+		if (ui->meter && c < ui->meter->n_bus) {
+			ui->bus_rw[c] = meter_widget_new (ui, ui->meter->stride + c);
+			rob_table_attach (ui->matrix, ui->bus_rw[c], c0 + c + 1, c0 + c + 2, r + 2, r + 3, 2, 2, RTK_SHRINK, RTK_SHRINK);
+		}
 	}
 
 	/*** output Table ***/
@@ -1104,7 +6431,6 @@ static RobWidget* toplevel (RobTkApp* ui, void* const top) {
 	ui->out_mst = robtk_lbl_new ("Master");
 	rob_table_attach (ui->output, robtk_lbl_widget (ui->out_mst), 0, 2, 0, 1, 2, 2, RTK_SHRINK, RTK_SHRINK);
 	{
-		Mctrl* ctrl = mst_gain (ui);
 		ui->mst_gain = robtk_dial_new_with_size (
 				0, 1, 1.f / 80.f,
 				75, 50, 37.5, 22.5, 20);
@@ -1115,22 +6441,20 @@ static RobWidget* toplevel (RobTkApp* ui, void* const top) {
 		robtk_dial_set_default (ui->mst_gain, db_to_knob (0));
 		robtk_dial_set_default_state (ui->mst_gain, 0);
 
-		robtk_dial_set_value (ui->mst_gain, db_to_knob (get_dB (ctrl)));
-		robtk_dial_set_state (ui->mst_gain, get_mute (ctrl) ? 1 : 0);
 		robtk_dial_set_callback (ui->mst_gain, cb_mst_gain, ui);
 		robtk_dial_annotation_callback (ui->mst_gain, dial_annotation_db, ui);
+		robtk_dial_set_sensitive (ui->mst_gain, false);
 		rob_table_attach (ui->output, robtk_dial_widget (ui->mst_gain), 0, 2, 1, 3, 2, 0, RTK_SHRINK, RTK_SHRINK);
 	}
 
 	/* output level + labels */
-	for (unsigned int o = 0; o < ui->device->smst; ++o) {
-		int row = 4 * floor (o / 5); // beware of bleed into Hi-Z, Pads
-		int oc = o % 5;
+	for (unsigned int o = 0; o < ui->sm.device->smst; ++o) {
+		int row = 4 * (o / o_cols);
+		int oc = o % o_cols;
 
 		ui->out_lbl[o]  = robtk_lbl_new (out_gain_label (ui, o));
 		rob_table_attach (ui->output, robtk_lbl_widget (ui->out_lbl[o]), 3 * oc + 2, 3 * oc + 5, row, row + 1, 2, 2, RTK_SHRINK, RTK_SHRINK);
 
-		Mctrl* ctrl = out_gain (ui, o);
 		ui->out_gain[o] = robtk_dial_new_with_size (
 				0, 1, 1.f / 80.f,
 				65, 40, 32.5, 17.5, 15);
@@ -1141,44 +6465,45 @@ static RobWidget* toplevel (RobTkApp* ui, void* const top) {
 		robtk_dial_set_default (ui->out_gain[o], db_to_knob (0));
 		robtk_dial_set_default_state (ui->out_gain[o], 0);
 
-		robtk_dial_set_value (ui->out_gain[o], db_to_knob (get_dB (ctrl)));
-		robtk_dial_set_state (ui->out_gain[o], get_mute (ctrl) ? 1 : 0);
 		robtk_dial_set_callback (ui->out_gain[o], cb_out_gain, ui);
 		robtk_dial_annotation_callback (ui->out_gain[o], dial_annotation_db, ui);
+		robtk_dial_set_sensitive (ui->out_gain[o], false);
 		rob_table_attach (ui->output, robtk_dial_widget (ui->out_gain[o]), 3 * oc + 2, 3 * oc + 5, row + 1, row + 2, 2, 0, RTK_SHRINK, RTK_SHRINK);
 
 		memcpy (ui->out_gain[o]->rw->name, &o, sizeof (unsigned int));
 	}
 
 	/* Hi-Z*/
-	for (unsigned int i = 0; i < ui->device->num_hiz; ++i) {
+	for (unsigned int i = 0; i < ui->sm.device->num_hiz; ++i) {
 		ui->btn_hiz[i] = robtk_cbtn_new ("HiZ", GBT_LED_LEFT, false);
-		robtk_cbtn_set_active (ui->btn_hiz[i], get_enum (hiz (ui, i)) == 1);
 		robtk_cbtn_set_callback (ui->btn_hiz[i], cb_set_hiz, ui);
+		robtk_cbtn_set_sensitive (ui->btn_hiz[i], false);
 		rob_table_attach (ui->output, robtk_cbtn_widget (ui->btn_hiz[i]),
-				i, i + 1, 3, 4, 0, 0, RTK_SHRINK, RTK_SHRINK);
+				i, i + 1, sw_row, sw_row + 1, 0, 0, RTK_SHRINK, RTK_SHRINK);
+		memcpy (ui->btn_hiz[i]->rw->name, &i, sizeof (unsigned int));
 	}
 
 	/* Pads */
-	for (unsigned int i = 0; i < ui->device->num_pad; ++i) {
+	for (unsigned int i = 0; i < ui->sm.device->num_pad; ++i) {
 		ui->btn_pad[i] = robtk_cbtn_new ("Pad", GBT_LED_LEFT, false);
-		robtk_cbtn_set_active (ui->btn_pad[i], get_enum (pad (ui, i)) == 1);
 		robtk_cbtn_set_callback (ui->btn_pad[i], cb_set_pad, ui);
+		robtk_cbtn_set_sensitive (ui->btn_pad[i], false);
 		rob_table_attach (ui->output, robtk_cbtn_widget (ui->btn_pad[i]),
-				i, i + 1, 4, 5, 0, 0, RTK_SHRINK, RTK_SHRINK);
+				i, i + 1, sw_row + 1, sw_row + 2, 0, 0, RTK_SHRINK, RTK_SHRINK);
+		memcpy (ui->btn_pad[i]->rw->name, &i, sizeof (unsigned int));
 	}
 
 	/* output selectors */
-	for (unsigned int o = 0; o < ui->device->sout; ++o) {
-		int row = 4 * floor (o / 10); // beware of bleed into Hi-Z, Pads
-		int pc = 3 * (o / 2); /* stereo-pair column */
-		pc %= 15;
+	for (unsigned int o = 0; o < ui->sm.device->sout; ++o) {
+		int row = 4 * ((o / 2) / o_cols);
+		int pc = 3 * ((o / 2) % o_cols); /* stereo-pair column */
 
 		ui->out_sel[o] = robtk_select_new ();
 		Mctrl* sctrl = out_sel (ui, o);
-		set_select_values (ui->out_sel[o], sctrl);
+		set_select_values (ui->out_sel[o], sctrl, &en_out);
 		robtk_select_set_default_item (ui->out_sel[o], out_sel_default (o));
 		robtk_select_set_callback (ui->out_sel[o], cb_out_src, ui);
+		robtk_select_set_sensitive (ui->out_sel[o], false);
 
 		memcpy (ui->out_sel[o]->rw->name, &o, sizeof (unsigned int));
 		if (o & 1) {
@@ -1193,41 +6518,170 @@ static RobWidget* toplevel (RobTkApp* ui, void* const top) {
 #if 0
 	/* re-send */
 	ui->btn_reset = robtk_pbtn_new ("R");
-	rob_table_attach (ui->output, robtk_pbtn_widget (ui->btn_reset), 1 + 3 * (ui->device->sout / 2), 2 + 3 * (ui->device->sout / 2), 2, 3, 2, 2, RTK_SHRINK, RTK_SHRINK);
+	rob_table_attach (ui->output, robtk_pbtn_widget (ui->btn_reset), 1 + 3 * (ui->sm.device->sout / 2), 2 + 3 * (ui->sm.device->sout / 2), 2, 3, 2, 2, RTK_SHRINK, RTK_SHRINK);
 	robtk_pbtn_set_callback_up (ui->btn_reset, cb_btn_reset, ui);
 #endif
 
+	enum_names_free (&en_src);
+	enum_names_free (&en_mtx);
+	enum_names_free (&en_out);
+
+	/* values are read progressively, see sync_state() */
+	ui->sync_pos = 0;
+	ui->sync_cnt = 1 + ui->sm.device->smst + ui->sm.device->num_hiz + ui->sm.device->num_pad
+		+ ui->sm.device->sin + ui->sm.device->smi * (1 + ui->sm.device->smo) + ui->sm.device->sout;
+	ui->need_refresh = false;
+
+	/* tool buttons */
+	ui->tools = rob_hbox_new (FALSE, 2);
+
+	ui->btn_undo = robtk_pbtn_new ("Undo");
+	ui->btn_redo = robtk_pbtn_new ("Redo");
+	robtk_pbtn_set_callback_up (ui->btn_undo, cb_btn_undo, ui);
+	robtk_pbtn_set_callback_up (ui->btn_redo, cb_btn_redo, ui);
+	rob_hbox_child_pack (ui->tools, robtk_pbtn_widget (ui->btn_undo), FALSE, FALSE);
+	rob_hbox_child_pack (ui->tools, robtk_pbtn_widget (ui->btn_redo), FALSE, FALSE);
+	hist_update_buttons (ui);
+
+	ui->btn_dim   = robtk_cbtn_new ("Dim", GBT_LED_LEFT, false);
+	ui->btn_panic = robtk_pbtn_new ("Panic");
+	robtk_cbtn_set_callback (ui->btn_dim, cb_btn_dim, ui);
+	robtk_pbtn_set_callback_up (ui->btn_panic, cb_btn_panic, ui);
+	rob_hbox_child_pack (ui->tools, robtk_cbtn_widget (ui->btn_dim), FALSE, FALSE);
+	ui->btn_hud = robtk_cbtn_new ("Stats", GBT_LED_LEFT, false);
+	robtk_cbtn_set_active (ui->btn_hud, ui->perf.on);
+	robtk_cbtn_set_callback (ui->btn_hud, cb_btn_hud, ui);
+	rob_hbox_child_pack (ui->tools, robtk_cbtn_widget (ui->btn_hud), FALSE, FALSE);
+	rob_hbox_child_pack (ui->tools, robtk_pbtn_widget (ui->btn_panic), FALSE, FALSE);
+
+	ui->mtx_op_sel = robtk_select_new ();
+	for (unsigned int i = 0; i < sizeof (mtx_op_items) / sizeof (mtx_op_items[0]); ++i) {
+		robtk_select_add_item (ui->mtx_op_sel, i, mtx_op_items[i].label);
+	}
+	robtk_select_set_default_item (ui->mtx_op_sel, 0);
+	ui->mtx_a_sel = robtk_select_new ();
+	ui->mtx_b_sel = robtk_select_new ();
+	for (unsigned int c = 0; c < ui->sm.device->smo; ++c) {
+		char txt[16];
+		snprintf (txt, sizeof (txt), "Mix %c", 'A' + c);
+		robtk_select_add_item (ui->mtx_a_sel, c, txt);
+		robtk_select_add_item (ui->mtx_b_sel, c, txt);
+	}
+	for (unsigned int r = 0; r < ui->sm.device->smi; ++r) {
+		char txt[16];
+		snprintf (txt, sizeof (txt), "In %u", r + 1);
+		robtk_select_add_item (ui->mtx_a_sel, ui->sm.device->smo + r, txt);
+		robtk_select_add_item (ui->mtx_b_sel, ui->sm.device->smo + r, txt);
+	}
+	robtk_select_set_default_item (ui->mtx_a_sel, 0);
+	robtk_select_set_default_item (ui->mtx_b_sel, ui->sm.device->smo > 1 ? 1 : 0);
+	robtk_select_set_value (ui->mtx_b_sel, ui->sm.device->smo > 1 ? 1 : 0);
+	ui->btn_mtx_op = robtk_pbtn_new ("Apply");
+	robtk_pbtn_set_callback_up (ui->btn_mtx_op, cb_btn_mtx_op, ui);
+	rob_hbox_child_pack (ui->tools, robtk_select_widget (ui->mtx_op_sel), FALSE, FALSE);
+	rob_hbox_child_pack (ui->tools, robtk_select_widget (ui->mtx_a_sel), FALSE, FALSE);
+	rob_hbox_child_pack (ui->tools, robtk_select_widget (ui->mtx_b_sel), FALSE, FALSE);
+	rob_hbox_child_pack (ui->tools, robtk_pbtn_widget (ui->btn_mtx_op), FALSE, FALSE);
+
+	ui->cue_sel = robtk_select_new ();
+	for (unsigned int o = 0; o < ui->sm.device->smst && 2 * o + 1 < ui->sm.device->sout; ++o) {
+		robtk_select_add_item (ui->cue_sel, o, out_gain_label (ui, o));
+	}
+	robtk_select_set_default_item (ui->cue_sel, ui->cue_out);
+	robtk_select_set_value (ui->cue_sel, ui->cue_out);
+	robtk_select_set_callback (ui->cue_sel, cb_cue_sel, ui);
+	ui->btn_unsolo = robtk_pbtn_new ("Unsolo");
+	robtk_pbtn_set_callback_up (ui->btn_unsolo, cb_btn_unsolo, ui);
+	rob_hbox_child_pack (ui->tools, robtk_select_widget (ui->cue_sel), FALSE, FALSE);
+	rob_hbox_child_pack (ui->tools, robtk_pbtn_widget (ui->btn_unsolo), FALSE, FALSE);
+	solo_update_buttons (ui);
+
+	if (ui->bank.hdr) {
+		ui->preset_sel = robtk_select_new ();
+		for (unsigned int i = 0; i < BANK_SLOTS; ++i) {
+			char txt[16];
+			sprintf (txt, "Preset %u", i + 1);
+			robtk_select_add_item (ui->preset_sel, i, txt);
+		}
+		robtk_select_set_default_item (ui->preset_sel, 0);
+		ui->btn_recall = robtk_pbtn_new ("Recall");
+		ui->btn_store  = robtk_pbtn_new ("Store");
+		robtk_pbtn_set_callback_up (ui->btn_recall, cb_btn_recall, ui);
+		robtk_pbtn_set_callback_up (ui->btn_store, cb_btn_store, ui);
+		rob_hbox_child_pack (ui->tools, robtk_select_widget (ui->preset_sel), FALSE, FALSE);
+		rob_hbox_child_pack (ui->tools, robtk_pbtn_widget (ui->btn_recall), FALSE, FALSE);
+		rob_hbox_child_pack (ui->tools, robtk_pbtn_widget (ui->btn_store), FALSE, FALSE);
+	}
+
+	if (ui->cues) {
+		char txt[64];
+		cue_next_label (ui, sizeof (txt), txt);
+		ui->cues->changed = false;
+		ui->btn_go = robtk_pbtn_new ("Go");
+		ui->go_lbl = robtk_lbl_new (txt);
+		robtk_pbtn_set_callback_up (ui->btn_go, cb_btn_go, ui);
+		rob_hbox_child_pack (ui->tools, robtk_pbtn_widget (ui->btn_go), FALSE, FALSE);
+		rob_hbox_child_pack (ui->tools, robtk_lbl_widget (ui->go_lbl), FALSE, FALSE);
+	}
+
 	ui->sep_h = robtk_sep_new (TRUE);
 
 	/* top-level packing */
 	rob_vbox_child_pack (ui->rw, ui->matrix, TRUE, TRUE);
 	rob_vbox_child_pack (ui->rw, robtk_sep_widget (ui->sep_h), TRUE, TRUE);
 	rob_vbox_child_pack (ui->rw, ui->output, TRUE, TRUE);
+	if (ui->meter && ui->meter->spec) {
+		ui->spec_rw = spec_widget_new (ui);
+		rob_vbox_child_pack (ui->rw, ui->spec_rw, TRUE, FALSE);
+	}
+	rob_vbox_child_pack (ui->rw, ui->tools, FALSE, FALSE);
+
+	/* time and overlay complete frames */
+	hud_ui = ui;
+	ui->rw_expose = ui->rw->expose_event;
+	robwidget_set_expose_event (ui->rw, hud_expose_event);
+	rec_start (ui);
 	return ui->rw;
 }
 
 static void gui_cleanup (RobTkApp* ui) {
 
+	hotkey_stop (ui);
+	cue_stop (ui);
+	meter_stop (ui);
+	solo_clear (ui);
+	wq_flush (ui);
+	persist_close (ui);
+	rec_close (ui);
+	jrn_close (ui);
+	bank_close (ui);
+	vfy_free (ui);
 	close_mixer (ui);
 	free (ui->pollfds);
 
-	for (int i = 0; i < ui->device->sin; ++i) {
+	for (int i = 0; i < ui->sm.device->sin; ++i) {
 		robtk_select_destroy (ui->src_sel[i]);
 		robtk_lbl_destroy (ui->src_lbl[i]);
+		if (ui->meter_rw[i]) {
+			robwidget_destroy (ui->meter_rw[i]);
+		}
 	}
-	for (int r = 0; r < ui->device->smi; ++r) {
+	for (int r = 0; r < ui->sm.device->smi; ++r) {
 		robtk_select_destroy (ui->mtx_sel[r]);
-		for (int c = 0; c < ui->device->smo; ++c) {
-			robtk_dial_destroy (ui->mtx_gain[r * ui->device->smo + c]);
+		for (int c = 0; c < ui->sm.device->smo; ++c) {
+			robtk_dial_destroy (ui->mtx_gain[r * ui->sm.device->smo + c]);
 		}
 	}
-	for (int i = 0; i < ui->device->smo; ++i) {
+	for (int i = 0; i < ui->sm.device->smo; ++i) {
 		robtk_lbl_destroy (ui->mtx_lbl[i]);
+		if (ui->bus_rw[i]) {
+			robwidget_destroy (ui->bus_rw[i]);
+		}
 	}
-	for (int i = 0; i < ui->device->sout; ++i) {
+	for (int i = 0; i < ui->sm.device->sout; ++i) {
 		robtk_select_destroy (ui->out_sel[i]);
 	}
-	for (int i = 0; i < ui->device->smst; ++i) {
+	for (int i = 0; i < ui->sm.device->smst; ++i) {
 		robtk_lbl_destroy (ui->out_lbl[i]);
 		robtk_dial_destroy (ui->out_gain[i]);
 	}
@@ -1242,76 +6696,164 @@ static void gui_cleanup (RobTkApp* ui) {
 	robtk_lbl_destroy (ui->out_mst);
 	robtk_dial_destroy (ui->mst_gain);
 
-	for (int i = 0; i < ui->device->num_hiz; i++) {
+	for (int i = 0; i < ui->sm.device->num_hiz; i++) {
 		robtk_cbtn_destroy (ui->btn_hiz[i]);
 	}
 
-	for (int i = 0; i < ui->device->num_pad; i++) {
-		robtk_cbtn_destroy (ui->btn_pad[i]);
+	for (int i = 0; i < ui->sm.device->num_pad; i++) {
+		robtk_cbtn_destroy (ui->btn_pad[i]);
+	}
+
+	robtk_sep_destroy (ui->sep_v);
+	robtk_sep_destroy (ui->sep_h);
+	robtk_sep_destroy (ui->spc_v[0]);
+	robtk_sep_destroy (ui->spc_v[1]);
+
+	robtk_pbtn_destroy (ui->btn_undo);
+	robtk_pbtn_destroy (ui->btn_redo);
+	robtk_pbtn_destroy (ui->btn_panic);
+	robtk_cbtn_destroy (ui->btn_dim);
+	robtk_cbtn_destroy (ui->btn_hud);
+	hud_ui = NULL;
+	robtk_select_destroy (ui->mtx_op_sel);
+	robtk_select_destroy (ui->mtx_a_sel);
+	robtk_select_destroy (ui->mtx_b_sel);
+	robtk_pbtn_destroy (ui->btn_mtx_op);
+	robtk_select_destroy (ui->cue_sel);
+	robtk_pbtn_destroy (ui->btn_unsolo);
+	if (ui->preset_sel) {
+		robtk_select_destroy (ui->preset_sel);
+		robtk_pbtn_destroy (ui->btn_recall);
+		robtk_pbtn_destroy (ui->btn_store);
+	}
+	if (ui->btn_go) {
+		robtk_pbtn_destroy (ui->btn_go);
+		robtk_lbl_destroy (ui->go_lbl);
+	}
+	rob_box_destroy (ui->tools);
+	if (ui->spec_rw) {
+		robwidget_destroy (ui->spec_rw);
+	}
+
+	rob_table_destroy (ui->output);
+	rob_table_destroy (ui->matrix);
+	rob_box_destroy (ui->rw);
+
+	pango_font_description_free (ui->font);
+
+	free (ui->mtx_sel);
+	free (ui->mtx_gain);
+	free (ui->mtx_lbl);
+
+	free (ui->src_lbl);
+	free (ui->src_sel);
+	free (ui->meter_rw);
+	free (ui->bus_rw);
+
+	free (ui->out_lbl);
+	free (ui->out_sel);
+	free (ui->out_gain);
+
+	free (ui->btn_hiz);
+	free (ui->btn_pad);
+}
+
+/* *****************************************************************************
+ * Progressive initial state read
+ *
+ * The window is shown with placeholder values and all controls
+ * insensitive. The current device state is read in batches from the
+ * idle callback, each widget is enabled once its value is known.
+ */
+
+#define SYNC_BATCH 48
+
+static void sync_item (RobTkApp* ui, unsigned int n)
+{
+	Device const* d = ui->sm.device;
+	Mctrl* ctrl;
+
+	if (n == 0) {
+		ctrl = mst_gain (ui);
+		robtk_dial_set_value (ui->mst_gain, db_to_knob (get_dB (ctrl)));
+		robtk_dial_set_state (ui->mst_gain, get_mute (ctrl) ? 1 : 0);
+		robtk_dial_set_sensitive (ui->mst_gain, true);
+		return;
+	}
+	n -= 1;
+
+	if (n < d->smst) {
+		ctrl = out_gain (ui, n);
+		robtk_dial_set_value (ui->out_gain[n], db_to_knob (get_dB (ctrl)));
+		robtk_dial_set_state (ui->out_gain[n], get_mute (ctrl) ? 1 : 0);
+		robtk_dial_set_sensitive (ui->out_gain[n], true);
+		return;
 	}
+	n -= d->smst;
 
-	robtk_sep_destroy (ui->sep_v);
-	robtk_sep_destroy (ui->sep_h);
-	robtk_sep_destroy (ui->spc_v[0]);
-	robtk_sep_destroy (ui->spc_v[1]);
+	if (n < d->num_hiz) {
+		robtk_cbtn_set_active (ui->btn_hiz[n], get_enum (hiz (ui, n)) == 1);
+		robtk_cbtn_set_sensitive (ui->btn_hiz[n], true);
+		return;
+	}
+	n -= d->num_hiz;
 
-	rob_table_destroy (ui->output);
-	rob_table_destroy (ui->matrix);
-	rob_box_destroy (ui->rw);
+	if (n < d->num_pad) {
+		robtk_cbtn_set_active (ui->btn_pad[n], get_enum (pad (ui, n)) == 1);
+		robtk_cbtn_set_sensitive (ui->btn_pad[n], true);
+		return;
+	}
+	n -= d->num_pad;
 
-	pango_font_description_free (ui->font);
+	if (n < d->sin) {
+		robtk_select_set_value (ui->src_sel[n], get_enum (src_sel (ui, n)));
+		robtk_select_set_sensitive (ui->src_sel[n], true);
+		return;
+	}
+	n -= d->sin;
 
-	free (ui->mtx_sel);
-	free (ui->mtx_gain);
-	free (ui->mtx_lbl);
+	if (n < d->smi) {
+		robtk_select_set_value (ui->mtx_sel[n], get_enum (matrix_sel (ui, n)));
+		robtk_select_set_sensitive (ui->mtx_sel[n], true);
+		return;
+	}
+	n -= d->smi;
 
-	free (ui->src_lbl);
-	free (ui->src_sel);
+	if (n < d->smi * d->smo) {
+		robtk_dial_set_value (ui->mtx_gain[n], db_to_knob (get_dB (matrix_ctrl_n (ui, n))));
+		mtx_gain_click_state (ui, n);
+		robtk_dial_set_sensitive (ui->mtx_gain[n], true);
+		return;
+	}
+	n -= d->smi * d->smo;
 
-	free (ui->out_lbl);
-	free (ui->out_sel);
-	free (ui->out_gain);
+	assert (n < d->sout);
+	robtk_select_set_value (ui->out_sel[n], get_enum (out_sel (ui, n)));
+	robtk_select_set_sensitive (ui->out_sel[n], true);
+}
 
-	free (ui->btn_hiz);
-	free (ui->btn_pad);
+/* returns true while the initial read is in progress */
+static bool sync_state (RobTkApp* ui)
+{
+	if (ui->sync_pos >= ui->sync_cnt) {
+		return false;
+	}
+	unsigned int end = ui->sync_pos + SYNC_BATCH;
+	if (end > ui->sync_cnt) {
+		end = ui->sync_cnt;
+	}
+	ui->disable_signals = true;
+	for (; ui->sync_pos < end; ++ui->sync_pos) {
+		sync_item (ui, ui->sync_pos);
+	}
+	ui->disable_signals = false;
+	return true;
 }
 
 static char* lookup_device ()
 {
-	char* card = NULL;
-	snd_ctl_card_info_t* info;
-	snd_ctl_card_info_alloca(&info);
-	int number = -1;
-	while (!card) {
-		int err = snd_card_next(&number);
-		if (err < 0 || number < 0) {
-			break;
-		}
-		snd_ctl_t* ctl;
-		char buf[16];
-		sprintf (buf, "hw:%d", number);
-		err = snd_ctl_open(&ctl, buf, 0);
-		if (err < 0) {
-			continue;
-		}
-		err = snd_ctl_card_info(ctl, info);
-		snd_ctl_close(ctl);
-		if (err < 0) {
-			continue;
-		}
-		const char* card_name = snd_ctl_card_info_get_name (info);
-		if (!card_name) {
-			continue;
-		}
-		if (verbose > 1) {
-			printf ("* hw:%d \"%s\"\n", number, card_name);
-		}
-		for (unsigned i = 0; i < NUM_DEVICES; i++) {
-			if (!strcmp (card_name, devices[i].name)) {
-				card = strdup (buf);
-			}
-		}
-	}
+	scarlett_verbose = verbose;
+	char* card = scarlett_find_card (NULL, NULL);
 	if (verbose > 0 && NULL != card) {
 		printf ("Autodetect: Using \"%s\"\n", card);
 	}
@@ -1324,7 +6866,28 @@ static char* lookup_device ()
 
 static struct option const long_options[] =
 {
+	{"analyzer", no_argument, 0, 'A'},
+	{"bank", required_argument, 0, 'b'},
+	{"cue", required_argument, 0, 'C'},
+	{"daemon", required_argument, 0, 'D'},
 	{"help", no_argument, 0, 'h'},
+	{"hud", no_argument, 0, 'H'},
+	{"record", required_argument, 0, 'I'},
+	{"latency", required_argument, 0, 'L'},
+	{"link", required_argument, 0, 'l'},
+	{"journal", required_argument, 0, 'j'},
+	{"matrix", required_argument, 0, 'm'},
+	{"meters", no_argument, 0, 'M'},
+	{"route", required_argument, 0, 'o'},
+	{"cues", required_argument, 0, 'q'},
+	{"panic", no_argument, 0, 'x'},
+	{"panic-key", required_argument, 0, 'k'},
+	{"recall", required_argument, 0, 'R'},
+	{"replay", required_argument, 0, 'r'},
+	{"state", required_argument, 0, 's'},
+	{"store", required_argument, 0, 'S'},
+	{"trace", required_argument, 0, 'T'},
+	{"verify", no_argument, 0, 'c'},
 	{"preset-only", no_argument, 0, 'P'},
 	{"print-controls", no_argument, 0, 'p'},
 	{"version", no_argument, 0, 'V'},
@@ -1343,20 +6906,116 @@ falling back to '%s'.\n\
 Supported devices:\n\
 ", DEFAULT_DEVICE);
 
-	for (unsigned i = 0; i < NUM_DEVICES; i++) {
-		printf ("* %s\n", devices[i].name);
+	Device* d;
+	for (unsigned i = 0; (d = scarlett_device (i)); i++) {
+		printf ("* %s\n", d->name);
 	}
 
 	printf ("Usage: scarlett-mixer [ OPTIONS ] [ DEVICE ]\n\n");
 	printf ("Options:\n\
+  -A, --analyzer             show a spectrum analyzer for an input\n\
+                             selected by clicking its meter, implies -M\n\
+  -b, --bank <file>          use the given preset bank, created if it\n\
+                             does not exist\n\
+  -C, --cue <output>         output used for solo, default: first headphone\n\
+  -c, --verify               periodically verify the device state and\n\
+                             re-send controls that differ\n\
+  -D, --daemon <name>        run without GUI, publish the mixer state\n\
+                             in the given POSIX shared memory object\n\
   -h, --help                 display this help and exit\n\
+  -H, --hud                  show performance statistics on start, they\n\
+                             can be toggled with the 'Stats' button\n\
+  -I, --record <file>        record pointer events (clicks, drags, scroll)\n\
+                             to the given file, for scarlett-mixer-bench\n\
+  -j, --journal <file>       record all control changes to the given file\n\
+  -L, --latency <rates:periods>\n\
+                             measure the latency of the device for the\n\
+                             given sample-rates and period sizes and exit\n\
+  -l, --link <group>         link mix-busses, matrix-inputs or outputs\n\
+                             (may be specified multiple times)\n\
+  -m, --matrix <op>          apply matrix operation and exit\n\
+                             (may be specified multiple times)\n\
+  -M, --meters               show input levels and estimated mix-bus\n\
+                             levels, this opens the capture PCM device\n\
+                             of the soundcard\n\
+  -o, --route <file>         apply a routing description and exit\n\
   -p, --print-controls       list control parameters of given soundcard\n\
+  -q, --cues <file>          run a cue list of presets from the bank\n\
   -P, --preset-only          do not parse names from kernel-driver\n\
+  -r, --replay <file>        replay a recorded journal and exit\n\
+  -R, --recall <num>         recall preset 1..128 from the bank and exit\n\
+  -s, --state <file>         save the state to the given file whenever it\n\
+                             changes, restore it at startup and when the\n\
+                             device re-appears after a power cycle\n\
+  -S, --store <num[:name]>   store the current state as preset 1..128\n\
+                             in the bank and exit\n\
+  -T, --trace <file>         record a timeline of internal operations,\n\
+                             written as Chrome trace JSON at exit\n\
+  -x, --panic                mute all outputs and exit\n\
+  -k, --panic-key <key>      X11 key name to mute all outputs,\n\
+                             default: '" HOTKEY_DEFAULT "', 'none' to disable\n\
   -V, --version              print version information and exit\n\
   -v, --verbose              print information (may be specifified twice)\n\
 \n\n\
+Link groups apply a change of one member to all members of the group.\n\
+The group is given as kind:members, kind is one of 'mix' (matrix\n\
+mix-busses A, B, ..), 'in' (matrix inputs) or 'out' (output gains).\n\
+Append ':rel' to keep gain offsets between members.\n\
+\n\
+Matrix operations are 'clear', 'identity', 'copy:<mix>:<mix>',\n\
+'trim:<mix>:<dB>' and 'swap:<input>:<input>', e.g. copy:A:C or swap:1:2.\n\
+Each operation is written to the device as one batch. In the GUI they\n\
+are in the tools row (operation, mix-busses or inputs, Apply), each one\n\
+is a single undo step.\n\
+\n\
+A routing description has one route per line, e.g.\n\
+  vocalist: Headphone 1 = Analog 1-4 -6dB, PCM 3 0dB, Analog 5 L, Analog 6 R\n\
+Sources are matrix input names, outputs are output labels. Mix-busses and\n\
+matrix inputs are allocated automatically, only changes are written.\n\
+\n\
+Ctrl + middle-click on a crosspoint solos its matrix input on the cue\n\
+output, Shift + middle-click solos its mix-bus. Solos nest, 'Unsolo'\n\
+restores the mix as it was before the last solo.\n\
+\n\
+A cue list has one cue per line: <preset> [fade <sec>] [at <hh:mm[:ss]>\n\
+| wait <sec>]. The preset is given by number or name. A cue starts on\n\
+'Go' (or SIGHUP), at the given time of day, or the given time after the\n\
+previous cue completed, e.g.\n\
+  Preshow fade 5 at 19:30\n\
+  Act 1 fade 2.5\n\
+  3 fade 10 wait 60\n\
+Planned and achieved timing is printed for each cue.\n\
+\n\
+The latency measurement plays a test sequence on the last PCM channel\n\
+and records it from the last capture channel via an unused mix-bus.\n\
+Outputs playing that PCM channel are muted meanwhile, the routing is\n\
+restored afterwards. The playback and capture PCM must not be in use.\n\
+\n\
+A running mixer mutes all outputs when the panic key is pressed, also\n\
+when it does not have the focus, or when it receives SIGUSR1, e.g. bind\n\
+`pkill -USR1 scarlett-mixer` to a hotkey. The time it took is printed.\n\
+With --trace, SIGUSR2 writes the trace file without exiting.\n\
+\n\
+In daemon mode other programs can read the current state without\n\
+opening the mixer, see src/scarlett_shm.h for the layout. scarlett-mixerd\n\
+publishes the same without the GUI dependencies.\n\
+\n\
+With a preset bank, the GUI and the daemon create an ALSA sequencer\n\
+port 'Scarlett Mixer:Program Change'. Program change n recalls preset\n\
+n + 1 on any channel.\n\
+\n\
 Examples:\n\
 scarlett-mixer hw:1\n\
+scarlett-mixer --link mix:A,B --link in:1-2:rel hw:1\n\
+scarlett-mixer --matrix clear --matrix identity hw:1\n\
+scarlett-mixer --route monitor.routing hw:1\n\
+scarlett-mixer --journal /tmp/session.jrn hw:1\n\
+scarlett-mixer --replay /tmp/session.jrn hw:1\n\
+scarlett-mixer --daemon /scarlett-mixer hw:1\n\
+scarlett-mixer --bank show.bank --store 1:Intro hw:1\n\
+scarlett-mixer --bank show.bank --recall 1 hw:1\n\
+scarlett-mixer --bank show.bank --cues show.cues hw:1\n\
+scarlett-mixer --latency 44100,48000:64,128,256 hw:1\n\
 \n");
 	printf ("Report bugs to <https://github.com/x42/scarlett-mixer/issues>\n");
 	exit (status);
@@ -1395,18 +7054,135 @@ instantiate (
 		}
 	}
 
-	int opts = OPT_DETECT;
+	int opts = SCARLETT_DETECT;
+	const char* journal = NULL;
+	const char* replay = NULL;
+	const char* record = NULL;
+	const char* state = NULL;
+	const char* route = NULL;
+	const char* latency = NULL;
+	const char* cue = NULL;
+	const char* cues = NULL;
+	const char* shm_name = NULL;
+	const char* bank = NULL;
+	const char* store_name = NULL;
+	int recall = -1;
+	int store = -1;
+	bool verify = false;
+	bool panic = false;
+	const char* panic_key = HOTKEY_DEFAULT;
+	bool meters = false;
+	bool analyzer = false;
 	int c;
 	while (rtkargv && (c = getopt_long (rtkargv->argc, rtkargv->argv,
+			   "A"  /* analyzer */
+			   "b:" /* bank */
+			   "C:" /* cue */
+			   "c"  /* verify */
+			   "D:" /* daemon */
 			   "h"  /* help */
+			   "H"  /* hud */
+			   "I:" /* record */
+			   "j:" /* journal */
+			   "k:" /* panic-key */
+			   "L:" /* latency */
+			   "l:" /* link */
+			   "m:" /* matrix */
+			   "M"  /* meters */
+			   "o:" /* route */
 			   "P"  /* Preset-Only */
 			   "p"  /* print-controls */
+			   "q:" /* cues */
+			   "R:" /* recall */
+			   "r:" /* replay */
+			   "s:" /* state */
+			   "S:" /* store */
+			   "T:" /* trace */
 			   "V"  /* version */
-			   "v", /* verbose */
+			   "v"  /* verbose */
+			   "x", /* panic */
 			   long_options, (int *) 0)) != EOF) {
 		switch (c) {
 			case 'h':
 				usage (0);
+			case 'H':
+				ui->perf.on = true;
+				break;
+			case 'I':
+				record = optarg;
+				break;
+			case 'k':
+				panic_key = optarg;
+				break;
+			case 's':
+				state = optarg;
+				break;
+			case 'c':
+				verify = true;
+				break;
+			case 'C':
+				cue = optarg;
+				break;
+			case 'x':
+				panic = true;
+				break;
+			case 'M':
+				meters = true;
+				break;
+			case 'A':
+				meters = true;
+				analyzer = true;
+				break;
+			case 'j':
+				journal = optarg;
+				break;
+			case 'r':
+				replay = optarg;
+				break;
+			case 'o':
+				route = optarg;
+				break;
+			case 'L':
+				latency = optarg;
+				break;
+			case 'q':
+				cues = optarg;
+				break;
+			case 'D':
+				shm_name = optarg;
+				break;
+			case 'b':
+				bank = optarg;
+				break;
+			case 'R':
+				recall = atoi (optarg) - 1;
+				if (recall < 0 || recall >= BANK_SLOTS) {
+					usage (EXIT_FAILURE);
+				}
+				break;
+			case 'S':
+				store = atoi (optarg) - 1;
+				if (store < 0 || store >= BANK_SLOTS) {
+					usage (EXIT_FAILURE);
+				}
+				store_name = strchr (optarg, ':') ? strchr (optarg, ':') + 1 : NULL;
+				break;
+			case 'T':
+				trace_start (optarg);
+				break;
+			case 'l':
+				if (gang_parse (ui, optarg)) {
+					usage (EXIT_FAILURE);
+				}
+				break;
+			case 'm':
+				{
+					if (ui->n_mtx_ops >= MAX_MTX_OPS || mtx_op_parse (&ui->mtx_ops[ui->n_mtx_ops], optarg)) {
+						usage (EXIT_FAILURE);
+					}
+					++ui->n_mtx_ops;
+				}
+				break;
 			case 'V':
 				printf ("scarlet-mixer version %s\n\n", VERSION);
 				printf ("Copyright (C) GPL 2019 Robin Gareus <robin@gareus.org>\n");
@@ -1415,10 +7191,10 @@ instantiate (
 				++verbose;
 				break;
 			case 'P':
-				opts &= ~OPT_DETECT;
+				opts &= ~SCARLETT_DETECT;
 				break;
 			case 'p':
-				opts |= OPT_PROBE;
+				opts |= SCARLETT_PROBE;
 				break;
 			default:
 				usage (EXIT_FAILURE);
@@ -1429,24 +7205,193 @@ instantiate (
 		usage (EXIT_FAILURE);
 	}
 
+	if ((recall >= 0 || store >= 0 || cues) && !bank) {
+		fprintf (stderr, "--recall, --store and --cues require a preset bank\n");
+		usage (EXIT_FAILURE);
+	}
+
 	if (rtkargv && rtkargv->argc > optind) {
 		card = strdup (rtkargv->argv[optind]);
 	}
 	if (!card) {
+		TRACE_BEGIN ("lookup_device");
 		card = lookup_device ();
+		TRACE_END ("lookup_device");
 	}
 	if (!card) {
 		card = strdup (DEFAULT_DEVICE);
 	}
 
-	if (open_mixer (ui, card, opts)) {
+	if (panic) {
+		int rv = panic_ctl (card) ? 1 : 0;
+		free (ui);
+		free (card);
+		exit (rv);
+	}
+
+	TRACE_BEGIN ("open_mixer");
+	int err = open_mixer (ui, card, opts);
+	TRACE_END ("open_mixer");
+	if (err) {
+		close_mixer (ui);
+		free (ui);
+		free (card);
+		return 0;
+	}
+	wq_init (ui);
+	gang_validate (ui);
+	ui->hist_key = -1;
+	ui->jrn.fd = -1;
+	ui->bank.fd = -1;
+
+	if (replay) {
+		int rv = jrn_replay (ui, replay) ? 1 : 0;
+		close_mixer (ui);
+		free (ui);
+		free (card);
+		exit (rv);
+	}
+
+	if (ui->n_mtx_ops > 0) {
+		int rv = 0;
+		for (unsigned int i = 0; i < ui->n_mtx_ops; ++i) {
+			if (mtx_op (ui, &ui->mtx_ops[i])) {
+				fprintf (stderr, "Matrix operation #%d is not valid for this device\n", i + 1);
+				rv = 1;
+				break;
+			}
+			wq_flush (ui);
+		}
+		close_mixer (ui);
+		free (ui);
+		free (card);
+		exit (rv);
+	}
+
+	if (route) {
+		int rv = route_apply (ui, route) < 0 ? 1 : 0;
+		wq_flush (ui);
+		close_mixer (ui);
+		free (ui);
+		free (card);
+		exit (rv);
+	}
+
+	if (latency) {
+		int rv = lat_run (ui, latency) ? 1 : 0;
+		close_mixer (ui);
+		free (ui);
+		free (card);
+		exit (rv);
+	}
+
+	if (bank && bank_open (ui, bank)) {
+		close_mixer (ui);
+		free (ui);
+		free (card);
+		return 0;
+	}
+
+	if (recall >= 0 || store >= 0) {
+		int rv = 0;
+		if (store >= 0) {
+			bank_store (ui, store, store_name);
+		}
+		if (recall >= 0) {
+			if (bank_recall (ui, recall) < 0) {
+				rv = 1;
+			}
+			wq_flush (ui);
+		}
+		bank_close (ui);
+		close_mixer (ui);
+		free (ui);
+		free (card);
+		exit (rv);
+	}
+
+	if (journal && jrn_open (ui, journal)) {
+		bank_close (ui);
+		close_mixer (ui);
+		free (ui);
+		free (card);
+		return 0;
+	}
+
+	if (state && persist_open (ui, state)) {
+		persist_close (ui);
+		jrn_close (ui);
+		bank_close (ui);
+		close_mixer (ui);
+		free (ui);
+		free (card);
+		return 0;
+	}
+
+	if (record && rec_open (ui, record)) {
+		persist_close (ui);
+		jrn_close (ui);
+		bank_close (ui);
+		close_mixer (ui);
+		free (ui);
+		free (card);
+		return 0;
+	}
+
+	if (bank) {
+		bank_midi_open (ui);
+	}
+
+	if (cues && cue_start (ui, cues)) {
+		persist_close (ui);
+		rec_close (ui);
+		jrn_close (ui);
+		bank_close (ui);
 		close_mixer (ui);
 		free (ui);
 		free (card);
 		return 0;
 	}
+
+	if (shm_name) {
+		int rv = daemon_run (ui, shm_name) ? 1 : 0;
+		cue_stop (ui);
+		wq_flush (ui);
+		persist_close (ui);
+		rec_close (ui);
+		jrn_close (ui);
+		bank_close (ui);
+		close_mixer (ui);
+		free (ui->pollfds);
+		free (ui);
+		free (card);
+		exit (rv);
+	}
+
+	if (verify) {
+		vfy_init (ui);
+	}
+
+	cue_init (ui, cue);
+
+	signal (SIGUSR1, sig_panic);
+	signal (SIGHUP, sig_go);
+	if (strcmp (panic_key, "none")) {
+		/* continue without, e.g. if another application grabbed the key */
+		hotkey_start (ui, panic_key);
+	}
+
+	if (meters) {
+		/* continue without, if the capture device is not available */
+		if (meter_start (ui, ui->sm.device->sin, ui->sm.device->smo) == 0 && analyzer) {
+			spec_start (ui->meter);
+		}
+	}
+
 	ui->disable_signals = true;
+	TRACE_BEGIN ("toplevel");
 	*widget = toplevel (ui, ui_toplevel);
+	TRACE_END ("toplevel");
 	ui->disable_signals = false;
 	free (card);
 	return ui;
@@ -1472,66 +7417,45 @@ extension_data (const char* uri)
 	return NULL;
 }
 
-static void
-port_event (LV2UI_Handle handle,
-            uint32_t     port_index,
-            uint32_t     buffer_size,
-            uint32_t     format,
-            const void*  buffer)
+/* clear the changed flags, set by elem_changed () or the offline mixer */
+static bool ctrl_collect_changes (RobTkApp* ui)
 {
-	RobTkApp* ui = (RobTkApp*)handle;
-	assert (ui->mixer);
-
-	int n = snd_mixer_poll_descriptors_count (ui->mixer);
-	unsigned short revents;
-
-	if (n != ui->nfds) {
-		free (ui->pollfds);
-		ui->nfds = n;
-		ui->pollfds = (struct pollfd*)calloc (n, sizeof (struct pollfd));
-	}
-	if (snd_mixer_poll_descriptors (ui->mixer, ui->pollfds, n) < 0) {
-		return;
-	}
-	n = poll (ui->pollfds, ui->nfds, 0);
-	if (n <= 0) {
-		return;
-	}
-
-	if (snd_mixer_poll_descriptors_revents (ui->mixer, ui->pollfds, n, &revents) < 0) {
-		fprintf (stderr, "cannot get poll events\n");
-		robtk_close_self (ui->rw->top);
-	}
-	if (revents & (POLLERR | POLLNVAL)) {
-		fprintf (stderr, "Poll error\n");
-		robtk_close_self (ui->rw->top);
-	}
-	else if (revents & POLLIN) {
-		snd_mixer_handle_events (ui->mixer);
+	bool rv = false;
+	for (unsigned int i = 0; i < ui->sm.ctrl_cnt; ++i) {
+		if (ui->sm.ctrl[i].changed) {
+			ui->sm.ctrl[i].changed = false;
+			jrn_external (ui, i);
+			++ui->perf.events;
+			rv = true;
+		}
 	}
+	return rv;
+}
 
-	/* simply update the complete GUI (on any change) */
-
+/* simply update the complete GUI (on any change) */
+static void gui_refresh (RobTkApp* ui)
+{
+	TRACE_BEGIN ("refresh");
 	ui->disable_signals = true;
 	Mctrl* ctrl;
 
-	for (unsigned int r = 0; r < ui->device->sin; ++r) {
+	for (unsigned int r = 0; r < ui->sm.device->sin; ++r) {
 		ctrl = src_sel (ui, r);
 		robtk_select_set_value (ui->src_sel[r], get_enum (ctrl));
 	}
 
-	for (unsigned int r = 0; r < ui->device->smi; ++r) {
+	for (unsigned int r = 0; r < ui->sm.device->smi; ++r) {
 		ctrl = matrix_sel (ui, r);
 		robtk_select_set_value (ui->mtx_sel[r], get_enum (ctrl));
 
-		for (unsigned int c = 0; c < ui->device->smo; ++c) {
-			unsigned int n = r * ui->device->smo + c;
+		for (unsigned int c = 0; c < ui->sm.device->smo; ++c) {
+			unsigned int n = r * ui->sm.device->smo + c;
 			ctrl = matrix_ctrl_cr (ui, c, r);
 			robtk_dial_set_value (ui->mtx_gain[n], db_to_knob (get_dB (ctrl)));
 		}
 	}
 
-	for (unsigned int o = 0; o < ui->device->smst; ++o) {
+	for (unsigned int o = 0; o < ui->sm.device->smst; ++o) {
 		ctrl = out_gain (ui, o);
 		robtk_dial_set_value (ui->out_gain[o], db_to_knob (get_dB (ctrl)));
 		robtk_dial_set_state (ui->out_gain[o], get_mute (ctrl) ? 1 : 0);
@@ -1541,14 +7465,150 @@ port_event (LV2UI_Handle handle,
 	robtk_dial_set_value (ui->mst_gain, db_to_knob (get_dB (ctrl)));
 	robtk_dial_set_state (ui->mst_gain, get_mute (ctrl) ? 1 : 0);
 
-	for (unsigned int i = 0; i < ui->device->num_hiz; ++i) {
+	for (unsigned int i = 0; i < ui->sm.device->num_hiz; ++i) {
 		robtk_cbtn_set_active (ui->btn_hiz[i], get_enum (hiz (ui, i)) == 1);
 	}
 
-	for (unsigned int o = 0; o < ui->device->sout; ++o) {
+	for (unsigned int o = 0; o < ui->sm.device->sout; ++o) {
 		ctrl = out_sel (ui, o);
 		robtk_select_set_value (ui->out_sel[o], get_enum (ctrl));
 	}
 
 	ui->disable_signals = false;
+	TRACE_END ("refresh");
+}
+
+static void
+port_event (LV2UI_Handle handle,
+            uint32_t     port_index,
+            uint32_t     buffer_size,
+            uint32_t     format,
+            const void*  buffer)
+{
+	RobTkApp* ui = (RobTkApp*)handle;
+
+	hud_tick (ui);
+	jrn_reserve (ui);
+
+	if (trace_request) {
+		trace_request = 0;
+		trace_dump ();
+	}
+
+	if (panic_request) {
+		/* before flushing the write-queue */
+		panic_request = 0;
+		pthread_mutex_lock (&ui->lock);
+		panic_mute (ui);
+		pthread_mutex_unlock (&ui->lock);
+	}
+
+	if (go_request) {
+		go_request = 0;
+		cue_go (ui);
+	}
+
+	if (ui->cues && ui->cues->changed) {
+		char txt[64];
+		ui->cues->changed = false;
+		cue_next_label (ui, sizeof (txt), txt);
+		robtk_lbl_set_text (ui->go_lbl, txt);
+	}
+
+	const int pgm = bank_midi_poll (ui);
+	if (pgm >= 0 && ui->preset_sel) {
+		ui->disable_signals = true;
+		robtk_select_set_value (ui->preset_sel, pgm);
+		ui->disable_signals = false;
+	}
+
+	const bool was_lost = ui->persist.lost;
+	if (!persist_reconnect (ui)) {
+		/* the device is gone, keep changes queued */
+		return;
+	}
+	meter_reconnect (ui, was_lost);
+
+	wq_flush (ui);
+	hist_update_buttons (ui);
+
+	if (!ui->sm.mixer) {
+		/* offline mixer, changes are reported back immediately */
+		pthread_mutex_lock (&ui->lock);
+		const bool syncing = sync_state (ui);
+		if (ctrl_collect_changes (ui)) {
+			ui->need_refresh = true;
+		}
+		if (!syncing && ui->need_refresh) {
+			ui->need_refresh = false;
+			gui_refresh (ui);
+		}
+		pthread_mutex_unlock (&ui->lock);
+		return;
+	}
+
+	int n = snd_mixer_poll_descriptors_count (ui->sm.mixer);
+	unsigned short revents;
+
+	if (n != ui->nfds) {
+		free (ui->pollfds);
+		ui->nfds = n;
+		ui->pollfds = (struct pollfd*)calloc (n, sizeof (struct pollfd));
+	}
+	if (snd_mixer_poll_descriptors (ui->sm.mixer, ui->pollfds, n) < 0) {
+		return;
+	}
+
+	pthread_mutex_lock (&ui->lock);
+	TRACE_BEGIN ("sync_state");
+	const bool syncing = sync_state (ui);
+	TRACE_END ("sync_state");
+
+	n = poll (ui->pollfds, ui->nfds, 0);
+	if (n > 0) {
+		if (snd_mixer_poll_descriptors_revents (ui->sm.mixer, ui->pollfds, n, &revents) < 0) {
+			fprintf (stderr, "cannot get poll events\n");
+			robtk_close_self (ui->rw->top);
+		}
+		if (revents & (POLLERR | POLLNVAL)) {
+			if (ui->persist.path) {
+				persist_lost (ui);
+			} else {
+				fprintf (stderr, "Poll error\n");
+				robtk_close_self (ui->rw->top);
+			}
+		}
+		else if (revents & POLLIN) {
+			TRACE_BEGIN ("handle_events");
+			snd_mixer_handle_events (ui->sm.mixer);
+			TRACE_END ("handle_events");
+		}
+		if (ctrl_collect_changes (ui)) {
+			persist_touch (ui);
+		}
+		ui->need_refresh = true;
+		if (ui->meter) {
+			ui->meter->mix_dirty = true;
+		}
+	}
+
+	/* the cue thread writes to the device as well */
+	if (!syncing) {
+		vfy_run (ui);
+	}
+	/* during the initial read, remaining items are read with current
+	 * values, already known ones are refreshed once it completes. */
+	if (!syncing && ui->need_refresh) {
+		ui->need_refresh = false;
+		gui_refresh (ui);
+	}
+	pthread_mutex_unlock (&ui->lock);
+
+	if (!syncing) {
+		persist_poll (ui);
+	}
+
+	if (ui->meter) {
+		meter_update (ui);
+	}
 }
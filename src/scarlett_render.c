@@ -0,0 +1,773 @@
+/* scarlett mixer - offline matrix-mixer emulation
+ *
+ * Copyright 2015-2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "device.h"
+
+#ifndef VERSION
+#define VERSION "0.0.0"
+#endif
+
+#define MAX_THREADS   64
+#define DEFAULT_CHUNK 65536
+
+static int verbose = 0;
+
+/* *****************************************************************************
+ * Scene
+ *
+ * Sources are WAV channels (1-based) or mix-busses (A..H).
+ * Gains are in dB, -128 is off.
+ */
+
+#define SRC_OFF -1
+#define SRC_BUS 1000 //< SRC_BUS + n: mix-bus n
+
+typedef struct {
+	Device const* device;
+	int*          mtx_src;  //< [smi] matrix input source, wav channel or SRC_OFF
+	float*        mtx_gain; //< [smi * smo] input-major, dB
+	int*          out_src;  //< [sout] output assign
+	float*        level;    //< [smst] output pair gain, dB
+	bool*         mute;     //< [smst]
+	float         master;
+	bool          master_mute;
+} Scene;
+
+static Device const* find_device (const char* name)
+{
+	for (unsigned int i = 0; i < NUM_DEVICES; ++i) {
+		if (!strcmp (devices[i].name, name)) {
+			return &devices[i];
+		}
+	}
+	/* short names, e.g. "18i8" */
+	for (unsigned int i = 0; i < NUM_DEVICES; ++i) {
+		if (strstr (devices[i].name, name)) {
+			return &devices[i];
+		}
+	}
+	return NULL;
+}
+
+/* allocate, once the device is known */
+static void scene_alloc (Scene* s)
+{
+	Device const* d = s->device;
+	s->mtx_src  = (int*)malloc (d->smi * sizeof (int));
+	s->mtx_gain = (float*)malloc (d->smi * d->smo * sizeof (float));
+	s->out_src  = (int*)malloc (d->sout * sizeof (int));
+	s->level    = (float*)calloc (d->smst, sizeof (float));
+	s->mute     = (bool*)calloc (d->smst, sizeof (bool));
+	for (unsigned int i = 0; i < d->smi; ++i) {
+		s->mtx_src[i] = SRC_OFF;
+	}
+	for (unsigned int i = 0; i < d->smi * d->smo; ++i) {
+		s->mtx_gain[i] = -128.f;
+	}
+	for (unsigned int i = 0; i < d->sout; ++i) {
+		s->out_src[i] = SRC_OFF;
+	}
+}
+
+static void scene_free (Scene* s)
+{
+	free (s->mtx_src);
+	free (s->mtx_gain);
+	free (s->out_src);
+	free (s->level);
+	free (s->mute);
+	memset (s, 0, sizeof (Scene));
+}
+
+static bool parse_index (const char* tok, unsigned int max, unsigned int* n)
+{
+	char* e;
+	long v = strtol (tok, &e, 10);
+	if (*e || v < 1 || v > max) {
+		return false;
+	}
+	*n = v - 1;
+	return true;
+}
+
+static bool parse_mix (const char* tok, unsigned int smo, unsigned int* n)
+{
+	if (strlen (tok) != 1 || toupper (tok[0]) < 'A' || toupper (tok[0]) >= 'A' + smo) {
+		return false;
+	}
+	*n = toupper (tok[0]) - 'A';
+	return true;
+}
+
+static bool parse_source (const char* tok, unsigned int smo, bool allow_bus, int* src)
+{
+	unsigned int n;
+	char* e;
+	if (!strcmp (tok, "off")) {
+		*src = SRC_OFF;
+		return true;
+	}
+	if (allow_bus && parse_mix (tok, smo, &n)) {
+		*src = SRC_BUS + n;
+		return true;
+	}
+	long v = strtol (tok, &e, 10);
+	if (*e || v < 1 || v >= SRC_BUS) {
+		return false;
+	}
+	*src = v - 1;
+	return true;
+}
+
+static bool parse_db (const char* tok, float* db)
+{
+	char* e;
+	*db = strtof (tok, &e);
+	if (*e || *db < -128.f || *db > 6.f) {
+		return false;
+	}
+	return true;
+}
+
+static int scene_load (Scene* s, const char* path, Device const* dev)
+{
+	FILE* f = fopen (path, "r");
+	if (!f) {
+		fprintf (stderr, "Cannot open scene '%s': %s\n", path, strerror (errno));
+		return -1;
+	}
+
+	memset (s, 0, sizeof (Scene));
+	s->device = dev;
+
+	char line[1024];
+	unsigned int lineno = 0;
+	int rv = 0;
+
+	while (rv == 0 && fgets (line, sizeof (line), f)) {
+		char* tok[5];
+		unsigned int n_tok = 0;
+		unsigned int a, b;
+
+		++lineno;
+		char* c = strchr (line, '#');
+		if (c) {
+			*c = '\0';
+		}
+
+		if (!strncmp (line, "device ", 7)) {
+			char* name = line + 7;
+			name[strcspn (name, "\r\n")] = '\0';
+			if (!s->device && !(s->device = find_device (name))) {
+				fprintf (stderr, "%s:%u: unknown device '%s'\n", path, lineno, name);
+				rv = -1;
+			}
+			continue;
+		}
+
+		for (char* t = strtok (line, " \t\r\n"); t && n_tok < 5; t = strtok (NULL, " \t\r\n")) {
+			tok[n_tok++] = t;
+		}
+		if (n_tok == 0) {
+			continue;
+		}
+
+		Device const* d = s->device;
+		if (d && !s->mtx_src) {
+			scene_alloc (s);
+		}
+		if (!d) {
+			fprintf (stderr, "%s:%u: no device given\n", path, lineno);
+			rv = -1;
+		} else if (!strcmp (tok[0], "matrix") && n_tok == 3
+		           && parse_index (tok[1], d->smi, &a)
+		           && parse_source (tok[2], d->smo, false, &s->mtx_src[a])) {
+			;
+		} else if (!strcmp (tok[0], "gain") && n_tok == 4
+		           && parse_index (tok[1], d->smi, &a)
+		           && parse_mix (tok[2], d->smo, &b)
+		           && parse_db (tok[3], &s->mtx_gain[a * d->smo + b])) {
+			;
+		} else if (!strcmp (tok[0], "output") && n_tok == 3
+		           && parse_index (tok[1], d->sout, &a)
+		           && parse_source (tok[2], d->smo, true, &s->out_src[a])) {
+			;
+		} else if (!strcmp (tok[0], "level") && (n_tok == 3 || (n_tok == 4 && !strcmp (tok[3], "mute")))
+		           && parse_index (tok[1], d->smst, &a)
+		           && parse_db (tok[2], &s->level[a])) {
+			s->mute[a] = n_tok == 4;
+		} else if (!strcmp (tok[0], "master") && (n_tok == 2 || (n_tok == 3 && !strcmp (tok[2], "mute")))
+		           && parse_db (tok[1], &s->master)) {
+			s->master_mute = n_tok == 3;
+		} else {
+			fprintf (stderr, "%s:%u: invalid statement\n", path, lineno);
+			rv = -1;
+		}
+	}
+
+	fclose (f);
+	if (rv == 0 && !s->device) {
+		fprintf (stderr, "%s: no device given\n", path);
+		rv = -1;
+	}
+	if (rv == 0 && !s->mtx_src) {
+		scene_alloc (s);
+	}
+	if (rv != 0) {
+		scene_free (s);
+	}
+	return rv;
+}
+
+/* *****************************************************************************
+ * WAV files
+ */
+
+typedef struct {
+	FILE*    f;
+	uint16_t format;   //< 1: PCM, 3: float
+	uint16_t n_chn;
+	uint32_t rate;
+	uint16_t bits;
+	uint64_t n_frames;
+	uint64_t pos;
+	uint8_t* raw;
+} Wav;
+
+static uint32_t rd32 (uint8_t const* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t rd16 (uint8_t const* p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static void wr32 (uint8_t* p, uint32_t v)
+{
+	p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static void wr16 (uint8_t* p, uint16_t v)
+{
+	p[0] = v; p[1] = v >> 8;
+}
+
+static int wav_open (Wav* w, const char* path)
+{
+	uint8_t hdr[40];
+	memset (w, 0, sizeof (Wav));
+
+	if (!(w->f = fopen (path, "rb"))) {
+		fprintf (stderr, "Cannot open '%s': %s\n", path, strerror (errno));
+		return -1;
+	}
+	if (fread (hdr, 1, 12, w->f) != 12 || memcmp (hdr, "RIFF", 4) || memcmp (hdr + 8, "WAVE", 4)) {
+		goto fail;
+	}
+
+	while (fread (hdr, 1, 8, w->f) == 8) {
+		const uint32_t len = rd32 (hdr + 4);
+		if (!memcmp (hdr, "fmt ", 4)) {
+			if (len < 16 || fread (hdr, 1, len < 40 ? len : 40, w->f) != (len < 40 ? len : 40)) {
+				goto fail;
+			}
+			w->format = rd16 (hdr);
+			w->n_chn  = rd16 (hdr + 2);
+			w->rate   = rd32 (hdr + 4);
+			w->bits   = rd16 (hdr + 14);
+			if (w->format == 0xfffe && len >= 40) {
+				/* WAVE_FORMAT_EXTENSIBLE, sub-format GUID */
+				w->format = rd16 (hdr + 24);
+			}
+			if (len > 40) {
+				fseek (w->f, len - 40, SEEK_CUR);
+			}
+		} else if (!memcmp (hdr, "data", 4)) {
+			if (w->n_chn == 0) {
+				goto fail;
+			}
+			w->n_frames = len / (w->n_chn * (w->bits / 8));
+			break;
+		} else {
+			fseek (w->f, len + (len & 1), SEEK_CUR);
+		}
+	}
+
+	if (w->n_chn == 0 || w->n_frames == 0
+	    || !((w->format == 1 && (w->bits == 16 || w->bits == 24 || w->bits == 32))
+	         || (w->format == 3 && w->bits == 32))) {
+		goto fail;
+	}
+	return 0;
+
+fail:
+	fprintf (stderr, "'%s' is not a supported WAV file (PCM 16/24/32 bit, float)\n", path);
+	fclose (w->f);
+	w->f = NULL;
+	return -1;
+}
+
+static int wav_create (Wav* w, const char* path, uint16_t n_chn, uint32_t rate)
+{
+	uint8_t hdr[44];
+	memset (w, 0, sizeof (Wav));
+
+	if (!(w->f = fopen (path, "wb"))) {
+		fprintf (stderr, "Cannot create '%s': %s\n", path, strerror (errno));
+		return -1;
+	}
+	w->format = 3;
+	w->n_chn  = n_chn;
+	w->rate   = rate;
+	w->bits   = 32;
+
+	/* sizes are written by wav_close () */
+	memset (hdr, 0, sizeof (hdr));
+	memcpy (hdr, "RIFF", 4);
+	memcpy (hdr + 8, "WAVEfmt ", 8);
+	wr32 (hdr + 16, 16);
+	wr16 (hdr + 20, w->format);
+	wr16 (hdr + 22, n_chn);
+	wr32 (hdr + 24, rate);
+	wr32 (hdr + 28, rate * n_chn * 4);
+	wr16 (hdr + 32, n_chn * 4);
+	wr16 (hdr + 34, 32);
+	memcpy (hdr + 36, "data", 4);
+
+	if (fwrite (hdr, 1, 44, w->f) != 44) {
+		fclose (w->f);
+		return -1;
+	}
+	return 0;
+}
+
+static int wav_finalize (Wav* w)
+{
+	uint8_t v[4];
+	const uint64_t len = w->n_frames * w->n_chn * 4;
+	if (len + 36 > UINT32_MAX) {
+		fprintf (stderr, "Output exceeds 4GB WAV limit\n");
+		return -1;
+	}
+	wr32 (v, len + 36);
+	fseek (w->f, 4, SEEK_SET);
+	fwrite (v, 1, 4, w->f);
+	wr32 (v, len);
+	fseek (w->f, 40, SEEK_SET);
+	fwrite (v, 1, 4, w->f);
+	return 0;
+}
+
+/* read up to n frames, de-interleave to planar float */
+static size_t wav_read (Wav* w, float** out, size_t n)
+{
+	const unsigned int bps = w->bits / 8;
+	if (n > w->n_frames - w->pos) {
+		n = w->n_frames - w->pos;
+	}
+	size_t got = fread (w->raw, w->n_chn * bps, n, w->f);
+	w->pos += got;
+	uint8_t const* p = w->raw;
+
+	for (size_t f = 0; f < got; ++f) {
+		for (unsigned int c = 0; c < w->n_chn; ++c, p += bps) {
+			float v;
+			if (w->format == 3) {
+				memcpy (&v, p, 4);
+			} else if (bps == 2) {
+				v = (int16_t)rd16 (p) / 32768.f;
+			} else if (bps == 3) {
+				v = (int32_t)((p[0] << 8) | (p[1] << 16) | ((uint32_t)p[2] << 24)) / 2147483648.f;
+			} else {
+				v = (int32_t)rd32 (p) / 2147483648.f;
+			}
+			out[c][f] = v;
+		}
+	}
+	return got;
+}
+
+/* *****************************************************************************
+ * Mixer
+ */
+
+/* out[f] += g * in[f] */
+static void mix_add (float* out, float const* in, float g, size_t n)
+{
+	size_t f = 0;
+#ifdef __SSE__
+	const __m128 gg = _mm_set1_ps (g);
+	for (; f + 4 <= n; f += 4) {
+		_mm_storeu_ps (&out[f], _mm_add_ps (_mm_loadu_ps (&out[f]), _mm_mul_ps (gg, _mm_loadu_ps (&in[f]))));
+	}
+#endif
+	for (; f < n; ++f) {
+		out[f] += g * in[f];
+	}
+}
+
+static void mix_copy (float* out, float const* in, float g, size_t n)
+{
+	for (size_t f = 0; f < n; ++f) {
+		out[f] = g * in[f];
+	}
+}
+
+typedef struct {
+	Scene const*  scene;
+	float* const* in;
+	float**       bus;
+	size_t        n_frames;
+	unsigned int  n_chn;    //< wav channels
+	unsigned int  bus0;     //< first bus of this job
+	unsigned int  bus_step; //< number of threads
+	uint64_t      n_mac;
+} MixJob;
+
+static float db_to_coeff (float db)
+{
+	return db <= -128.f ? 0.f : powf (10.f, .05f * db);
+}
+
+/* compute mix-busses bus0, bus0 + bus_step, .. */
+static void* mix_thread (void* arg)
+{
+	MixJob* j = (MixJob*)arg;
+	Scene const* s = j->scene;
+	Device const* d = s->device;
+
+	for (unsigned int b = j->bus0; b < d->smo; b += j->bus_step) {
+		memset (j->bus[b], 0, j->n_frames * sizeof (float));
+		for (unsigned int r = 0; r < d->smi; ++r) {
+			const int src = s->mtx_src[r];
+			const float g = db_to_coeff (s->mtx_gain[r * d->smo + b]);
+			if (src == SRC_OFF || src >= (int)j->n_chn || g == 0.f) {
+				continue;
+			}
+			mix_add (j->bus[b], j->in[src], g, j->n_frames);
+			j->n_mac += j->n_frames;
+		}
+	}
+	return NULL;
+}
+
+static uint64_t monotonic_ns (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static float** alloc_planar (unsigned int n_chn, size_t n_frames)
+{
+	float** p = (float**)malloc (n_chn * sizeof (float*));
+	for (unsigned int c = 0; c < n_chn; ++c) {
+		p[c] = (float*)calloc (n_frames, sizeof (float));
+	}
+	return p;
+}
+
+static void free_planar (float** p, unsigned int n_chn)
+{
+	for (unsigned int c = 0; c < n_chn; ++c) {
+		free (p[c]);
+	}
+	free (p);
+}
+
+/* output file: mix-busses A.., followed by all output assigns */
+static int render (Scene const* s, Wav* in, Wav* out, size_t chunk, unsigned int n_threads)
+{
+	Device const* d = s->device;
+	const unsigned int n_out = d->smo + d->sout;
+	MixJob   job[MAX_THREADS];
+	pthread_t thread[MAX_THREADS];
+	bool     started[MAX_THREADS];
+	uint64_t t_mix = 0;
+	uint64_t n_mac = 0;
+	int rv = 0;
+
+	float** ibuf = alloc_planar (in->n_chn, chunk);
+	float** bus  = alloc_planar (d->smo, chunk);
+	float*  obuf = (float*)malloc (chunk * n_out * sizeof (float));
+	in->raw = (uint8_t*)malloc (chunk * in->n_chn * (in->bits / 8));
+	float*  peak = (float*)calloc (n_out, sizeof (float));
+	float*  out_gain = (float*)malloc (d->sout * sizeof (float));
+
+	const float master = s->master_mute ? 0.f : db_to_coeff (s->master);
+	for (unsigned int o = 0; o < d->sout; ++o) {
+		out_gain[o] = s->mute[o / 2] ? 0.f : master * db_to_coeff (s->level[o / 2]);
+	}
+
+	if (n_threads > d->smo) {
+		n_threads = d->smo;
+	}
+
+	const uint64_t t0 = monotonic_ns ();
+	size_t n;
+
+	while ((n = wav_read (in, ibuf, chunk)) > 0) {
+		const uint64_t t1 = monotonic_ns ();
+		for (unsigned int t = 0; t < n_threads; ++t) {
+			job[t].scene    = s;
+			job[t].in       = ibuf;
+			job[t].bus      = bus;
+			job[t].n_frames = n;
+			job[t].n_chn    = in->n_chn;
+			job[t].bus0     = t;
+			job[t].bus_step = n_threads;
+			job[t].n_mac    = 0;
+			started[t] = t > 0 && pthread_create (&thread[t], NULL, mix_thread, &job[t]) == 0;
+			if (t > 0 && !started[t]) {
+				/* run it here instead */
+				mix_thread (&job[t]);
+			}
+		}
+		mix_thread (&job[0]);
+		for (unsigned int t = 0; t < n_threads; ++t) {
+			if (started[t]) {
+				pthread_join (thread[t], NULL);
+			}
+			n_mac += job[t].n_mac;
+		}
+		t_mix += monotonic_ns () - t1;
+
+		/* interleave, output assigns */
+		for (unsigned int c = 0; c < n_out; ++c) {
+			float const* src = NULL;
+			float g = 1.f;
+			if (c < d->smo) {
+				src = bus[c];
+			} else {
+				const unsigned int o = c - d->smo;
+				const int os = s->out_src[o];
+				g = out_gain[o];
+				if (os >= SRC_BUS) {
+					src = bus[os - SRC_BUS];
+				} else if (os != SRC_OFF && os < in->n_chn) {
+					src = ibuf[os];
+				}
+			}
+			float* o = &obuf[c];
+			for (size_t f = 0; f < n; ++f, o += n_out) {
+				const float v = src ? g * src[f] : 0.f;
+				*o = v;
+				if (fabsf (v) > peak[c]) {
+					peak[c] = fabsf (v);
+				}
+			}
+		}
+
+		if (fwrite (obuf, n_out * sizeof (float), n, out->f) != n) {
+			fprintf (stderr, "Write error: %s\n", strerror (errno));
+			rv = -1;
+			break;
+		}
+		out->n_frames += n;
+	}
+
+	const double elapsed = (monotonic_ns () - t0) * 1e-9;
+	const double duration = out->n_frames / (double)in->rate;
+
+	if (verbose) {
+		printf ("Rendered %" PRIu64 " frames (%.1f sec) in %.3f sec, %.1fx realtime, %u threads\n",
+				out->n_frames, duration, elapsed, elapsed > 0 ? duration / elapsed : 0, n_threads);
+		printf ("Mix kernel: %.3f sec, %.1f M multiply-adds/sec\n",
+				t_mix * 1e-9, t_mix > 0 ? n_mac * 1e3 / t_mix : 0);
+	}
+	for (unsigned int c = 0; c < n_out; ++c) {
+		const float db = peak[c] > 0 ? 20.f * log10f (peak[c]) : -INFINITY;
+		if (c < d->smo) {
+			if (verbose || db > 0) printf ("Mix %c:     peak %+6.1f dBFS%s\n", 'A' + c, db, db > 0 ? " CLIP" : "");
+		} else {
+			if (verbose || db > 0) printf ("Output %2u: peak %+6.1f dBFS%s\n", c - d->smo + 1, db, db > 0 ? " CLIP" : "");
+		}
+	}
+
+	free_planar (ibuf, in->n_chn);
+	free_planar (bus, d->smo);
+	free (obuf);
+	free (in->raw);
+	free (peak);
+	free (out_gain);
+	return rv;
+}
+
+/* *****************************************************************************
+ * options + help
+ */
+
+static struct option const long_options[] =
+{
+	{"chunk", required_argument, 0, 'c'},
+	{"device", required_argument, 0, 'd'},
+	{"help", no_argument, 0, 'h'},
+	{"threads", required_argument, 0, 'j'},
+	{"version", no_argument, 0, 'V'},
+	{"verbose", no_argument, 0, 'v'},
+	{NULL, 0, NULL, 0}
+};
+
+static void usage (int status) {
+	printf ("scarlett-render - Offline Matrix Mixer Emulation for Focusrite Scarlett USB Devices.\n\n\
+Renders a multichannel WAV file through the matrix mixer and output\n\
+routing of a Scarlett device, as described by a scene file.\n\
+\n\
+Supported devices:\n\
+");
+
+	for (unsigned i = 0; i < NUM_DEVICES; i++) {
+		printf ("* %s\n", devices[i].name);
+	}
+
+	printf ("Usage: scarlett-render [ OPTIONS ] <scene> <input.wav> <output.wav>\n\n");
+	printf ("Options:\n\
+  -c, --chunk <frames>       process the input in chunks of given size\n\
+  -d, --device <name>        device, unless given in the scene file\n\
+  -h, --help                 display this help and exit\n\
+  -j, --threads <num>        number of threads (default: number of CPUs)\n\
+  -V, --version              print version information and exit\n\
+  -v, --verbose              print timing and peak-levels\n\
+\n\n\
+The scene is a text file, one statement per line, '#' starts a comment.\n\
+Inputs and outputs are numbered from 1, mix-busses are A, B, ..\n\
+Input channels of the WAV file are the sources:\n\
+\n\
+  device <name>              e.g. 'device Scarlett 18i8 USB'\n\
+  matrix <input> <chn|off>   matrix input source\n\
+  gain <input> <mix> <dB>    crosspoint gain, -128 is off (default)\n\
+  output <out> <chn|mix|off> output assign\n\
+  level <pair> <dB> [mute]   output level, per stereo pair\n\
+  master <dB> [mute]         master level\n\
+\n\
+The output file contains all mix-busses followed by all outputs as\n\
+32bit float. Levels above 0 dBFS are reported.\n\
+\n\
+Examples:\n\
+scarlett-render -v -d 18i8 monitor.scene tracks.wav out.wav\n\
+\n");
+	printf ("Report bugs to <https://github.com/x42/scarlett-mixer/issues>\n");
+	exit (status);
+}
+
+int main (int argc, char** argv)
+{
+	Device const* dev = NULL;
+	size_t chunk = DEFAULT_CHUNK;
+	long n_cpu = sysconf (_SC_NPROCESSORS_ONLN);
+	unsigned int n_threads = n_cpu > 0 ? n_cpu : 1;
+	int c;
+
+	while ((c = getopt_long (argc, argv,
+			   "c:" /* chunk */
+			   "d:" /* device */
+			   "h"  /* help */
+			   "j:" /* threads */
+			   "V"  /* version */
+			   "v", /* verbose */
+			   long_options, (int *) 0)) != EOF) {
+		switch (c) {
+			case 'c':
+				chunk = atol (optarg);
+				if (chunk < 64) {
+					usage (EXIT_FAILURE);
+				}
+				break;
+			case 'd':
+				if (!(dev = find_device (optarg))) {
+					fprintf (stderr, "Unknown device '%s'\n", optarg);
+					usage (EXIT_FAILURE);
+				}
+				break;
+			case 'h':
+				usage (0);
+			case 'j':
+				n_threads = atoi (optarg);
+				if (n_threads < 1 || n_threads > MAX_THREADS) {
+					usage (EXIT_FAILURE);
+				}
+				break;
+			case 'V':
+				printf ("scarlet-render version %s\n\n", VERSION);
+				printf ("Copyright (C) GPL 2019 Robin Gareus <robin@gareus.org>\n");
+				exit (0);
+			case 'v':
+				++verbose;
+				break;
+			default:
+				usage (EXIT_FAILURE);
+		}
+	}
+
+	if (argc != optind + 3) {
+		usage (EXIT_FAILURE);
+	}
+	if (n_threads > MAX_THREADS) {
+		n_threads = MAX_THREADS;
+	}
+
+	Scene scene;
+	Wav in, out;
+
+	if (scene_load (&scene, argv[optind], dev)) {
+		return 1;
+	}
+	if (wav_open (&in, argv[optind + 1])) {
+		return 1;
+	}
+	if (wav_create (&out, argv[optind + 2], scene.device->smo + scene.device->sout, in.rate)) {
+		fclose (in.f);
+		return 1;
+	}
+
+	if (verbose) {
+		printf ("%s: %u channels, %u Hz, %" PRIu64 " frames\n", argv[optind + 1], in.n_chn, in.rate, in.n_frames);
+	}
+
+	int rv = render (&scene, &in, &out, chunk, n_threads);
+	if (rv == 0) {
+		rv = wav_finalize (&out);
+	}
+
+	fclose (in.f);
+	fclose (out.f);
+	scene_free (&scene);
+	return rv ? 1 : 0;
+}
@@ -0,0 +1,121 @@
+/* scarlett mixer - shared memory state
+ *
+ * Copyright 2015-2019 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifndef SCARLETT_SHM_H
+#define SCARLETT_SHM_H
+
+/* `scarlett-mixerd <name>` and `scarlett-mixer --daemon <name>` publish
+ * the mixer state in the POSIX shared memory object <name> (writer side:
+ * scarlett_shm_create() in scarlett_core.h). Readers map it read-only:
+ *
+ *   int fd = shm_open ("/scarlett-mixer", O_RDONLY, 0);
+ *   struct stat st;
+ *   fstat (fd, &st);
+ *   ScarlettShm const* shm = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+ *   ScarlettShm* state = malloc (st.st_size);
+ *   if (scarlett_shm_read (shm, state, st.st_size)) {
+ *     int32_t gain = scarlett_shm_mtx_gain (state)[r * state->smo + c];
+ *   }
+ *
+ * The header is fixed for a given version, it is followed by arrays
+ * sized by the device, see the accessors below. All gains are in
+ * 1/100 dB, mutes and HiZ/Pad are 0/1, selectors are enum item indices.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SCARLETT_SHM_MAGIC   "SCMSTAT"
+#define SCARLETT_SHM_VERSION 2
+
+typedef struct {
+	char              magic[8];   //< SCARLETT_SHM_MAGIC
+	uint32_t          version;    //< SCARLETT_SHM_VERSION
+	uint32_t          size;       //< of the segment, scarlett_shm_size()
+	volatile uint32_t seq;        //< odd while the daemon is writing
+	uint32_t          pid;        //< of the daemon
+	uint64_t          serial;     //< incremented with every update
+	char              device[64];
+
+	uint32_t smi;  //< matrix inputs
+	uint32_t smo;  //< matrix mix-busses
+	uint32_t sin;  //< capture selectors
+	uint32_t sout; //< output assigns
+	uint32_t smst; //< output gains
+	uint32_t num_hiz;
+	uint32_t num_pad;
+	uint32_t _reserved;
+
+	int32_t mst_gain;
+	int32_t mst_mute;
+	int32_t val[]; //< arrays in the order of the accessors below
+} ScarlettShm;
+
+static inline size_t scarlett_shm_size (ScarlettShm const* s)
+{
+	return sizeof (ScarlettShm) + sizeof (int32_t) * (
+			s->smi * s->smo + s->smi + s->sin + s->sout + 2 * s->smst + s->num_hiz + s->num_pad);
+}
+
+/* [smi * smo], input-major */
+static inline int32_t* scarlett_shm_mtx_gain (ScarlettShm* s) { return s->val; }
+/* [smi] */
+static inline int32_t* scarlett_shm_mtx_sel (ScarlettShm* s)  { return scarlett_shm_mtx_gain (s) + s->smi * s->smo; }
+/* [sin] */
+static inline int32_t* scarlett_shm_src_sel (ScarlettShm* s)  { return scarlett_shm_mtx_sel (s) + s->smi; }
+/* [sout] */
+static inline int32_t* scarlett_shm_out_sel (ScarlettShm* s)  { return scarlett_shm_src_sel (s) + s->sin; }
+/* [smst] */
+static inline int32_t* scarlett_shm_out_gain (ScarlettShm* s) { return scarlett_shm_out_sel (s) + s->sout; }
+/* [smst] */
+static inline int32_t* scarlett_shm_out_mute (ScarlettShm* s) { return scarlett_shm_out_gain (s) + s->smst; }
+/* [num_hiz] */
+static inline int32_t* scarlett_shm_hiz (ScarlettShm* s)      { return scarlett_shm_out_mute (s) + s->smst; }
+/* [num_pad] */
+static inline int32_t* scarlett_shm_pad (ScarlettShm* s)      { return scarlett_shm_hiz (s) + s->num_hiz; }
+
+/* copy a consistent snapshot to `out` of `len` bytes, returns false if
+ * the segment is not valid, does not fit or the daemon kept updating it */
+static inline bool scarlett_shm_read (ScarlettShm const* shm, ScarlettShm* out, size_t len)
+{
+	if (memcmp (shm->magic, SCARLETT_SHM_MAGIC, 8)) {
+		return false;
+	}
+	/* the header is valid once the magic is set */
+	__sync_synchronize ();
+	if (shm->version != SCARLETT_SHM_VERSION || shm->size < sizeof (ScarlettShm) || shm->size > len) {
+		return false;
+	}
+	for (int retry = 0; retry < 100; ++retry) {
+		const uint32_t seq = shm->seq;
+		__sync_synchronize ();
+		if (seq & 1) {
+			continue;
+		}
+		memcpy (out, (void const*)shm, shm->size);
+		__sync_synchronize ();
+		if (seq == shm->seq) {
+			return true;
+		}
+	}
+	return false;
+}
+
+#endif